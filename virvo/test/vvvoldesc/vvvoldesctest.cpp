@@ -0,0 +1,269 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <virvo/vvframeprovider.h>
+#include <virvo/vvvoldesc.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+
+#include <boost/make_shared.hpp>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+// Volume of 'n' voxels along x with 'chan' channels, the voxels of each
+// frame are copied from 'data'
+template <typename T>
+void initVolume(vvVolDesc& vd, ssize_t n, int chan, size_t frames, T const* data)
+{
+  vd.vox[0] = n;
+  vd.vox[1] = 1;
+  vd.vox[2] = 1;
+  vd.bpc = sizeof(T);
+  vd.setChan(chan);
+
+  for (size_t f = 0; f < frames; ++f)
+  {
+    uint8_t* frame = new uint8_t[vd.getFrameBytes()];
+    memcpy(frame, data + f * n * chan, vd.getFrameBytes());
+    vd.addFrame(frame, vvVolDesc::ARRAY_DELETE);
+  }
+  vd.frames = frames;
+}
+
+} // namespace
+
+TEST(VolDesc, GetChannelValue16BitHostOrder)
+{
+  uint16_t data[] = { 0, 0x0100, 0xFFFF };
+
+  vvVolDesc vd;
+  initVolume(vd, 3, 1, 1, data);
+
+  // Voxel data is stored in host byte order, 0x0100 must not read as 0x0001
+  EXPECT_FLOAT_EQ(0.0f, vd.getChannelValue(0, 0, 0));
+  EXPECT_FLOAT_EQ(256.0f / 65535.0f, vd.getChannelValue(0, 1, 0));
+  EXPECT_FLOAT_EQ(1.0f, vd.getChannelValue(0, 2, 0));
+}
+
+TEST(VolDesc, FindMinMaxAllFrames)
+{
+  uint8_t data[] = {
+    // frame 0
+    10, 200,   20, 250,
+    // frame 1
+    5, 220,    30, 210
+  };
+
+  vvVolDesc vd;
+  initVolume(vd, 2, 2, 2, data);
+
+  float mi = 0.0f;
+  float ma = 0.0f;
+
+  vd.findMinMax(0, mi, ma);
+  EXPECT_FLOAT_EQ(5.0f / 255.0f, mi);
+  EXPECT_FLOAT_EQ(30.0f / 255.0f, ma);
+
+  vd.findMinMax(1, mi, ma);
+  EXPECT_FLOAT_EQ(200.0f / 255.0f, mi);
+  EXPECT_FLOAT_EQ(250.0f / 255.0f, ma);
+}
+
+TEST(VolDesc, FindMinMaxMapping)
+{
+  uint16_t data[] = { 0x0100, 0x8000 };
+
+  vvVolDesc vd;
+  initVolume(vd, 2, 1, 1, data);
+  vd.mapping(0) = virvo::vec2(-1.0f, 1.0f);
+
+  float mi = 0.0f;
+  float ma = 0.0f;
+  vd.findMinMax(0, mi, ma);
+
+  EXPECT_FLOAT_EQ(-1.0f + 2.0f * 256.0f / 65535.0f, mi);
+  EXPECT_FLOAT_EQ(-1.0f + 2.0f * 32768.0f / 65535.0f, ma);
+}
+
+TEST(VolDesc, ConvertBPCFloatTo16BitHostOrder)
+{
+  float data[] = { 0.0f, 0.5f, 1.0f, 2.0f };
+
+  vvVolDesc vd;
+  initVolume(vd, 4, 1, 1, data);
+  vd.convertBPC(2);
+
+  ASSERT_EQ(2U, vd.bpc);
+
+  uint16_t const* converted = reinterpret_cast<uint16_t const*>(vd.getRaw(0));
+  EXPECT_EQ(0U, converted[0]);
+  EXPECT_EQ(32767U, converted[1]);
+  EXPECT_EQ(65535U, converted[2]);
+  EXPECT_EQ(65535U, converted[3]); // clamped to the data range
+}
+
+//----------------------------------------------------------------------------
+// Frame storage
+//
+
+namespace
+{
+
+// Frame f of 'n' 16 bit voxels, voxel i has the value f * 0x100 + i
+class CountingProvider : public vvFrameProvider
+{
+public:
+  CountingProvider(size_t n) : n(n), loads(0) {}
+
+  virtual boost::shared_ptr<uint8_t> loadFrame(size_t frame)
+  {
+    ++loads;
+    uint16_t* data = new uint16_t[n];
+    for (size_t i = 0; i < n; ++i)
+      data[i] = static_cast<uint16_t>(frame * 0x100 + i);
+    return boost::shared_ptr<uint8_t>(reinterpret_cast<uint8_t*>(data), ArrayDelete());
+  }
+
+  size_t n;
+  std::atomic<size_t> loads;
+
+private:
+  struct ArrayDelete
+  {
+    void operator()(uint8_t* p) const { delete[] reinterpret_cast<uint16_t*>(p); }
+  };
+};
+
+// Volume of 'n' 16 bit voxels along x whose frames are served by 'provider'
+void initProvidedVolume(vvVolDesc& vd, ssize_t n, size_t frames,
+    boost::shared_ptr<vvFrameProvider> provider, size_t cacheFrames)
+{
+  vd.vox[0] = n;
+  vd.vox[1] = 1;
+  vd.vox[2] = 1;
+  vd.bpc = 2;
+  vd.setChan(1);
+  vd.frames = frames;
+  vd.setFrameProvider(provider, cacheFrames, 0);
+}
+
+uint16_t voxel16(vvVolDesc const& vd, size_t frame, size_t i)
+{
+  vvVolDesc::FramePointer data = vd.getFrame(frame);
+  return data ? reinterpret_cast<uint16_t const*>(data.get())[i] : 0;
+}
+
+} // namespace
+
+TEST(VolDesc, FrameRandomAccess)
+{
+  uint8_t data[] = { 1, 2, 3, 4, 5 };
+
+  vvVolDesc vd;
+  initVolume(vd, 1, 1, 5, data);
+
+  EXPECT_EQ(4, vd.getRaw(3)[0]);
+  EXPECT_EQ(1, vd.getRaw(0)[0]);
+  EXPECT_EQ(5, vd.getRaw(4)[0]);
+  EXPECT_TRUE(vd.getRaw(5) == NULL);
+}
+
+TEST(VolDesc, FramePointerOutlivesRemoval)
+{
+  uint8_t data[] = { 7, 8 };
+
+  vvVolDesc vd;
+  initVolume(vd, 1, 1, 2, data);
+
+  vvVolDesc::FramePointer frame = vd.getFrame(1);
+  vd.removeSequence();
+
+  ASSERT_TRUE(frame.get() != NULL);
+  EXPECT_EQ(8, frame.get()[0]);
+}
+
+TEST(VolDesc, FrameProviderLoadsOnDemand)
+{
+  boost::shared_ptr<CountingProvider> provider = boost::make_shared<CountingProvider>(4);
+
+  vvVolDesc vd;
+  initProvidedVolume(vd, 4, 5, provider, 2);
+
+  EXPECT_EQ(0x0302, voxel16(vd, 3, 2));
+  EXPECT_EQ(0x0001, voxel16(vd, 0, 1));
+  EXPECT_EQ(0x0403, voxel16(vd, 4, 3));
+
+  // Only the working set is resident
+  size_t resident = 0;
+  for (size_t f = 0; f < 5; ++f)
+    resident += vd.isFrameResident(f) ? 1 : 0;
+  EXPECT_LE(resident, 2U);
+}
+
+TEST(VolDesc, FrameProviderKeepsModifiedFrames)
+{
+  boost::shared_ptr<CountingProvider> provider = boost::make_shared<CountingProvider>(4);
+
+  vvVolDesc vd;
+  initProvidedVolume(vd, 4, 4, provider, 1);
+
+  vd.toggleEndianness();
+
+  // The modified frames must not be evicted and reloaded unmodified
+  for (size_t f = 0; f < 4; ++f)
+  {
+    for (size_t i = 0; i < 4; ++i)
+    {
+      uint16_t v = static_cast<uint16_t>(f * 0x100 + i);
+      EXPECT_EQ(static_cast<uint16_t>((v << 8) | (v >> 8)), voxel16(vd, f, i));
+    }
+  }
+
+  EXPECT_EQ(4U, provider->loads.load());
+}
+
+TEST(VolDesc, MappedFrameCopyOnWrite)
+{
+  const char* fn = "vvvoldesctest_mapped.raw";
+
+  // 2 bytes of header, then 4 voxels of 16 bit
+  uint16_t file[] = { 0xFFFF, 0x0102, 0x0304, 0x0506, 0x0708 };
+  FILE* fp = fopen(fn, "wb");
+  ASSERT_TRUE(fp != NULL);
+  ASSERT_EQ(1U, fwrite(file, sizeof(file), 1, fp));
+  fclose(fp);
+
+  vvVolDesc vd;
+  vd.vox[0] = 4;
+  vd.vox[1] = 1;
+  vd.vox[2] = 1;
+  vd.bpc = 2;
+  vd.setChan(1);
+
+  ASSERT_TRUE(vd.addMappedFrame(fn, sizeof(uint16_t)));
+  vd.frames = 1;
+
+  EXPECT_EQ(0x0102, voxel16(vd, 0, 0));
+  EXPECT_EQ(0x0708, voxel16(vd, 0, 3));
+
+  // Modifications go to private pages, the file stays unchanged
+  vd.toggleEndianness();
+  EXPECT_EQ(0x0201, voxel16(vd, 0, 0));
+  EXPECT_EQ(0x0807, voxel16(vd, 0, 3));
+
+  uint16_t check[5] = {};
+  fp = fopen(fn, "rb");
+  ASSERT_TRUE(fp != NULL);
+  ASSERT_EQ(1U, fread(check, sizeof(check), 1, fp));
+  fclose(fp);
+  EXPECT_EQ(0, memcmp(file, check, sizeof(file)));
+
+  vd.removeSequence();
+  remove(fn);
+}
@@ -0,0 +1,422 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+#include <virvo/vvclock.h>
+#include <virvo/vvopengl.h>
+#include <virvo/vvvolumeview.h>
+
+#include "grid.h"
+
+namespace
+{
+
+// Min/max of the normalized voxel values inside each cell
+struct InnerValueRanges
+{
+  InnerValueRanges(int channel, float lo, float inv, visionaray::vec3i cellsize, visionaray::vec3i num_cells,
+      std::vector<visionaray::vec2>& inner)
+    : channel(channel)
+    , lo(lo)
+    , inv(inv)
+    , cellsize(cellsize)
+    , num_cells(num_cells)
+    , inner(inner)
+  {
+  }
+
+  template <typename T>
+  void operator()(virvo::VolumeView<T> const& view) const
+  {
+    using namespace visionaray;
+
+    virvo::vector<3, ssize_t> const& vox = view.vox();
+
+    for (int z = 0; z < vox[2]; ++z)
+    {
+      for (int y = 0; y < vox[1]; ++y)
+      {
+        auto* r = &inner[(z / cellsize.z) * num_cells.x * num_cells.y + (y / cellsize.y) * num_cells.x];
+
+        for (int x = 0; x < vox[0]; ++x)
+        {
+          float v = (view.value(view.index(x, y, z), channel) - lo) * inv;
+          v = clamp(v, 0.0f, 1.0f);
+
+          auto& cell = r[x / cellsize.x];
+          cell.x = std::min(cell.x, v);
+          cell.y = std::max(cell.y, v);
+        }
+      }
+    }
+  }
+
+  int channel;
+  float lo;
+  float inv;
+  visionaray::vec3i cellsize;
+  visionaray::vec3i num_cells;
+  std::vector<visionaray::vec2>& inner;
+};
+
+} // namespace
+
+void MacrocellGrid::updateVolume(vvVolDesc const& vd, int channel)
+{
+  using namespace visionaray;
+
+  vvStopwatch sw; sw.start();
+
+  vox = vec3i(vd.vox.x, vd.vox.y, vd.vox.z);
+  dist = vec3(vd.getDist().x, vd.getDist().y, vd.getDist().z);
+  scale = vd._scale;
+
+  num_cells = vec3i(div_up(vox.x, cellsize.x),
+                    div_up(vox.y, cellsize.y),
+                    div_up(vox.z, cellsize.z));
+
+  size_t n = num_cells.x * num_cells.y * num_cells.z;
+
+  // Value ranges of the voxels inside each cell, normalized
+  // the same way as the transfer function lookup coordinates
+  float lo = vd.range(channel)[0];
+  float hi = vd.range(channel)[1];
+  float inv = hi > lo ? 1.0f / (hi - lo) : 0.0f;
+
+  std::vector<vec2> inner(n, vec2(1.0f, 0.0f));
+
+  virvo::dispatchVolumeView(vd, vd.getCurrentFrame(), InnerValueRanges(channel, lo, inv, cellsize, num_cells, inner));
+
+  // Voxels on the cell boundaries are interpolated with their neighbors,
+  // so each cell conservatively also covers the ranges of its neighbors
+  value_ranges.resize(n);
+
+  for (int z = 0; z < num_cells.z; ++z)
+  {
+    for (int y = 0; y < num_cells.y; ++y)
+    {
+      for (int x = 0; x < num_cells.x; ++x)
+      {
+        vec2 r(1.0f, 0.0f);
+
+        for (int zz = std::max(z - 1, 0); zz <= std::min(z + 1, num_cells.z - 1); ++zz)
+        {
+          for (int yy = std::max(y - 1, 0); yy <= std::min(y + 1, num_cells.y - 1); ++yy)
+          {
+            for (int xx = std::max(x - 1, 0); xx <= std::min(x + 1, num_cells.x - 1); ++xx)
+            {
+              vec2 const& rr = inner[zz * num_cells.x * num_cells.y + yy * num_cells.x + xx];
+              r.x = std::min(r.x, rr.x);
+              r.y = std::max(r.y, rr.y);
+            }
+          }
+        }
+
+        value_ranges[z * num_cells.x * num_cells.y + y * num_cells.x + x] = r;
+      }
+    }
+  }
+
+  volume_time = sw.getTime();
+
+  classify();
+}
+
+void MacrocellGrid::updateTransfunc(visionaray::vec4 const* transfunc, int numEntries)
+{
+  using namespace visionaray;
+
+  visible_entries.resize(numEntries + 1);
+  visible_entries[0] = 0;
+
+  colors.resize(numEntries);
+
+  for (int i = 0; i < numEntries; ++i)
+  {
+    visible_entries[i + 1] = visible_entries[i] + (transfunc[i].w < 0.0001f ? 0 : 1);
+    colors[i] = vec4(transfunc[i].xyz() * transfunc[i].w, transfunc[i].w);
+  }
+
+  classify();
+}
+
+void MacrocellGrid::classify()
+{
+  using namespace visionaray;
+
+  vvStopwatch sw; sw.start();
+
+  occupancy.resize(value_ranges.size());
+  max_colors.resize(value_ranges.size());
+  min_colors.resize(value_ranges.size());
+
+  // No transfer function yet: treat everything as visible
+  if (visible_entries.size() < 2)
+  {
+    std::fill(occupancy.begin(), occupancy.end(), 1.0f);
+    std::fill(max_colors.begin(), max_colors.end(), vec4(std::numeric_limits<float>::max()));
+    std::fill(min_colors.begin(), min_colors.end(), vec4(std::numeric_limits<float>::lowest()));
+    update_coarse_occupancy();
+    classify_time = sw.getTime();
+    return;
+  }
+
+  int n = static_cast<int>(visible_entries.size()) - 1;
+
+  // Sparse tables for constant time range max./min. queries over the colors,
+  // level k holds the max./min. over the 2^k entries starting at each index
+  int levels = 1;
+  while ((1 << levels) <= n)
+  {
+    ++levels;
+  }
+
+  std::vector<std::vector<vec4>> max_table(levels);
+  std::vector<std::vector<vec4>> min_table(levels);
+
+  max_table[0] = colors;
+  min_table[0] = colors;
+
+  for (int k = 1; k < levels; ++k)
+  {
+    int half = 1 << (k - 1);
+    int size = n - (1 << k) + 1;
+
+    max_table[k].resize(size);
+    min_table[k].resize(size);
+
+    for (int i = 0; i < size; ++i)
+    {
+      max_table[k][i] = max(max_table[k - 1][i], max_table[k - 1][i + half]);
+      min_table[k][i] = min(min_table[k - 1][i], min_table[k - 1][i + half]);
+    }
+  }
+
+  for (size_t i = 0; i < value_ranges.size(); ++i)
+  {
+    vec2 const& r = value_ranges[i];
+
+    if (r.x > r.y)
+    {
+      occupancy[i] = 0.0f;
+      max_colors[i] = vec4(0.0f);
+      min_colors[i] = vec4(std::numeric_limits<float>::max());
+      continue;
+    }
+
+    // Transfer function entries that contribute to a linear lookup in [r.x..r.y]
+    int first = clamp(static_cast<int>(std::floor(r.x * n - 0.5f)), 0, n - 1);
+    int last  = clamp(static_cast<int>(std::ceil(r.y * n - 0.5f)), 0, n - 1);
+
+    occupancy[i] = visible_entries[last + 1] - visible_entries[first] > 0 ? 1.0f : 0.0f;
+
+    int k = 0;
+    while ((2 << k) <= last - first + 1)
+    {
+      ++k;
+    }
+
+    max_colors[i] = max(max_table[k][first], max_table[k][last - (1 << k) + 1]);
+    min_colors[i] = min(min_table[k][first], min_table[k][last - (1 << k) + 1]);
+  }
+
+  update_coarse_occupancy();
+
+  classify_time = sw.getTime();
+}
+
+void MacrocellGrid::update_coarse_occupancy()
+{
+  using namespace visionaray;
+
+  num_coarse_cells = vec3i(div_up(num_cells.x, coarse_factor),
+                           div_up(num_cells.y, coarse_factor),
+                           div_up(num_cells.z, coarse_factor));
+
+  coarse_occupancy.assign(num_coarse_cells.x * num_coarse_cells.y * num_coarse_cells.z, 0.0f);
+
+  for (int z = 0; z < num_cells.z; ++z)
+  {
+    for (int y = 0; y < num_cells.y; ++y)
+    {
+      for (int x = 0; x < num_cells.x; ++x)
+      {
+        if (occupancy[z * num_cells.x * num_cells.y + y * num_cells.x + x] != 0.0f)
+        {
+          int cx = x / coarse_factor;
+          int cy = y / coarse_factor;
+          int cz = z / coarse_factor;
+          coarse_occupancy[cz * num_coarse_cells.x * num_coarse_cells.y + cy * num_coarse_cells.x + cx] = 1.0f;
+        }
+      }
+    }
+  }
+}
+
+visionaray::aabb MacrocellGrid::cell_bounds(int x, int y, int z) const
+{
+  using namespace visionaray;
+
+  aabbi bbox(
+      vec3i(x, y, z) * cellsize,
+      min(vec3i(x + 1, y + 1, z + 1) * cellsize, vox)
+      );
+
+  // Voxel to object space, y and z are flipped
+  aabbi flipped = bbox;
+  flipped.min.y = vox[1] - bbox.max.y;
+  flipped.max.y = vox[1] - bbox.min.y;
+  flipped.min.z = vox[2] - bbox.max.z;
+  flipped.max.z = vox[2] - bbox.min.z;
+  vec3 bmin = (vec3(flipped.min) - vec3(vox)/2.f) * dist * scale;
+  vec3 bmax = (vec3(flipped.max) - vec3(vox)/2.f) * dist * scale;
+
+  return aabb(bmin, bmax);
+}
+
+std::vector<visionaray::aabb> MacrocellGrid::get_leaf_nodes(visionaray::vec3 eye, bool frontToBack) const
+{
+  using namespace visionaray;
+
+  // Cell of the unclipped lattice that contains the eye, in voxel
+  // coordinates (y and z are flipped), may be outside of the grid
+  vec3 eye_vox = eye / (dist * scale) + vec3(vox) / 2.f;
+  eye_vox.y = vox[1] - eye_vox.y;
+  eye_vox.z = vox[2] - eye_vox.z;
+
+  vec3i eye_cell(
+      static_cast<int>(std::floor(eye_vox.x / cellsize.x)),
+      static_cast<int>(std::floor(eye_vox.y / cellsize.y)),
+      static_cast<int>(std::floor(eye_vox.z / cellsize.z))
+      );
+
+  // Boundary cells are clipped, but they still lie inside their lattice cells.
+  // Along any ray from the eye the cell index moves away from the eye's cell
+  // on each axis, so a cell can only be occluded by cells that are fewer cell
+  // steps away from the eye. Sorting by that number yields a visibility order
+  struct Cell
+  {
+    int steps;
+    aabb bbox;
+  };
+
+  std::vector<Cell> cells;
+
+  for (int z = 0; z < num_cells.z; ++z)
+  {
+    for (int y = 0; y < num_cells.y; ++y)
+    {
+      for (int x = 0; x < num_cells.x; ++x)
+      {
+        if (occupancy[z * num_cells.x * num_cells.y + y * num_cells.x + x] != 0.0f)
+        {
+          int steps = std::abs(x - eye_cell.x) + std::abs(y - eye_cell.y) + std::abs(z - eye_cell.z);
+          Cell c = { steps, cell_bounds(x, y, z) };
+          cells.push_back(c);
+        }
+      }
+    }
+  }
+
+  std::stable_sort(cells.begin(), cells.end(), [&](Cell const& a, Cell const& b)
+  {
+    return frontToBack ? a.steps < b.steps : a.steps > b.steps;
+  });
+
+  std::vector<aabb> result(cells.size());
+
+  for (size_t i = 0; i < cells.size(); ++i)
+  {
+    result[i] = cells[i].bbox;
+  }
+
+  return result;
+}
+
+void MacrocellGrid::renderGL(vvColor color) const
+{
+  using namespace visionaray;
+
+  glBegin(GL_LINES);
+  glColor3f(color[0], color[1], color[2]);
+
+  for (int z = 0; z < num_cells.z; ++z)
+  {
+    for (int y = 0; y < num_cells.y; ++y)
+    {
+      for (int x = 0; x < num_cells.x; ++x)
+      {
+        if (occupancy[z * num_cells.x * num_cells.y + y * num_cells.x + x] == 0.0f)
+        {
+          continue;
+        }
+
+        aabb bbox = cell_bounds(x, y, z);
+        vec3 bmin = bbox.min;
+        vec3 bmax = bbox.max;
+
+        glVertex3f(bmin.x, bmin.y, bmin.z);
+        glVertex3f(bmax.x, bmin.y, bmin.z);
+
+        glVertex3f(bmax.x, bmin.y, bmin.z);
+        glVertex3f(bmax.x, bmax.y, bmin.z);
+
+        glVertex3f(bmax.x, bmax.y, bmin.z);
+        glVertex3f(bmin.x, bmax.y, bmin.z);
+
+        glVertex3f(bmin.x, bmax.y, bmin.z);
+        glVertex3f(bmin.x, bmin.y, bmin.z);
+
+        //
+        glVertex3f(bmin.x, bmin.y, bmax.z);
+        glVertex3f(bmax.x, bmin.y, bmax.z);
+
+        glVertex3f(bmax.x, bmin.y, bmax.z);
+        glVertex3f(bmax.x, bmax.y, bmax.z);
+
+        glVertex3f(bmax.x, bmax.y, bmax.z);
+        glVertex3f(bmin.x, bmax.y, bmax.z);
+
+        glVertex3f(bmin.x, bmax.y, bmax.z);
+        glVertex3f(bmin.x, bmin.y, bmax.z);
+
+        //
+        glVertex3f(bmin.x, bmin.y, bmin.z);
+        glVertex3f(bmin.x, bmin.y, bmax.z);
+
+        glVertex3f(bmax.x, bmin.y, bmin.z);
+        glVertex3f(bmax.x, bmin.y, bmax.z);
+
+        glVertex3f(bmax.x, bmax.y, bmin.z);
+        glVertex3f(bmax.x, bmax.y, bmax.z);
+
+        glVertex3f(bmin.x, bmax.y, bmin.z);
+        glVertex3f(bmin.x, bmax.y, bmax.z);
+      }
+    }
+  }
+
+  glEnd();
+}
@@ -0,0 +1,98 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef VV_SPACESKIP_GRID_H
+#define VV_SPACESKIP_GRID_H
+
+#include <vector>
+
+#undef MATH_NAMESPACE
+
+#include <visionaray/math/aabb.h>
+#include <visionaray/math/forward.h>
+#include <visionaray/math/vector.h>
+
+#include "vvcolor.h"
+#include "vvvoldesc.h"
+
+//-------------------------------------------------------------------------------------------------
+// Min/max macrocell grid
+//
+// Each cell stores the range of the voxel values it covers (including a one voxel border so that
+// trilinear interpolation at the cell boundaries is accounted for). Reclassifying the grid for a
+// new transfer function only requires a prefix sum over the transfer function entries and a
+// constant time lookup per cell. A coarse level, where each cell covers coarse_factor^3 cells,
+// lets rays skip large empty regions in few steps.
+//
+
+struct MacrocellGrid
+{
+  void updateVolume(vvVolDesc const& vd, int channel = 0);
+
+  void updateTransfunc(visionaray::vec4 const* transfunc, int numEntries);
+
+  std::vector<visionaray::aabb> get_leaf_nodes(visionaray::vec3 eye, bool frontToBack) const;
+
+  // Need OpenGL context!
+  void renderGL(vvColor color) const;
+
+  // Object space bounds of cell (x,y,z)
+  visionaray::aabb cell_bounds(int x, int y, int z) const;
+
+  // Reclassify value ranges against the current visibility table
+  void classify();
+
+  // Update the coarse level from the occupancy of the cells
+  void update_coarse_occupancy();
+
+  visionaray::vec3i cellsize = visionaray::vec3i(8, 8, 8);
+  visionaray::vec3i num_cells = visionaray::vec3i(0);
+
+  // Normalized [0..1] value range per cell, x fastest
+  std::vector<visionaray::vec2> value_ranges;
+  // 1 if the cell contains visible voxels, else 0
+  std::vector<float> occupancy;
+
+  // Coarse level, 1 if any of the cells covered is occupied, else 0
+  int coarse_factor = 4;
+  visionaray::vec3i num_coarse_cells = visionaray::vec3i(0);
+  std::vector<float> coarse_occupancy;
+
+  // Prefix sum over the visible transfer function entries
+  std::vector<int> visible_entries;
+
+  // Premultiplied transfer function colors, and per cell the component-wise
+  // max. and min. color any voxel in the cell can be classified as. Used to
+  // cull cells in max. and min. intensity projection
+  std::vector<visionaray::vec4> colors;
+  std::vector<visionaray::vec4> max_colors;
+  std::vector<visionaray::vec4> min_colors;
+
+  visionaray::vec3i vox;
+  visionaray::vec3 dist;
+  float scale;
+
+  // Build times of the last update [sec.]
+  double volume_time = 0.0;
+  double classify_time = 0.0;
+};
+
+#endif // VV_SPACESKIP_GRID_H
@@ -18,6 +18,10 @@
 // License along with this library (see license.txt); if not, write to the
 // Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
+#include <thread>
+#include <utility>
+
+#include <virvo/vvclock.h>
 #include <virvo/vvopengl.h>
 
 #include "kdtree.h"
@@ -26,17 +30,36 @@ void KdTree::updateVolume(vvVolDesc const& vd, int channel)
 {
   using namespace visionaray;
 
+  vvStopwatch sw; sw.start();
+
   vox = vec3i(vd.vox.x, vd.vox.y, vd.vox.z);
   dist = vec3(vd.getDist().x, vd.getDist().y, vd.getDist().z);
   scale = vd._scale;
 
   psvt.reset(vd, aabbi(vec3i(0), vox), channel);
+
+  volume_time = sw.getTime();
 }
 
-void KdTree::node_splitting(KdTree::NodePtr& n)
+void KdTree::node_splitting(KdTree::NodePtr& n, KdTree::Node* old_root)
 {
   using namespace visionaray;
 
+  // Take over the previous subtree if no voxel inside was reclassified
+  if (old_root != nullptr && !psvt.is_dirty(n->bbox))
+  {
+    Node* old = find_node(old_root, n->bbox);
+
+    if (old != nullptr)
+    {
+      n->axis = old->axis;
+      n->splitpos = old->splitpos;
+      n->left = std::move(old->left);
+      n->right = std::move(old->right);
+      return;
+    }
+  }
+
   // Halting criterion 1.)
   if (volume(n->bbox) < volume(root->bbox) / 10)
     return;
@@ -71,6 +94,10 @@ void KdTree::node_splitting(KdTree::NodePtr& n)
 
   int vol = volume(n->bbox);
 
+  // Below the root, sibling subtrees are split concurrently
+  // and must not share the SVT's thread pool
+  bool parallel = n->depth == 0;
+
   for (int p = 1; p < num_planes; ++p)
   {
     aabbi ltmp = n->bbox;
@@ -79,8 +106,8 @@ void KdTree::node_splitting(KdTree::NodePtr& n)
     ltmp.max[axis] = first + dl * p;
     rtmp.min[axis] = first + dl * p;
 
-    ltmp = psvt.boundary(ltmp);
-    rtmp = psvt.boundary(rtmp);
+    ltmp = psvt.boundary(ltmp, parallel);
+    rtmp = psvt.boundary(rtmp, parallel);
 
     int c = volume(ltmp) + volume(rtmp);
 
@@ -111,12 +138,41 @@ void KdTree::node_splitting(KdTree::NodePtr& n)
   n->left.reset(new Node);
   n->left->bbox = lbox;
   n->left->depth = n->depth + 1;
-  node_splitting(n->left);
 
   n->right.reset(new Node);
   n->right->bbox = rbox;
   n->right->depth = n->depth + 1;
-  node_splitting(n->right);
+
+  // Split the top levels of the hierarchy as parallel tasks
+  if (n->depth < parallel_depth)
+  {
+    std::thread task([&]() { node_splitting(n->left, old_root); });
+    node_splitting(n->right, old_root);
+    task.join();
+  }
+  else
+  {
+    node_splitting(n->left, old_root);
+    node_splitting(n->right, old_root);
+  }
+}
+
+KdTree::Node* KdTree::find_node(KdTree::Node* n, visionaray::aabbi const& bbox) const
+{
+  while (n != nullptr)
+  {
+    if (n->bbox.min == bbox.min && n->bbox.max == bbox.max)
+      return n;
+
+    if (n->left != nullptr && n->left->bbox.contains(bbox))
+      n = n->left.get();
+    else if (n->right != nullptr && n->right->bbox.contains(bbox))
+      n = n->right.get();
+    else
+      return nullptr;
+  }
+
+  return nullptr;
 }
 
 std::vector<visionaray::aabb> KdTree::get_leaf_nodes(visionaray::vec3 eye, bool frontToBack) const
@@ -129,21 +185,79 @@ std::vector<visionaray::aabb> KdTree::get_leaf_nodes(visionaray::vec3 eye, bool
   {
     if (n->left == nullptr && n->right == nullptr)
     {
-      auto bbox = n->bbox;
-      bbox.min.y = vox[1] - n->bbox.max.y;
-      bbox.max.y = vox[1] - n->bbox.min.y;
-      bbox.min.z = vox[2] - n->bbox.max.z;
-      bbox.max.z = vox[2] - n->bbox.min.z;
-      vec3 bmin = (vec3(bbox.min) - vec3(vox)/2.f) * dist * scale;
-      vec3 bmax = (vec3(bbox.max) - vec3(vox)/2.f) * dist * scale;
-
-      result.push_back(aabb(bmin, bmax));
+      result.push_back(object_bounds(n->bbox));
     }
   }, frontToBack);
 
   return result;
 }
 
+std::vector<KdTree::FlatNode> KdTree::get_flat_nodes() const
+{
+  using namespace visionaray;
+
+  std::vector<FlatNode> result;
+
+  if (root == nullptr)
+    return result;
+
+  // Nodes are appended before their subtrees are flattened,
+  // so that the two children of a node are stored next to each other
+  std::vector<std::pair<Node const*, size_t>> stack;
+
+  result.push_back(FlatNode());
+  stack.push_back(std::make_pair(root.get(), size_t(0)));
+
+  while (!stack.empty())
+  {
+    Node const* n = stack.back().first;
+    size_t index = stack.back().second;
+    stack.pop_back();
+
+    FlatNode& flat = result[index];
+    flat.bbox = object_bounds(n->bbox);
+    flat.axis = -1;
+    flat.splitpos = 0.0f;
+    flat.children = -1;
+
+    if (n->left == nullptr || n->right == nullptr)
+      continue;
+
+    // y and z are flipped in object space, the left child is
+    // below the split plane only along x
+    int axis = n->axis;
+    int spi = axis == 0 ? n->splitpos : vox[axis] - n->splitpos;
+    Node const* below = axis == 0 ? n->left.get() : n->right.get();
+    Node const* above = axis == 0 ? n->right.get() : n->left.get();
+
+    flat.axis = axis;
+    flat.splitpos = (spi - vox[axis]/2.f) * dist[axis] * scale;
+    flat.children = static_cast<int>(result.size());
+
+    // flat is invalidated here
+    result.resize(result.size() + 2);
+    stack.push_back(std::make_pair(below, result.size() - 2));
+    stack.push_back(std::make_pair(above, result.size() - 1));
+  }
+
+  return result;
+}
+
+visionaray::aabb KdTree::object_bounds(visionaray::aabbi const& bbox) const
+{
+  using namespace visionaray;
+
+  auto b = bbox;
+  b.min.y = vox[1] - bbox.max.y;
+  b.max.y = vox[1] - bbox.min.y;
+  b.min.z = vox[2] - bbox.max.z;
+  b.max.z = vox[2] - bbox.min.z;
+  vec3 bmin = (vec3(b.min) - vec3(vox)/2.f) * dist * scale;
+  vec3 bmax = (vec3(b.max) - vec3(vox)/2.f) * dist * scale;
+
+  return aabb(bmin, bmax);
+}
+
 void KdTree::renderGL(vvColor color) const
 {
   renderGL(root, color);
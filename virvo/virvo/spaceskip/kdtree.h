@@ -27,7 +27,6 @@
 #include "svt.h"
 
 #define FRAME_TIMING 0
-#define BUILD_TIMING 1
 #define KDTREE       1
 
 //-------------------------------------------------------------------------------------------------
@@ -107,15 +106,42 @@ struct KdTree
   visionaray::vec3 dist;
   float scale;
 
+  // Build times of the last update [sec.]
+  double volume_time = 0.0;
+  double svt_time = 0.0;
+  double splitting_time = 0.0;
+
+  // Subtrees above this depth are split concurrently
+  int parallel_depth = 3;
+
   void updateVolume(vvVolDesc const& vd, int channel = 0);
 
   template <typename Tex>
   void updateTransfunc(Tex transfunc);
 
-  void node_splitting(NodePtr& n);
+  // Subtrees of old_root are taken over where no brick was rebuilt
+  void node_splitting(NodePtr& n, Node* old_root = nullptr);
+
+  // Find the node with the given bounds in the subtree of n
+  Node* find_node(Node* n, visionaray::aabbi const& bbox) const;
 
   std::vector<visionaray::aabb> get_leaf_nodes(visionaray::vec3 eye, bool frontToBack) const;
 
+  // Node of the flattened tree, in object space
+  struct FlatNode
+  {
+    visionaray::aabb bbox;
+    int axis;       // -1 for leaves
+    float splitpos;
+    int children;   // index of the child below the split plane, the one above follows
+  };
+
+  // The tree as a node array with the root first, empty if there is no tree
+  std::vector<FlatNode> get_flat_nodes() const;
+
+  // Object space bounds of a node
+  visionaray::aabb object_bounds(visionaray::aabbi const& bbox) const;
+
   // Need OpenGL context!
   void renderGL(vvColor color) const;
   // Need OpenGL context!
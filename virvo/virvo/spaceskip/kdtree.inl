@@ -25,22 +25,30 @@ void KdTree::updateTransfunc(Tex transfunc)
 {
   using namespace visionaray;
 
-#ifdef BUILD_TIMING
   vvStopwatch sw; sw.start();
-#endif
   psvt.build(transfunc);
-#ifdef BUILD_TIMING
-  std::cout << std::fixed << std::setprecision(3) << "svt update: " << sw.getTime() << " sec.\n";
-#endif
+  svt_time = sw.getTime();
+
+  // Occupancy did not change, keep the tree
+  if (root != nullptr && psvt.dirty_bricks.empty())
+  {
+    splitting_time = 0.0;
+    return;
+  }
 
-#ifdef BUILD_TIMING
   sw.start();
-#endif
+  NodePtr old_root = std::move(root);
+
   root.reset(new Node);
   root->bbox = psvt.boundary(aabbi(vec3i(0), vec3i(vox[0], vox[1], vox[2])));
   root->depth = 0;
-  node_splitting(root);
-#ifdef BUILD_TIMING
-  std::cout << "splitting: " << sw.getTime() << " sec.\n";
-#endif
+
+  // The halting criterion depends on the root volume,
+  // subtrees can only be reused if it did not change
+  bool reuse = old_root != nullptr
+      && old_root->bbox.min == root->bbox.min
+      && old_root->bbox.max == root->bbox.max;
+
+  node_splitting(root, reuse ? old_root.get() : nullptr);
+  splitting_time = sw.getTime();
 }
@@ -21,6 +21,7 @@
 #ifndef VV_SPACESKIP_SVT_H
 #define VV_SPACESKIP_SVT_H
 
+#include <algorithm>
 #include <thread>
 #include <vector>
 
@@ -37,6 +38,7 @@
 #undef MATH_NAMESPACE
 
 #include "vvvoldesc.h"
+#include "vvvolumeview.h"
 
 //-------------------------------------------------------------------------------------------------
 // Summed-volume table
@@ -48,8 +50,13 @@ struct SVT
   void reset(visionaray::aabbi bbox);
   void reset(vvVolDesc const& vd, visionaray::aabbi bbox, int channel = 0);
 
-  template <typename Tex>
-  void build(Tex transfunc);
+  // Copy the channel values inside bbox from a typed volume view
+  template <typename V>
+  void copy_voxels(V const& view, visionaray::aabbi bbox, int channel);
+
+  // Classify with a per transfer function entry visibility table
+  // (nearest neighbor lookup) and build the summed-volume table
+  void build(uint8_t const* visible, int numEntries);
 
   visionaray::aabbi boundary(visionaray::aabbi bbox) const;
 
@@ -133,112 +140,102 @@ void SVT<T>::reset(vvVolDesc const& vd, visionaray::aabbi bbox, int channel)
   height = bbox.size().y;
   depth  = bbox.size().z;
 
+  size_t frame = vd.getCurrentFrame();
 
-  for (int z = 0; z < depth; ++z)
+  switch (vd.bpc)
   {
-    for (int y = 0; y < height; ++y)
-    {
-      for (int x = 0; x < width; ++x)
-      {
-        size_t index = z * width * height + y * width + x;
-        voxels_[index] = vd.getChannelValue(vd.getCurrentFrame(),
-                bbox.min.x + x,
-                bbox.min.y + y,
-                bbox.min.z + z,
-                channel);
-      }
-    }
+  case 1:
+    copy_voxels(virvo::VolumeView<uint8_t>(vd, frame), bbox, channel);
+    break;
+  case 2:
+    copy_voxels(virvo::VolumeView<uint16_t>(vd, frame), bbox, channel);
+    break;
+  case 4:
+    copy_voxels(virvo::VolumeView<float>(vd, frame), bbox, channel);
+    break;
   }
 }
 
 template <typename T>
-template <typename Tex>
-void SVT<T>::build(Tex transfunc)
+template <typename V>
+void SVT<T>::copy_voxels(V const& view, visionaray::aabbi bbox, int channel)
 {
-  using namespace visionaray;
+  if (!view.valid())
+  {
+    // Frame not available, treat as empty
+    std::fill(voxels_.begin(), voxels_.end(), 0.0f);
+    return;
+  }
 
-  // Apply transfer function
   for (int z = 0; z < depth; ++z)
   {
     for (int y = 0; y < height; ++y)
     {
+      size_t src = view.index(bbox.min.x, bbox.min.y + y, bbox.min.z + z);
+      size_t dst = z * width * height + y * width;
+
       for (int x = 0; x < width; ++x)
       {
-        size_t index = z * width * height + y * width + x;
-        if (tex1D(transfunc, voxels_[index]).w < 0.0001)
-          at(x, y, z) = T(0);
-        else
-          at(x, y, z) = T(1);
+        voxels_[dst + x] = view.value(src + x, channel);
       }
     }
   }
+}
 
+template <typename T>
+void SVT<T>::build(uint8_t const* visible, int numEntries)
+{
+  // Apply transfer function
+  float scale = static_cast<float>(numEntries);
 
-  // Build summed volume table
-
-  // Init 0-border voxel
-  //at(0, 0, 0) = at(0, 0, 0);
-
-  // Init 0-border edges (prefix sum)
-  for (int x=1; x<width; ++x)
-  {
-    at(x, 0, 0) = at(x, 0, 0) + at(x-1, 0, 0);
-  }
-
-  for (int y=1; y<height; ++y)
+  for (size_t i = 0; i < voxels_.size(); ++i)
   {
-    at(0, y, 0) = at(0, y, 0) + at(0, y-1, 0);
+    int index = static_cast<int>(voxels_[i] * scale);
+    index = index < 0 ? 0 : index >= numEntries ? numEntries - 1 : index;
+    data_[i] = T(visible[index]);
   }
 
-  for (int z=1; z<depth; ++z)
-  {
-    at(0, 0, z) = at(0, 0, z) + at(0, 0, z-1);
-  }
 
+  // Build summed volume table as successive prefix sums along x, y and z.
+  // The y and z passes accumulate whole rows so that the inner loops vectorize
 
-  // Init 0-border planes (summed-area tables)
-  for (int y=1; y<height; ++y)
+  for (int z = 0; z < depth; ++z)
   {
-    for (int x=1; x<width; ++x)
+    for (int y = 0; y < height; ++y)
     {
-      at(x, y, 0) = at(x, y, 0)
-        + at(x-1, y, 0) + at(x, y-1, 0)
-        - at(x-1, y-1, 0);
-    }
-  }
+      T* row = &at(0, y, z);
 
-  for (int z=1; z<depth; ++z)
-  {
-    for (int y=1; y<height; ++y)
-    {
-      at(0, y, z) = at(0, y, z)
-        + at(0, y-1, z) + at(0, y, z-1)
-        - at(0, y-1, z-1);
+      for (int x = 1; x < width; ++x)
+      {
+        row[x] += row[x - 1];
+      }
     }
   }
 
-  for (int x=1; x<width; ++x)
+  for (int z = 0; z < depth; ++z)
   {
-    for (int z=1; z<depth; ++z)
+    for (int y = 1; y < height; ++y)
     {
-      at(x, 0, z) = at(x, 0, z)
-        + at(x-1, 0, z) + at(x, 0, z-1)
-        - at(x-1, 0, z-1);
+      T* row = &at(0, y, z);
+      T const* prev = &at(0, y - 1, z);
+
+      for (int x = 0; x < width; ++x)
+      {
+        row[x] += prev[x];
+      }
     }
   }
 
-
-  // Build up SVT
-  for (int z=1; z<depth; ++z)
+  for (int z = 1; z < depth; ++z)
   {
-    for (int y=1; y<height; ++y)
+    for (int y = 0; y < height; ++y)
     {
-      for (int x=1; x<width; ++x)
+      T* row = &at(0, y, z);
+      T const* prev = &at(0, y, z - 1);
+
+      for (int x = 0; x < width; ++x)
       {
-        at(x, y, z) = at(x, y, z) + at(x-1, y-1, z-1)
-          + at(x-1, y, z) - at(x, y-1, z-1)
-          + at(x, y-1, z) - at(x-1, y, z-1)
-          + at(x, y, z-1) - at(x-1, y-1, z);
+        row[x] += prev[x];
       }
     }
   }
@@ -347,18 +344,38 @@ struct PartialSVT
 
   void reset(vvVolDesc const& vd, visionaray::aabbi bbox, int channel = 0);
 
+  // Only rebuilds the bricks whose value range overlaps transfer
+  // function entries that changed their visibility
   template <typename Tex>
   void build(Tex transfunc);
 
-  visionaray::aabbi boundary(visionaray::aabbi bbox);
+  // Set parallel to false when called concurrently from multiple threads,
+  // the thread pool is not reentrant
+  visionaray::aabbi boundary(visionaray::aabbi bbox, bool parallel = true);
 
   uint64_t get_count(visionaray::aabbi bounds) const;
 
+  // Test if bbox overlaps a brick that was rebuilt by the last call to build()
+  bool is_dirty(visionaray::aabbi bbox) const;
+
+  visionaray::aabbi brick_bounds(int b) const;
+
   visionaray::vec3i bricksize = visionaray::vec3i(32, 32, 32);
 
   visionaray::vec3i num_svts;
   std::vector<svt_t> svts;
 
+  // Per brick [min..max] range of the voxel values (TF lookup coordinates)
+  std::vector<visionaray::vec2> value_ranges;
+
+  // Visibility of the transfer function entries the SVTs were built with
+  std::vector<uint8_t> visible_entries;
+
+  // Bricks that were rebuilt by the last call to build()
+  std::vector<visionaray::aabbi> dirty_bricks;
+
+  visionaray::vec3i vox;
+
   visionaray::thread_pool pool;
 };
 
@@ -371,6 +388,12 @@ inline void PartialSVT::reset(vvVolDesc const& vd, visionaray::aabbi bbox, int c
                    div_up(bbox.max.z, bricksize.z));
 
   svts.resize(num_svts.x * num_svts.y * num_svts.z);
+  value_ranges.resize(svts.size());
+
+  vox = bbox.max;
+
+  // Volume changed, all bricks need to be rebuilt
+  visible_entries.clear();
 
 
   // Fill with volume channel values
@@ -388,7 +411,11 @@ inline void PartialSVT::reset(vvVolDesc const& vd, visionaray::aabbi bbox, int c
         vec3i bmax(min(bbox.max.x, bx + bricksize.x),
                    min(bbox.max.y, by + bricksize.y),
                    min(bbox.max.z, bz + bricksize.z));
-        svts[z * num_svts.x * num_svts.y + y * num_svts.x + x].reset(vd, aabbi(bmin, bmax), channel);
+        size_t b = z * num_svts.x * num_svts.y + y * num_svts.x + x;
+        svts[b].reset(vd, aabbi(bmin, bmax), channel);
+
+        auto mm = std::minmax_element(svts[b].voxels_.begin(), svts[b].voxels_.end());
+        value_ranges[b] = vec2(*mm.first, *mm.second);
 
         bx += bricksize.x;
       }
@@ -405,13 +432,91 @@ inline void PartialSVT::build(Tex transfunc)
 {
   using namespace visionaray;
 
-  parallel_for(pool, range1d<size_t>(0, svts.size()), [this, transfunc](size_t i)
+  // Classify the transfer function entries once, voxels are
+  // classified with a table lookup instead of tex1D()
+  int n = static_cast<int>(transfunc.width());
+
+  std::vector<uint8_t> visible(n);
+  for (int i = 0; i < n; ++i)
+  {
+    visible[i] = tex1D(transfunc, (i + 0.5f) / n).w < 0.0001 ? 0 : 1;
+  }
+
+  // Range of entries whose visibility changed
+  int first = 0;
+  int last = n - 1;
+
+  if (visible_entries.size() == visible.size())
+  {
+    first = n;
+    last = -1;
+
+    for (int i = 0; i < n; ++i)
+    {
+      if (visible[i] != visible_entries[i])
+      {
+        first = std::min(first, i);
+        last = std::max(last, i);
+      }
+    }
+  }
+
+  visible_entries = visible;
+
+  std::vector<size_t> dirty;
+
+  for (size_t b = 0; b < svts.size(); ++b)
+  {
+    int lo = clamp(static_cast<int>(value_ranges[b].x * n), 0, n - 1);
+    int hi = clamp(static_cast<int>(value_ranges[b].y * n), 0, n - 1);
+
+    if (lo <= last && first <= hi)
+    {
+      dirty.push_back(b);
+    }
+  }
+
+  dirty_bricks.resize(dirty.size());
+
+  parallel_for(pool, range1d<size_t>(0, dirty.size()), [&](size_t i)
   {
-    svts[i].build(transfunc);
+    svts[dirty[i]].build(visible_entries.data(), n);
+    dirty_bricks[i] = brick_bounds(static_cast<int>(dirty[i]));
   });
 }
 
-inline visionaray::aabbi PartialSVT::boundary(visionaray::aabbi bbox)
+inline bool PartialSVT::is_dirty(visionaray::aabbi bbox) const
+{
+  for (auto const& b : dirty_bricks)
+  {
+    if (bbox.min.x < b.max.x && b.min.x < bbox.max.x
+     && bbox.min.y < b.max.y && b.min.y < bbox.max.y
+     && bbox.min.z < b.max.z && b.min.z < bbox.max.z)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+inline visionaray::aabbi PartialSVT::brick_bounds(int b) const
+{
+  using namespace visionaray;
+
+  int bz = b / (num_svts.x * num_svts.y);
+  int by = (b / num_svts.x) % num_svts.y;
+  int bx = b % num_svts.x;
+
+  vec3i bmin(bx * bricksize.x, by * bricksize.y, bz * bricksize.z);
+  vec3i bmax(min(vox.x, bmin.x + bricksize.x),
+             min(vox.y, bmin.y + bricksize.y),
+             min(vox.z, bmin.z + bricksize.z));
+
+  return aabbi(bmin, bmax);
+}
+
+inline visionaray::aabbi PartialSVT::boundary(visionaray::aabbi bbox, bool parallel)
 {
   using namespace visionaray;
 
@@ -427,7 +532,7 @@ inline visionaray::aabbi PartialSVT::boundary(visionaray::aabbi bbox)
   int n = num_bricks.x * num_bricks.y * num_bricks.z;
   std::vector<aabbi> brick_boundaries(n);
 
-  parallel_for(pool, range1d<int>(0, n), [&](int b)
+  auto brick_boundary = [&](int b)
   {
     int bz = min_brick.z + b / (num_bricks.x * num_bricks.y);
     int by = min_brick.y + (b / num_bricks.x) % num_bricks.y;
@@ -454,7 +559,19 @@ inline visionaray::aabbi PartialSVT::boundary(visionaray::aabbi bbox)
 
     brick_boundaries[i].min += vec3i(bx * bricksize.x, by * bricksize.y, bz * bricksize.z);
     brick_boundaries[i].max += vec3i(bx * bricksize.x, by * bricksize.y, bz * bricksize.z);
-  });
+  };
+
+  if (parallel)
+  {
+    parallel_for(pool, range1d<int>(0, n), brick_boundary);
+  }
+  else
+  {
+    for (int b = 0; b < n; ++b)
+    {
+      brick_boundary(b);
+    }
+  }
 
   bounds.invalidate();
 
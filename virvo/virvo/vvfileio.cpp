@@ -33,6 +33,7 @@
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/checked_delete.hpp>
 
 #include <math.h>
 #include <limits.h>
@@ -43,8 +44,10 @@
 #include <map>
 
 #include "vvfileio.h"
+#include "vvframeprovider.h"
 #include "vvmacros.h"
 #include "vvpixelformat.h"
+#include "vvsllist.h"
 #include "vvtoolshed.h"
 #include "vvdebugmsg.h"
 #include "vvtokenizer.h"
@@ -196,6 +199,8 @@ vvFileIO::vvFileIO()
   strcpy(_nrrdID, "NRRD0001");
   _sections = ALL_DATA;
   _compression = true;
+  _memoryMapping = false;
+  _frameCache = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -1035,6 +1040,93 @@ vvFileIO::ErrorType vvFileIO::saveXVFFile(vvVolDesc* vd)
   return OK;
 }
 
+//----------------------------------------------------------------------------
+/// Loads the frames of an XVF file on demand, see vvFileIO::setFrameCache()
+class XVFFrameProvider : public vvFrameProvider
+{
+  public:
+    struct Frame
+    {
+      std::streamoff offset;                      ///< file position of the voxel data
+      size_t encodedSize;                         ///< size of RLE encoded data, 0 if not encoded
+    };
+
+    XVFFrameProvider(std::string const& filename, std::vector<Frame> const& frameTable,
+        size_t frameSize, size_t bpv, size_t bpc, bool toggleEndianness)
+      : _filename(filename)
+      , _frameTable(frameTable)
+      , _frameSize(frameSize)
+      , _bpv(bpv)
+      , _bpc(bpc)
+      , _toggleEndianness(toggleEndianness)
+    {
+    }
+
+    boost::shared_ptr<uint8_t> loadFrame(size_t frame)
+    {
+      if (frame >= _frameTable.size()) return boost::shared_ptr<uint8_t>();
+
+      // Every request uses its own stream, so frames may be loaded concurrently
+      std::ifstream file(_filename.c_str(), std::ios::binary);
+      if (!file.is_open())
+      {
+        vvDebugMsg::msg(1, "Error: Cannot open file.");
+        return boost::shared_ptr<uint8_t>();
+      }
+      file.seekg(_frameTable[frame].offset, file.beg);
+
+      boost::shared_ptr<uint8_t> raw(new uint8_t[_frameSize], boost::checked_array_deleter<uint8_t>());
+      size_t encodedSize = _frameTable[frame].encodedSize;
+      if (encodedSize>0)
+      {
+        std::vector<uint8_t> encoded(encodedSize);
+        file.read(reinterpret_cast< char* >(&encoded[0]), encodedSize);
+        size_t outsize;
+        if (static_cast< size_t >(file.gcount()) != encodedSize ||
+            vvToolshed::decodeRLE(raw.get(), &encoded[0], encodedSize, _bpv, _frameSize, &outsize) != vvToolshed::VV_OK)
+        {
+          vvDebugMsg::msg(1, "Error: Cannot decode frame ", static_cast<int>(frame));
+          return boost::shared_ptr<uint8_t>();
+        }
+      }
+      else                                        // no encoding
+      {
+        file.read(reinterpret_cast< char* >(raw.get()), _frameSize);
+        if (static_cast< size_t >(file.gcount()) != _frameSize)
+        {
+          vvDebugMsg::msg(1, "Error: Insuffient voxel data in file.");
+          return boost::shared_ptr<uint8_t>();
+        }
+      }
+
+      if (_toggleEndianness)
+      {
+        const size_t n = _frameSize / _bpc;
+        if (_bpc == 2)
+        {
+          uint16_t* r = reinterpret_cast<uint16_t*>(raw.get());
+          for (size_t i=0; i<n; ++i)
+            r[i] = byte_swap<little_endian, big_endian, uint16_t>(r[i]);
+        }
+        else if (_bpc == 4)
+        {
+          uint32_t* r = reinterpret_cast<uint32_t*>(raw.get());
+          for (size_t i=0; i<n; ++i)
+            r[i] = byte_swap<little_endian, big_endian, uint32_t>(r[i]);
+        }
+      }
+      return raw;
+    }
+
+  private:
+    std::string _filename;
+    std::vector<Frame> _frameTable;
+    size_t _frameSize;
+    size_t _bpv;
+    size_t _bpc;
+    bool _toggleEndianness;
+};
+
 //----------------------------------------------------------------------------
 /** Loader for voxel file in xvf (extended volume file) format.
  File format: see saveXVFFile()
@@ -1322,14 +1414,48 @@ vvFileIO::ErrorType vvFileIO::loadXVFFile(vvVolDesc* vd)
   if ((_sections & RAW_DATA) != 0)
   {
     file.seekg(tok.getFilePos(), file.beg);
+
+    // Out-of-core: only read the frame table, voxels are loaded on demand
+    if (_frameCache > 0 && vd->frames > _frameCache)
+    {
+      std::vector<XVFFrameProvider::Frame> frameTable(vd->frames);
+      for (size_t f=0; f<vd->frames; ++f)
+      {
+        if (io32bit)
+          frameTable[f].encodedSize = virvo::serialization::read32(file);
+        else
+          frameTable[f].encodedSize = virvo::serialization::read64(file);
+        frameTable[f].offset = file.tellg();
+        file.seekg(frameTable[f].encodedSize>0 ? frameTable[f].encodedSize : frameSize, file.cur);
+        if (!file)
+        {
+          vvDebugMsg::msg(1, "Error: Insuffient voxel data in file.");
+          return DATA_ERROR;
+        }
+      }
+      boost::shared_ptr<vvFrameProvider> provider(new XVFFrameProvider(vd->getFilename(), frameTable,
+          frameSize, vd->getBPV(), vd->bpc, machineBigEndian != bigEnd));
+      vd->setFrameProvider(provider, _frameCache);
+      return OK;
+    }
+
+    // Byte swapping would write to every page of a mapped frame
+    bool mappable = _memoryMapping && (vd->bpc == 1 || machineBigEndian == bigEnd);
+
     encoded = new uint8_t[frameSize];
     for (size_t f=0; f<vd->frames; ++f)
     {
-      raw = new uint8_t[frameSize];                 // create new data space for volume data
       if (io32bit)
         encodedSize = virvo::serialization::read32(file);
       else
         encodedSize = virvo::serialization::read64(file);
+      if (encodedSize==0 && mappable &&
+          vd->addMappedFrame(vd->getFilename(), static_cast<size_t>(file.tellg())))
+      {
+        file.seekg(frameSize, file.cur);          // voxels stay in the file
+        continue;
+      }
+      raw = new uint8_t[frameSize];                 // create new data space for volume data
       if (encodedSize>0)
       {
         file.read(reinterpret_cast< char* >(encoded), encodedSize);
@@ -1587,7 +1713,7 @@ vvFileIO::ErrorType vvFileIO::loadVTKFile(vvVolDesc *vd)
       << (signedData ? "(signed)" : "(unsigned)")
       << std::endl;
   }
-  ErrorType err = loadRawFile(vd, dim[0], dim[1], dim[2], bpc, channels, pos);
+  ErrorType err = loadRawFile(vd, dim[0], dim[1], dim[2], bpc, channels, pos, machineBigEndian || bpc == 1);
   if (err != OK)
   {
     return err;
@@ -3682,8 +3808,10 @@ vvFileIO::ErrorType vvFileIO::saveRawFile(const vvVolDesc* vd)
   @param b      bytes per channel
   @param c      channels
   @param header header size in bytes (= number of bytes to skip at beginning of file)
+  @param mappable false if the caller modifies the data after loading, the
+                  frame is never memory mapped then, see setMemoryMapping()
 */
-vvFileIO::ErrorType vvFileIO::loadRawFile(vvVolDesc* vd, size_t w, size_t h, size_t s, size_t b, size_t c, size_t header)
+vvFileIO::ErrorType vvFileIO::loadRawFile(vvVolDesc* vd, size_t w, size_t h, size_t s, size_t b, size_t c, size_t header, bool mappable)
 {
   FILE* fp;
   size_t read;
@@ -3704,6 +3832,13 @@ vvFileIO::ErrorType vvFileIO::loadRawFile(vvVolDesc* vd, size_t w, size_t h, siz
   vd->bpc    = b;
   vd->setChan((int)c);
 
+  if (_memoryMapping && mappable && vd->addMappedFrame(vd->getFilename(), header))
+  {
+    fclose(fp);
+    ++vd->frames;
+    return OK;
+  }
+
   fseek(fp, static_cast<long>(header), SEEK_SET);                    // skip header
   rawData = new uint8_t[vd->getFrameBytes()];
   read = fread(rawData, vd->getFrameBytes(), 1, fp);
@@ -4017,7 +4152,7 @@ vvFileIO::ErrorType vvFileIO::loadVHDMRIFile(vvVolDesc* vd)
 {
   ErrorType err;
 
-  err = loadRawFile(vd, 256, 256, 1, 2, 1, 7900);
+  err = loadRawFile(vd, 256, 256, 1, 2, 1, 7900, false);
   if (err != OK) return err;
   if (!machineBigEndian) vd->toggleEndianness();
   vd->bitShiftData(-4);                           // image is (about) 12 bit, shift it to be in correct 16 bit representation
@@ -4031,7 +4166,7 @@ vvFileIO::ErrorType vvFileIO::loadVHDCTFile(vvVolDesc* vd)
 {
   ErrorType err;
 
-  err = loadRawFile(vd, 512, 512, 1, 2, 1, 3416);
+  err = loadRawFile(vd, 512, 512, 1, 2, 1, 3416, false);
   if (err != OK) return err;
   if (!machineBigEndian) vd->toggleEndianness();
   vd->bitShiftData(-4);                           // image is 12 bit, shift to appear as 16 bit
@@ -4595,7 +4730,7 @@ vvFileIO::ErrorType vvFileIO::loadVis04File(vvVolDesc* vd)
 
   vvDebugMsg::msg(1, "vvFileIO::loadVis04File()");
 
-  err = loadRawFile(vd, 500, 500, 100, 4, 1, 0);
+  err = loadRawFile(vd, 500, 500, 100, 4, 1, 0, machineBigEndian);
   if (err != OK) return err;
   if (!machineBigEndian) vd->toggleEndianness();                         // file is big endian
 
@@ -4811,7 +4946,8 @@ vvFileIO::ErrorType vvFileIO::loadHDRFile(vvVolDesc* vd)
     return DATA_ERROR;
   }
 
-  err = loadRawFile(vd, vd->vox[0], vd->vox[1], vd->vox[2], vd->bpc, vd->getChan(), skipBytes);
+  err = loadRawFile(vd, vd->vox[0], vd->vox[1], vd->vox[2], vd->bpc, vd->getChan(), skipBytes,
+      rightHanded && (bigEnd == machineBigEndian || vd->bpc == 1));
   vd->setFilename(filenameBak);
   delete[] filenameBak;
   if (err != OK) return err;
@@ -5602,6 +5738,34 @@ void vvFileIO::setCompression(bool newCompression)
   _compression = newCompression;
 }
 
+//----------------------------------------------------------------------------
+/** Set memory mapping mode for loading files.
+  If on, uncompressed frames of raw and XVF files are not copied to memory
+  but mapped copy-on-write from the file (see vvVolDesc::addMappedFrame()).
+  Frames that cannot be mapped are loaded as usual, and so are frames that
+  have to be converted while loading: 16 bit and float data stored in the
+  other byte order (e.g. XVF files, which are big endian, on little endian
+  machines), or left handed raw data with a .hdr file.
+  @param newMemoryMapping true = memory mapping on (default: off)
+*/
+void vvFileIO::setMemoryMapping(bool newMemoryMapping)
+{
+  _memoryMapping = newMemoryMapping;
+}
+
+//----------------------------------------------------------------------------
+/** Set the size of the frame cache for out-of-core time series.
+  If greater than zero, loading an XVF file with more frames than that only
+  reads the header and the frame table. The voxel data is loaded on demand
+  and at most the given number of frames is kept in memory
+  (see vvVolDesc::setFrameProvider()).
+  @param frames number of frames kept in memory, 0 = load all frames (default)
+*/
+void vvFileIO::setFrameCache(size_t frames)
+{
+  _frameCache = frames;
+}
+
 //----------------------------------------------------------------------------
 /** Parse a Leica confocal microscope type file name.
   Example: "Series006_z000_ch00.tif"
@@ -88,11 +88,13 @@ class VIRVO_FILEIOEXPORT vvFileIO
     ErrorType saveVolumeData(vvVolDesc *, bool, LoadType sec = ALL_DATA);
     ErrorType loadVolumeData(vvVolDesc*, LoadType sec = ALL_DATA, bool addFrame=false);
     ErrorType loadDicomFile(vvVolDesc*, int* = NULL, int* = NULL, float* = NULL);
-    ErrorType loadRawFile(vvVolDesc*, size_t, size_t, size_t, size_t, size_t, size_t);
+    ErrorType loadRawFile(vvVolDesc*, size_t, size_t, size_t, size_t, size_t, size_t, bool mappable=true);
     ErrorType loadXB7File(vvVolDesc*,int=128,int=8,bool=true);
     ErrorType loadCPTFile(vvVolDesc*,int=128,int=8,bool=true);
     ErrorType mergeFiles(vvVolDesc*, int, int, vvVolDesc::MergeType);
     void      setCompression(bool);
+    void      setMemoryMapping(bool);
+    void      setFrameCache(size_t);
     ErrorType importTF(vvVolDesc*, const char*);
 
   protected:
@@ -100,6 +102,8 @@ class VIRVO_FILEIOEXPORT vvFileIO
     char _nrrdID[9];                               ///< nrrd file ID
     int  _sections;                                ///< bit coded list of file sections to load
     bool _compression;                             ///< true = compression on (default)
+    bool _memoryMapping;                           ///< true = map uncompressed frames from the file instead of copying them
+    size_t _frameCache;                            ///< number of frames kept in memory for out-of-core time series, 0 = load all frames
 
     void setDefaultValues(vvVolDesc*);
     int  readASCIIint(FILE*);
@@ -0,0 +1,60 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_FRAMEPROVIDER_H
+#define VV_FRAMEPROVIDER_H
+
+#include <stddef.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include "vvexport.h"
+#include "vvinttypes.h"
+
+//============================================================================
+// Class Definition
+//============================================================================
+
+/** Source of volume frames that are not kept in memory.
+  A vvVolDesc with a frame provider keeps only a bounded working set of
+  frames resident and requests the other frames on demand, see
+  vvVolDesc::setFrameProvider().
+  loadFrame() is called from a background prefetch thread as well as from
+  the thread accessing the volume, so implementations have to be thread
+  safe.
+*/
+class VIRVO_FILEIOEXPORT vvFrameProvider
+{
+  public:
+    virtual ~vvFrameProvider() {}
+
+    /** Loads the voxel data of a frame in the memory layout of the
+      vvVolDesc the provider is attached to (host byte order).
+      @param frame  index of the frame (0 for first frame)
+      @return frame data, or an empty pointer if the frame cannot be loaded
+    */
+    virtual boost::shared_ptr<uint8_t> loadFrame(size_t frame) = 0;
+};
+#endif
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
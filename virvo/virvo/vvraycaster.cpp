@@ -18,10 +18,24 @@
 // License along with this library (see license.txt); if not, write to the
 // Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <type_traits>
 
 #include <GL/glew.h>
@@ -32,6 +46,7 @@
 
 #undef MATH_NAMESPACE
 
+#include <visionaray/detail/parallel_for.h> // detail!
 #include <visionaray/detail/pixel_access.h> // detail (TODO?)!
 #include <visionaray/math/math.h>
 #include <visionaray/texture/texture.h>
@@ -53,8 +68,11 @@
 
 #undef MATH_NAMESPACE
 
+#include "gl/handle.h"
 #include "gl/util.h"
 #include "private/vvgltools.h"
+#include "private/vvlog.h"
+#include "private/work_queue.h"
 #include "vvcudarendertarget.h"
 #include "vvraycaster.h"
 #include "vvspaceskip.h"
@@ -82,27 +100,35 @@ using transfunc_type    = cuda_texture<vec4,      1>;
 using volume8_type      = cuda_texture<unorm< 8>, 3>;
 using volume16_type     = cuda_texture<unorm<16>, 3>;
 using volume32_type     = cuda_texture<float,     3>;
+using volume_rgba8_type = cuda_texture<vector<4, unorm<8>>, 3>;
+using gradient_type     = cuda_texture<vector<4, unorm<8>>, 3>;
+using macrocell_type    = cuda_texture<float,     3>;
+using preint_type       = cuda_texture<vec4,      2>;
+using bounds_type       = cuda_texture<vec4,      3>;
 #else
 #if defined(VV_ARCH_SSE2) || defined(VV_ARCH_SSE4_1)
 using ray_type = basic_ray<simd::float4>;
 #elif defined(VV_ARCH_AVX) || defined(VV_ARCH_AVX2)
 using ray_type = basic_ray<simd::float8>;
+#elif defined(VV_ARCH_AVX512)
+using ray_type = basic_ray<simd::float16>;
 #else
 using ray_type = basic_ray<float>;
 #endif
-using sched_type        = tiled_sched<ray_type>;
+template <typename R>
+class cost_sched;
+using sched_type        = cost_sched<ray_type>;
 using transfunc_type    = texture<vec4,      1>;
 using volume8_type      = texture<unorm< 8>, 3>;
 using volume16_type     = texture<unorm<16>, 3>;
 using volume32_type     = texture<float,     3>;
+using volume_rgba8_type = texture<vector<4, unorm<8>>, 3>;
+using gradient_type     = texture<vector<4, unorm<8>>, 3>;
+using macrocell_type    = texture<float,     3>;
+using preint_type       = texture<vec4,      2>;
+using bounds_type       = texture<vec4,      3>;
 #endif
 
-//-------------------------------------------------------------------------------------------------
-// Ray type, depends upon target architecture
-//
-
-
-
 //-------------------------------------------------------------------------------------------------
 // Misc. helpers
 //
@@ -177,6 +203,115 @@ inline void get_depth(I1 x, I1 y, I2& depth_raw, Params const& params)
     }
 }
 
+//-------------------------------------------------------------------------------------------------
+// Voxel fetches, either from one texture per channel or from a single texture that stores up to
+// four channels interleaved. For the latter, all channels are fetched at once with a single
+// address computation, channel_value() then only picks the channel from the prefetched texel
+//
+
+struct no_prefetch {};
+
+template <typename VolRef, typename S>
+VSNRAY_FUNC
+inline no_prefetch prefetch_voxels(VolRef const* /* volumes */, vector<3, S> const& /* tex_coord */)
+{
+    return no_prefetch();
+}
+
+template <typename S>
+VSNRAY_FUNC
+inline vector<4, S> prefetch_voxels(typename volume_rgba8_type::ref_type const* volumes, vector<3, S> const& tex_coord)
+{
+    return tex3D(volumes[0], tex_coord);
+}
+
+template <typename VolRef, typename S>
+VSNRAY_FUNC
+inline S channel_value(VolRef const* volumes, int c, vector<3, S> const& tex_coord, no_prefetch /* */)
+{
+    return tex3D(volumes[c], tex_coord);
+}
+
+template <typename VolRef, typename S>
+VSNRAY_FUNC
+inline S channel_value(VolRef const* /* volumes */, int c, vector<3, S> const& /* tex_coord */, vector<4, S> const& voxels)
+{
+    return voxels[c];
+}
+
+template <typename VolRef, typename S>
+VSNRAY_FUNC
+inline vector<3, S> channel_gradient(VolRef const* volumes, int c, vector<3, S> const& tex_coord)
+{
+    return gradient(volumes[c], tex_coord);
+}
+
+template <typename S>
+VSNRAY_FUNC
+inline vector<3, S> channel_gradient(typename volume_rgba8_type::ref_type const* volumes, int c, vector<3, S> const& tex_coord)
+{
+    // Central differences with the same orientation and offset as gradient()
+    float DELTA = 0.01f;
+
+    auto at = [&](float dx, float dy, float dz)
+    {
+        vector<4, S> texel = tex3D(volumes[0], tex_coord + vector<3, S>(dx, dy, dz));
+        return texel[c];
+    };
+
+    return vector<3, S>(
+            at(-DELTA, 0.0f, 0.0f) - at(DELTA, 0.0f, 0.0f),
+            at(0.0f, DELTA, 0.0f) - at(0.0f, -DELTA, 0.0f),
+            at(0.0f, 0.0f, DELTA) - at(0.0f, 0.0f, -DELTA)
+            );
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Position of (x,y) in the interleaved order of an n x n block (n power of two). The order is
+// that of a Bayer matrix, so that consecutive positions are spread evenly over the block
+//
+
+VSNRAY_FUNC
+inline int bayer_index(int x, int y, int n)
+{
+    int result = 0;
+
+    // The lowest bits of (x,y) are the most significant ones
+    for (int bit = 1; bit < n; bit <<= 1)
+    {
+        int bx = (x & bit) != 0;
+        int by = (y & bit) != 0;
+        result = result * 4 + 2 * (bx ^ by) + by;
+    }
+
+    return result;
+}
+
+// Inverse of bayer_index()
+
+VSNRAY_FUNC
+inline void bayer_position(int index, int n, int& x, int& y)
+{
+    int levels = 0;
+    for (int bit = 1; bit < n; bit <<= 1)
+    {
+        ++levels;
+    }
+
+    x = 0;
+    y = 0;
+
+    for (int l = 0; l < levels; ++l)
+    {
+        int digit = (index >> (2 * (levels - 1 - l))) & 3;
+        int by = digit & 1;
+        int bx = (digit >> 1) ^ by;
+        x |= bx << l;
+        y |= by << l;
+    }
+}
+
 VSNRAY_FUNC
 inline vec3 gatherv(vec3 const* base_addr, int index)
 {
@@ -209,6 +344,230 @@ inline vector<3, T> gatherv(vector<3, T> const* base_addr, I const& index)
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Bricked 3D texture for the CPU ray casters. Voxels are stored in bricks of 8^3 voxels with the
+// bricks and the voxels inside a brick in x-fastest order. The eight texels of a trilinear lookup
+// mostly lie in the same brick, and rays traveling along y or z touch far less cache lines and
+// pages than with a linear layout, so that sampling costs do not depend on the view direction.
+// Only supports clamp to edge addressing
+//
+
+template <typename T>
+class bricked_texture_ref;
+
+template <typename T>
+class bricked_texture
+{
+public:
+
+    using value_type = T;
+    using ref_type = bricked_texture_ref<T>;
+
+    enum { BrickBits = 3, BrickSize = 1 << BrickBits, BrickMask = BrickSize - 1 };
+
+public:
+
+    bricked_texture() = default;
+
+    bricked_texture(int w, int h, int d)
+        : size_(w, h, d)
+        , num_bricks_((w + BrickMask) >> BrickBits, (h + BrickMask) >> BrickBits, (d + BrickMask) >> BrickBits)
+        , data_(static_cast<size_t>(num_bricks_.x) * num_bricks_.y * num_bricks_.z << (3 * BrickBits))
+    {
+    }
+
+    // Copy from linear, x-fastest data
+    void reset(T const* data)
+    {
+        for (int z = 0; z < size_.z; ++z)
+        {
+            for (int y = 0; y < size_.y; ++y)
+            {
+                T const* row = data + (static_cast<size_t>(z) * size_.y + y) * size_.x;
+
+                for (int x = 0; x < size_.x; ++x)
+                {
+                    data_[index(x, y, z, num_bricks_)] = row[x];
+                }
+            }
+        }
+    }
+
+    static size_t index(int x, int y, int z, vec3i const& num_bricks)
+    {
+        size_t brick = (static_cast<size_t>(z >> BrickBits) * num_bricks.y + (y >> BrickBits)) * num_bricks.x + (x >> BrickBits);
+        size_t offset = ((((z & BrickMask) << BrickBits) + (y & BrickMask)) << BrickBits) + (x & BrickMask);
+        return (brick << (3 * BrickBits)) + offset;
+    }
+
+    void set_filter_mode(tex_filter_mode mode) { filter_mode_ = mode; }
+    void set_address_mode(tex_address_mode /* mode */) {}
+
+    tex_filter_mode get_filter_mode() const { return filter_mode_; }
+
+    int width() const { return size_.x; }
+    int height() const { return size_.y; }
+    int depth() const { return size_.z; }
+
+    T const* data() const { return data_.data(); }
+
+    vec3i num_bricks() const { return num_bricks_; }
+
+private:
+
+    vec3i size_ = vec3i(0);
+    vec3i num_bricks_ = vec3i(0);
+    aligned_vector<T> data_;
+    tex_filter_mode filter_mode_ = Linear;
+};
+
+template <typename T>
+class bricked_texture_ref
+{
+public:
+
+    using texture_type = bricked_texture<T>;
+
+    bricked_texture_ref() = default;
+
+    bricked_texture_ref(texture_type const& tex)
+        : data_(tex.data())
+        , size_(tex.width(), tex.height(), tex.depth())
+        , num_bricks_(tex.num_bricks())
+        , filter_mode_(tex.get_filter_mode())
+    {
+    }
+
+    // Sample with texture coordinates in [0..1], texel centers at (i + 0.5) / size
+    float sample(float s, float t, float r) const
+    {
+        // Clamp before converting to int, inactive SIMD lanes may hold inf or NaN.
+        // Coordinates are >= -1 then, so floor(x) is int(x + 1) - 1
+        float x = clamp_coord(s * size_.x - 0.5f, size_.x);
+        float y = clamp_coord(t * size_.y - 0.5f, size_.y);
+        float z = clamp_coord(r * size_.z - 0.5f, size_.z);
+
+        int x0 = static_cast<int>(x + 1.0f) - 1;
+        int y0 = static_cast<int>(y + 1.0f) - 1;
+        int z0 = static_cast<int>(z + 1.0f) - 1;
+
+        if (filter_mode_ == Nearest)
+        {
+            return fetch(
+                    x - x0 >= 0.5f ? x0 + 1 : x0,
+                    y - y0 >= 0.5f ? y0 + 1 : y0,
+                    z - z0 >= 0.5f ? z0 + 1 : z0
+                    );
+        }
+
+        float fx = x - x0;
+        float fy = y - y0;
+        float fz = z - z0;
+
+        // Compute the index of one texel only, the other seven are found at per axis offsets:
+        // 1, BrickSize and BrickSize^2 inside a brick, the distance to the first texel of the
+        // next brick when crossing a brick boundary, and 0 when clamping at the volume border
+        enum
+        {
+            Bits = texture_type::BrickBits,
+            BrickVoxels = 1 << (3 * Bits)
+        };
+
+        size_t dx = neighbor_offset(x0, size_.x, 1, BrickVoxels);
+        size_t dy = neighbor_offset(y0, size_.y, 1 << Bits, static_cast<size_t>(num_bricks_.x) * BrickVoxels);
+        size_t dz = neighbor_offset(z0, size_.z, 1 << (2 * Bits), static_cast<size_t>(num_bricks_.x) * num_bricks_.y * BrickVoxels);
+
+        T const* p = data_ + texture_type::index(
+                clamp(x0, 0, size_.x - 1),
+                clamp(y0, 0, size_.y - 1),
+                clamp(z0, 0, size_.z - 1),
+                num_bricks_
+                );
+
+        auto lerp_x = [&](size_t offset)
+        {
+            return lerp(static_cast<float>(p[offset]), static_cast<float>(p[offset + dx]), fx);
+        };
+
+        return lerp(
+                lerp(lerp_x(0 ), lerp_x(     dy), fy),
+                lerp(lerp_x(dz), lerp_x(dz + dy), fy),
+                fz
+                );
+    }
+
+private:
+
+    // Keeps texel space coordinates in [-1..size], also maps NaN to -1
+    static float clamp_coord(float v, int size)
+    {
+        return std::min(static_cast<float>(size), std::max(-1.0f, v));
+    }
+
+    // Offset from texel i to texel i + 1 along an axis with 'step' between neighbors
+    // in a brick and 'brick_step' between neighboring bricks
+    static size_t neighbor_offset(int i, int size, size_t step, size_t brick_step)
+    {
+        if (i < 0 || i + 1 >= size)
+        {
+            return 0;
+        }
+
+        return (i & texture_type::BrickMask) != texture_type::BrickMask
+            ? step
+            : brick_step - texture_type::BrickMask * step;
+    }
+
+    float fetch(int x, int y, int z) const
+    {
+        x = clamp(x, 0, size_.x - 1);
+        y = clamp(y, 0, size_.y - 1);
+        z = clamp(z, 0, size_.z - 1);
+
+        return static_cast<float>(data_[texture_type::index(x, y, z, num_bricks_)]);
+    }
+
+    T const* data_ = nullptr;
+    vec3i size_ = vec3i(0);
+    vec3i num_bricks_ = vec3i(0);
+    tex_filter_mode filter_mode_ = Linear;
+};
+
+template <typename T>
+inline float tex3D(bricked_texture_ref<T> const& tex, vector<3, float> const& coord)
+{
+    return tex.sample(coord.x, coord.y, coord.z);
+}
+
+template <
+    typename T,
+    typename S,
+    typename = typename std::enable_if<simd::is_simd_vector<S>::value>::type
+    >
+inline S tex3D(bricked_texture_ref<T> const& tex, vector<3, S> const& coord)
+{
+    // Lanes are sampled one after another, the gain
+    // is in the memory accesses and not in the ALU
+    typename simd::aligned_array<S>::type s;
+    typename simd::aligned_array<S>::type t;
+    typename simd::aligned_array<S>::type r;
+    typename simd::aligned_array<S>::type result;
+
+    store(s, coord.x);
+    store(t, coord.y);
+    store(r, coord.z);
+
+    for (int i = 0; i < simd::num_elements<S>::value; ++i)
+    {
+        result[i] = tex.sample(s[i], t[i], r[i]);
+    }
+
+    return S(result);
+}
+
+using bricked8_type     = bricked_texture<unorm<8>>;
+
+
 //-------------------------------------------------------------------------------------------------
 // Clip sphere, hit_record stores both tnear and tfar (in contrast to basic_sphere)!
 //
@@ -486,8 +845,9 @@ private:
 
 
 //-------------------------------------------------------------------------------------------------
-// Wrapper that either uses CUDA/GL interop or simple CPU <- GPU transfer to make the
-// OpenGL depth buffer available to the Visionaray kernel
+// Wrapper that either uses CUDA/GL interop or an asynchronous CPU <- GPU transfer to make the
+// OpenGL depth buffer available to the Visionaray kernel. map() only starts the transfer,
+// data() waits for it, so that the transfer overlaps with the preparations for the frame
 //
 
 #ifdef VV_ARCH_CUDA
@@ -504,11 +864,26 @@ struct depth_buffer_type : cuda::pixel_pack_buffer
 
 struct depth_buffer_type
 {
+    // A single buffer suffices: the buffer of the last frame was unmapped when that frame
+    // finished. The transfer overlaps with the CPU work between map() and data() only
     void map(recti viewport, pixel_format format)
     {
         auto info = map_pixel_format(format);
 
-        buffer.resize((viewport.w - viewport.x) * (viewport.h - viewport.y));
+        if (pbo.get() == 0)
+        {
+            pbo.reset(virvo::gl::createBuffer());
+        }
+
+        size_t bytes = static_cast<size_t>(viewport.w) * viewport.h * sizeof(unsigned);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo.get());
+
+        if (size != bytes)
+        {
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+            size = bytes;
+        }
 
         glReadPixels(
                 viewport.x,
@@ -517,20 +892,43 @@ struct depth_buffer_type
                 viewport.h,
                 info.format,
                 info.type,
-                buffer.data()
+                nullptr
                 );
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        mapped = nullptr;
     }
 
     void unmap()
     {
+        if (mapped != nullptr)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo.get());
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+            mapped = nullptr;
+        }
     }
 
-    unsigned const* data() const
+    // Blocks until the transfer started by map() has finished,
+    // nullptr if the buffer could not be mapped
+    unsigned const* data()
     {
-        return buffer.data();
+        if (mapped == nullptr)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo.get());
+            mapped = static_cast<unsigned const*>(glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        return mapped;
     }
 
-    aligned_vector<unsigned> buffer;
+    virvo::gl::Buffer pbo;
+    size_t size = 0;
+    unsigned const* mapped = nullptr;
 };
 
 #endif
@@ -584,441 +982,2477 @@ public:
 
 
 //-------------------------------------------------------------------------------------------------
-// Volume kernel params
+// Cost-aware tile scheduler with work stealing (CPU only)
+//
+// The cost of a tile varies by orders of magnitude between empty background and dense data. Each
+// tile's render time is measured and summed over all passes of a frame (begin_frame() starts a
+// frame), and in the next frame the tiles are handed out most expensive first, with expensive
+// tiles split into quadrants. The sorted tiles are dealt to per thread deques round robin,
+// threads pop from the front of their own deque and steal from the back of the others' when they
+// run dry. The first frame and frames after a resize use uniform tiles
 //
 
-struct volume_kernel_params
-{
-    enum projection_mode
-    {
-        AlphaCompositing,
-        MaxIntensity,
-        MinIntensity,
-        DRR
-    };
-
-    using clip_object    = variant<clip_plane, clip_sphere, clip_cone>;
-    using transfunc_ref  = typename transfunc_type::ref_type;
-
-    clip_box                    bbox;
-    clip_box                    roi;
-    float                       delta;
-    int                         num_channels;
-    transfunc_ref const*        transfuncs;
-    vec2 const*                 ranges;
-    unsigned const*             depth_buffer;
-    pixel_format                depth_format;
-    projection_mode             mode;
-    bool                        depth_test;
-    bool                        opacity_correction;
-    bool                        early_ray_termination;
-    bool                        local_shading;
-    mat4                        camera_matrix_inv;
-    recti                       viewport;
-    point_light<float>          light;
+#if !defined(VV_ARCH_CUDA)
 
-    struct
-    {
-        clip_object const*      begin;
-        clip_object const*      end;
-    } clip_objects;
+struct cost_sched_params
+{
+    mat4                            view_matrix;
+    mat4                            proj_matrix;
+    void*                           color;          // blended with (One, OneMinusSrcAlpha)
+    pixel_format                    color_format;   // PF_RGBA8 or PF_RGBA32F
+    int                             width;
+    int                             height;
 };
 
+template <typename R>
+class cost_sched
+{
+public:
 
-//-------------------------------------------------------------------------------------------------
-// Visionaray volume rendering kernel
-//
+    using scalar_type = typename R::scalar_type;
 
-template <typename Volume>
-struct volume_kernel
-{
-    using Params = volume_kernel_params;
-    using VolRef = typename Volume::ref_type;
+    enum { TileSize = 16 };
 
-    VSNRAY_FUNC
-    explicit volume_kernel(Params const& p, VolRef const* vols)
-        : params(p)
-        , volumes(vols)
+    explicit cost_sched(unsigned num_threads)
     {
+        reset(num_threads);
     }
 
-    template <typename R>
-    VSNRAY_FUNC
-    result_record<typename R::scalar_type> operator()(R ray, int x, int y) const
+   ~cost_sched()
     {
-#ifdef DEBUGGING
-        auto debug = [this,x,y]() {
-            return x*2==params.viewport.w && y*2==params.viewport.h;
-        };
+        stop();
+    }
 
-        auto crosshair = [this,x,y]() {
-            return x*2==params.viewport.w || y*2==params.viewport.h;
-        };
-#else
-        auto debug = []() { return false; };
-        auto crosshair = []() { return false; };
-#endif
-        using S    = typename R::scalar_type;
-        using I    = typename simd::int_type<S>::type;
-        using Mask = typename simd::mask_type<S>::type;
-        using Mat4 = matrix<4, 4, S>;
-        using C    = vector<4, S>;
+    cost_sched(cost_sched const&) = delete;
+    cost_sched& operator=(cost_sched const&) = delete;
 
-        result_record<S> result;
-        result.color = C(0.0);
+    void reset(unsigned num_threads)
+    {
+        stop();
 
-        auto hit_rec = intersect(ray, params.roi);
-        auto tmax = hit_rec.tfar;
+        num_threads = std::max(num_threads, 1U);
 
-        // convert depth buffer(x,y) to "t" coordinates
-        if (params.depth_test)
+        deques_ = std::vector<tile_deque>(num_threads);
+        stop_ = false;
+
+        // Workers start out waiting for the next frame
+        unsigned generation = generation_;
+
+        for (unsigned i = 0; i < num_threads; ++i)
         {
-            // unproject (win to obj)
-            I depth_raw(0);
-            get_depth(x, y, depth_raw, params);
-            S depth = normalize_depth(depth_raw, params.depth_format, S{});
+            threads_.emplace_back([this, i, generation]() { run(i, generation); });
+        }
+    }
 
-            vector<3, S> win(expand_pixel<S>().x(x), expand_pixel<S>().y(y), depth);
-            vector<4, S> u(
-                    S(2.0 * (win[0] - params.viewport[0]) / params.viewport[2] - 1.0),
-                    S(2.0 * (win[1] - params.viewport[1]) / params.viewport[3] - 1.0),
-                    S(2.0 * win[2] - 1.0),
-                    S(1.0)
-                    );
+    // The costs measured in the passes since the last call
+    // are the estimates for all passes until the next call
+    void begin_frame()
+    {
+        costs_.swap(frame_costs_);
+        std::fill(frame_costs_.begin(), frame_costs_.end(), 0.0);
+    }
 
-            vector<4, S> v = Mat4(params.camera_matrix_inv) * u;
-            vector<3, S> obj = v.xyz() / v.w;
+    template <typename K>
+    void frame(K kernel, cost_sched_params const& sparams)
+    {
+        if (sparams.color_format == PF_RGBA8)
+        {
+            frame_impl(kernel, sparams, pixel_format_constant<PF_RGBA8>{});
+        }
+        else
+        {
+            frame_impl(kernel, sparams, pixel_format_constant<PF_RGBA32F>{});
+        }
+    }
 
-            // convert to "t" coordinates
-            tmax = length(obj - ray.ori);
+private:
+
+    // Samples are blended in floating point, converted only when they are
+    // stored, so 8-bit targets only cost the 8-bit framebuffer traffic
+    template <typename K, pixel_format CF>
+    void frame_impl(K kernel, cost_sched_params const& sparams, pixel_format_constant<CF> color_format)
+    {
+        using S = scalar_type;
+        using color_type = typename pixel_traits<CF>::type;
+
+        color_type* color = static_cast<color_type*>(sparams.color);
+
+        int pw = packet_size<S>::w;
+        int ph = packet_size<S>::h;
+
+        int num_tiles_x = div_up(sparams.width, static_cast<int>(TileSize));
+        int num_tiles_y = div_up(sparams.height, static_cast<int>(TileSize));
+        size_t num_tiles = static_cast<size_t>(num_tiles_x) * num_tiles_y;
+
+        if (costs_.size() != num_tiles)
+        {
+            costs_.assign(num_tiles, 0.0);
         }
 
+        if (frame_costs_.size() != num_tiles)
+        {
+            frame_costs_.assign(num_tiles, 0.0);
+        }
 
-        auto t = max(S(0.0f), hit_rec.tnear);
-        tmax = min(hit_rec.tfar, tmax);
+        double average = 0.0;
+        for (double c : costs_)
+        {
+            average += c;
+        }
+        average /= std::max(num_tiles, size_t(1));
 
+        // Split tiles that took considerably longer than the average
+        enum { SplitFactor = 4 };
+        bool can_split = TileSize / 2 >= pw && TileSize / 2 >= ph;
 
-        // calculate intervals clipped by planes, spheres, etc., along with the
-        // normals of the farthest intersection in view direction
-        const int MaxClipIntervals = 64;
-        vector<2, S> clip_intervals[MaxClipIntervals];
-        vector<3, S> clip_normals[MaxClipIntervals];
+        std::vector<tile> tiles;
+        tiles.reserve(num_tiles);
 
-        auto num_clip_objects = min(
-                MaxClipIntervals - 1, // room for bbox normal, which is the last clip object
-                static_cast<int>(params.clip_objects.end - params.clip_objects.begin)
-                );
+        for (int ty = 0; ty < num_tiles_y; ++ty)
+        {
+            for (int tx = 0; tx < num_tiles_x; ++tx)
+            {
+                int id = ty * num_tiles_x + tx;
 
-        for (auto it = params.clip_objects.begin; it != params.clip_objects.end; ++it)
+                int x0 = tx * TileSize;
+                int y0 = ty * TileSize;
+                int x1 = std::min(x0 + static_cast<int>(TileSize), sparams.width);
+                int y1 = std::min(y0 + static_cast<int>(TileSize), sparams.height);
+
+                double cost = costs_[id];
+
+                if (can_split && average > 0.0 && cost > SplitFactor * average)
+                {
+                    int xm = std::min(x0 + TileSize / 2, x1);
+                    int ym = std::min(y0 + TileSize / 2, y1);
+
+                    tiles.push_back({ x0, y0, xm, ym, id, cost / 4 });
+                    tiles.push_back({ xm, y0, x1, ym, id, cost / 4 });
+                    tiles.push_back({ x0, ym, xm, y1, id, cost / 4 });
+                    tiles.push_back({ xm, ym, x1, y1, id, cost / 4 });
+                }
+                else
+                {
+                    tiles.push_back({ x0, y0, x1, y1, id, cost });
+                }
+            }
+        }
+
+        std::stable_sort(tiles.begin(), tiles.end(), [](tile const& a, tile const& b)
         {
-            clip_object_visitor<S> visitor(ray, t, tmax);
-            auto clip_data = apply_visitor(visitor, *it);
+            return a.cost > b.cost;
+        });
 
-            clip_intervals[it - params.clip_objects.begin] = clip_data.intervals[0];
-            clip_normals[it - params.clip_objects.begin] = clip_data.normal;
+        std::vector<double> tile_times(tiles.size(), 0.0);
+
+        for (size_t i = 0; i < tiles.size(); ++i)
+        {
+            deques_[i % deques_.size()].items.push_back(i);
         }
 
-        // treat the bbox entry plane as a clip
-        // object that contributes a shading normal
-        clip_normals[num_clip_objects] = hit_rec.normal;
+        matrix<4, 4, S> inv(inverse(sparams.proj_matrix * sparams.view_matrix));
+
+        auto render_tile = [&](tile const& t)
+        {
+            for (int y = t.y0; y < t.y1; y += ph)
+            {
+                for (int x = t.x0; x < t.x1; x += pw)
+                {
+                    // Like Visionaray's primary rays: from the near to the far plane
+                    S u = S(2.0) * (expand_pixel<S>().x(x) + S(0.5)) / S(static_cast<float>(sparams.width))  - S(1.0);
+                    S v = S(2.0) * (expand_pixel<S>().y(y) + S(0.5)) / S(static_cast<float>(sparams.height)) - S(1.0);
+
+                    vector<4, S> o = inv * vector<4, S>(u, v, S(-1.0), S(1.0));
+                    vector<4, S> d = inv * vector<4, S>(u, v, S( 1.0), S(1.0));
+
+                    R ray;
+                    ray.ori = o.xyz() / o.w;
+                    ray.dir = normalize(d.xyz() / d.w - ray.ori);
+
+                    auto result = kernel(ray, x, y);
+
+                    vector<4, S> dst;
+
+                    detail::pixel_access::get( // detail (TODO?)!
+                            pixel_format_constant<PF_RGBA32F>{},    // dst format
+                            color_format,                           // src format
+                            x,
+                            y,
+                            sparams.width,
+                            sparams.height,
+                            dst,
+                            color
+                            );
+
+                    dst = result.color + dst * (S(1.0) - result.color.w);
+
+                    detail::pixel_access::store( // detail (TODO?)!
+                            color_format,                           // dst format
+                            pixel_format_constant<PF_RGBA32F>{},    // src format
+                            x,
+                            y,
+                            sparams.width,
+                            sparams.height,
+                            dst,
+                            color
+                            );
+                }
+            }
+        };
 
+        job_ = [&](size_t index)
+        {
+            auto start = std::chrono::steady_clock::now();
+            render_tile(tiles[index]);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            tile_times[index] = elapsed.count();
+        };
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            busy_ = static_cast<unsigned>(threads_.size());
+            ++generation_;
+            start_.notify_all();
+            done_.wait(lock, [this]() { return busy_ == 0; });
+        }
+
+        job_ = nullptr;
+
+        // Costs of split tiles are summed up again, and so are the costs of all passes
+        for (size_t i = 0; i < tiles.size(); ++i)
+        {
+            frame_costs_[tiles[i].id] += tile_times[i];
+        }
+    }
+
+    struct tile
+    {
+        int                         x0;
+        int                         y0;
+        int                         x1;
+        int                         y1;
+        int                         id;             // index of the undivided tile
+        double                      cost;           // estimate from the previous frame [sec.]
+    };
+
+    struct tile_deque
+    {
+        std::mutex                  mutex;
+        std::deque<size_t>          items;
+    };
 
-        // calculate the volume rendering integral
-        while (visionaray::any(t < tmax))
+    bool pop(unsigned id, size_t& index)
+    {
         {
-            Mask clipped(false);
+            tile_deque& own = deques_[id];
+            std::lock_guard<std::mutex> lock(own.mutex);
 
-            S tnext = t + params.delta;
-            for (int i = 0; i < num_clip_objects; ++i)
+            if (!own.items.empty())
             {
-                clipped |= t >= clip_intervals[i].x && t <= clip_intervals[i].y;
-                tnext = select(
-                        t >= clip_intervals[i].x && t <= clip_intervals[i].y && tnext < clip_intervals[i].y,
-                        clip_intervals[i].y,
-                        tnext
-                        );
+                index = own.items.front();
+                own.items.pop_front();
+                return true;
             }
+        }
 
-            if (!visionaray::all(clipped))
+        for (size_t i = 1; i < deques_.size(); ++i)
+        {
+            tile_deque& victim = deques_[(id + i) % deques_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+
+            if (!victim.items.empty())
             {
-                auto pos = ray.ori + ray.dir * t;
-                auto tex_coord = vector<3, S>(
-                        ( pos.x + (params.bbox.size().x / 2) ) / params.bbox.size().x,
-                        (-pos.y + (params.bbox.size().y / 2) ) / params.bbox.size().y,
-                        (-pos.z + (params.bbox.size().z / 2) ) / params.bbox.size().z
-                        );
+                index = victim.items.back();
+                victim.items.pop_back();
+                return true;
+            }
+        }
+
+        return false;
+    }
 
-                C color(0.0);
+    void run(unsigned id, unsigned generation)
+    {
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_.wait(lock, [&]() { return stop_ || generation_ != generation; });
 
-                for (int c = 0; c < params.num_channels; ++c)
+                if (stop_)
                 {
-                    S voxel  = tex3D(volumes[c], tex_coord);
-                    C colori = tex1D(params.transfuncs[c], voxel);
+                    return;
+                }
 
-                    auto do_shade = params.local_shading && colori.w >= 0.1f;
+                generation = generation_;
+            }
 
-                    if (visionaray::any(do_shade))
-                    {
-                        // TODO: make this modifiable
-                        plastic<S> mat;
-                        mat.ca() = from_rgb(vector<3, S>(0.3f, 0.3f, 0.3f));
-                        mat.cd() = from_rgb(vector<3, S>(0.8f, 0.8f, 0.8f));
-                        mat.cs() = from_rgb(vector<3, S>(0.8f, 0.8f, 0.8f));
-                        mat.ka() = 1.0f;
-                        mat.kd() = 1.0f;
-                        mat.ks() = 1.0f;
-                        mat.specular_exp() = 1000.0f;
-
-
-                        // calculate shading
-                        auto grad = gradient(volumes[c], tex_coord);
-                        auto normal = normalize(grad);
-
-                        auto float_eq = [&](S const& a, S const& b) { return abs(a - b) < params.delta * S(0.5); };
-
-                        Mask at_boundary = float_eq(t, hit_rec.tnear);
-                        I clip_normal_index = select(
-                                at_boundary,
-                                I(num_clip_objects), // bbox normal is stored at last position in the list
-                                I(0)
-                                );
+            size_t index = 0;
+            while (pop(id, index))
+            {
+                job_(index);
+            }
 
-                        for (int i = 0; i < num_clip_objects; ++i)
-                        {
-                            Mask hit = float_eq(t, clip_intervals[i].y + params.delta); // TODO: understand why +delta
-                            clip_normal_index = select(hit, I(i), clip_normal_index);
-                            at_boundary |= hit;
-                        }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--busy_ == 0)
+            {
+                done_.notify_all();
+            }
+        }
+    }
 
-                        if (visionaray::any(at_boundary))
-                        {
-                            auto boundary_normal = gatherv(clip_normals, clip_normal_index);
-                            normal = select(
-                                    at_boundary,
-                                    boundary_normal * colori.w + normal * (S(1.0) - colori.w),
-                                    normal
-                                    );
-                        }
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+            start_.notify_all();
+        }
 
-                        do_shade &= length(grad) != 0.0f;
+        for (auto& t : threads_)
+        {
+            t.join();
+        }
 
-                        shade_record<S> sr;
-                        sr.normal = normal;
-                        sr.geometric_normal = normal;
-                        sr.view_dir = -ray.dir;
-                        sr.tex_color = vector<3, S>(1.0);
-                        sr.light_dir = normalize(params.light.position());
-                        sr.light_intensity = params.light.intensity(pos);
+        threads_.clear();
+    }
 
-                        auto shaded_clr = mat.shade(sr);
+    std::vector<std::thread>        threads_;
+    std::vector<tile_deque>         deques_;
+    std::vector<double>             costs_;         // per tile, measured in the last frame [sec.]
+    std::vector<double>             frame_costs_;   // per tile, measured in the current frame [sec.]
+
+    std::function<void(size_t)>     job_;
+    std::mutex                      mutex_;
+    std::condition_variable         start_;
+    std::condition_variable         done_;
+    unsigned                        generation_ = 0;
+    unsigned                        busy_ = 0;
+    bool                            stop_ = false;
+};
 
-                        colori.xyz() = mul(
-                                colori.xyz(),
-                                to_rgb(shaded_clr),
-                                do_shade,
-                                colori.xyz()
-                                );
-                    }
+#endif // !VV_ARCH_CUDA
 
-                    if (params.opacity_correction)
-                    {
-                        colori.w = 1.0f - pow(1.0f - colori.w, params.delta);
-                    }
 
-                    // premultiplied alpha
-                    colori.xyz() *= colori.w;
+//-------------------------------------------------------------------------------------------------
+// Node of the flattened space skipping k-d tree, see virvo::SkipTree::getNodes()
+//
 
-                    color += colori;
-                }
+struct kd_node
+{
+    aabb    bbox;
+    int     axis;       // -1: leaf
+    float   splitpos;
+    int     children;   // child below the split plane, the child above follows
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Volume kernel params
+//
+
+struct volume_kernel_params
+{
+    enum projection_mode
+    {
+        AlphaCompositing,
+        MaxIntensity,
+        MinIntensity,
+        DRR
+    };
+
+    using clip_object    = variant<clip_plane, clip_sphere, clip_cone>;
+    using transfunc_ref  = typename transfunc_type::ref_type;
+    using gradient_ref   = typename gradient_type::ref_type;
+    using macrocell_ref  = typename macrocell_type::ref_type;
+    using preint_ref     = typename preint_type::ref_type;
+    using bounds_ref     = typename bounds_type::ref_type;
+
+    // Pre-integration keeps the previous sample of each channel
+    enum { MaxPreintChannels = 4 };
+
+    enum { MaxLodLevels = 8 };
+
+    clip_box                    bbox;
+    clip_box                    roi;
+    float                       delta;
+    int                         num_channels;
+    transfunc_ref const*        transfuncs;
+    preint_ref const*           preint_tables;  // per channel, (back, front) -> rgba, only with pre-integration
+    gradient_ref const*         gradients;      // precomputed gradients, nullptr: central differences
+    vec2 const*                 tf_scale_bias;  // per channel, maps texture values to transfer function coordinates
+    unsigned const*             depth_buffer;
+    pixel_format                depth_format;
+    projection_mode             mode;
+    bool                        depth_test;
+    bool                        early_ray_termination;
+    bool                        local_shading;
+    float                       shade_threshold;
+    mat4                        camera_matrix_inv;
+    recti                       viewport;
+    point_light<float>          light;
+
+    struct
+    {
+        clip_object const*      begin;
+        clip_object const*      end;
+    } clip_objects;
+
+    // Space skipping k-d tree, rays traverse it front to back and only sample
+    // inside its leaves if there are nodes. The child on the eye's side of a
+    // split plane is in front of the other one for all rays
+    struct
+    {
+        kd_node const*          nodes;
+        int                     num_nodes;
+        vec3                    eye;            // object space
+    } kdtree;
+
+    // Macrocell occupancy, rays step over cells without visible voxels. Empty cells
+    // of the coarse level are stepped over as a whole
+    struct
+    {
+        macrocell_ref           grid;
+        vec3                    num_cells;
+        vec3                    cell_size;      // in texture coordinates
+        macrocell_ref           coarse_grid;
+        vec3                    num_coarse_cells;
+        vec3                    coarse_cell_size;
+        bool                    enabled;
+    } macrocells;
+
+    // Max./min. intensity projection: per cell bounds of the classified color,
+    // rays skip cells that can't raise (lower) their current maximum (minimum)
+    struct
+    {
+        bounds_ref              grid;
+        vec3                    num_cells;
+        vec3                    cell_size;      // in texture coordinates
+        bool                    enabled;
+    } culling;
+
+    // Mip pyramid, the volume textures are stored level major (num_levels x num_channels).
+    // A pixel at distance t along the ray covers t * footprint.x + footprint.y voxels of
+    // the full resolution level, rays sample from the coarsest level that is still finer.
+    // A level with odd sized parents covers more than the volume (the last voxel is
+    // replicated), coord_scale maps texture coordinates onto the part that does
+    struct
+    {
+        int                     num_levels;     // 1: full resolution only
+        vec2                    footprint;
+        vec3                    coord_scale[MaxLodLevels];
+    } lod;
+
+    // Progressive refinement, per pass only one packet out of each block of
+    // stride x stride packets is integrated, the others are taken from the
+    // accumulation buffer. The first stride^2 passes fill the image with a
+    // coarse step size, the next stride^2 passes refine it. During the coarse
+    // passes a second, replicating pass copies the packet just integrated to
+    // the packets of its block that were not integrated yet. A pass only reads
+    // accumulation buffer pixels that it doesn't write
+    struct
+    {
+        vec4*                   accum;
+        int                     width;
+        int                     height;
+        int                     stride;         // 0: off
+        int                     pass;
+        bool                    replicate;
+    } progressive;
+
+    // Temporal reprojection, the colors and representative positions (object space, w == 0:
+    // no sample) of the previous frame are warped into the current view on the host. Packets
+    // with a warped sample for each pixel reuse them, except for one out of each block of
+    // stride x stride packets per frame. Colors and positions of all pixels are written for
+    // the next frame
+    struct
+    {
+        vec4 const*             warped_colors;
+        vec4 const*             warped_positions;
+        vec4*                   colors;
+        vec4*                   positions;
+        int                     width;
+        int                     height;
+        int                     stride;         // 0: off
+        int                     frame;
+    } reprojection;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Visionaray volume rendering kernel, specialized at compile time for the projection mode, for
+// local shading and for pre-integration so that the sampling loop does not branch on these per
+// sample. Opacity correction is already applied to the transfer function tables and to the
+// pre-integration tables (see applyOpacityCorrection() and applyPreIntegration())
+//
+
+template <typename Volume, volume_kernel_params::projection_mode Mode, bool LocalShading, bool PreIntegration>
+struct volume_kernel
+{
+    using Params = volume_kernel_params;
+    using VolRef = typename Volume::ref_type;
+
+    VSNRAY_FUNC
+    explicit volume_kernel(Params const& p, VolRef const* vols)
+        : params(p)
+        , volumes(vols)
+    {
+    }
+
+    template <typename R>
+    VSNRAY_FUNC
+    result_record<typename R::scalar_type> operator()(R ray, int x, int y) const
+    {
+#ifdef DEBUGGING
+        auto debug = [this,x,y]() {
+            return x*2==params.viewport.w && y*2==params.viewport.h;
+        };
+
+        auto crosshair = [this,x,y]() {
+            return x*2==params.viewport.w || y*2==params.viewport.h;
+        };
+#else
+        auto debug = []() { return false; };
+        auto crosshair = []() { return false; };
+#endif
+        using S    = typename R::scalar_type;
+        using I    = typename simd::int_type<S>::type;
+        using Mask = typename simd::mask_type<S>::type;
+        using Mat4 = matrix<4, 4, S>;
+        using C    = vector<4, S>;
+
+        result_record<S> result;
+        result.color = C(Mode == Params::MinIntensity ? 1.0f : 0.0f);
 
+        // Lanes that contributed a sample, min. intensity projection only
+        Mask sampled(false);
 
-                // compositing
-                if (params.mode == Params::AlphaCompositing)
+        auto hit_rec = intersect(ray, params.roi);
+        auto tmax = hit_rec.tfar;
+
+        if (params.progressive.stride > 0)
+        {
+            int stride = params.progressive.stride;
+            int num_subpasses = stride * stride;
+
+            int px = x / packet_size<S>::w;
+            int py = y / packet_size<S>::h;
+
+            int index = bayer_index(px % stride, py % stride, stride);
+            bool coarse = params.progressive.pass < num_subpasses;
+            bool converged = params.progressive.pass >= 2 * num_subpasses;
+
+            // Passes are blended into the render target, packets not integrated
+            // yet are only written by the replicating pass, the others only by
+            // the integrating pass
+            bool pending = coarse && index > params.progressive.pass;
+
+            if (params.progressive.replicate || pending)
+            {
+                result.color = C(0.0);
+                result.hit = hit_rec.hit;
+
+                if (params.progressive.replicate && pending)
                 {
-                    result.color += select(
-                            t < tmax && !clipped,
-                            color * (1.0f - result.color.w),
-                            C(0.0)
-                            );
+                    // Copy the packet of the block integrated in this pass, or the
+                    // first one if that packet lies outside of a clipped block
+                    int bx = 0;
+                    int by = 0;
+                    bayer_position(params.progressive.pass, stride, bx, by);
+
+                    int cx = (px - px % stride + bx) * packet_size<S>::w;
+                    int cy = (py - py % stride + by) * packet_size<S>::h;
 
-                    // early-ray termination - don't traverse w/o a contribution
-                    if (params.early_ray_termination && visionaray::all(result.color.w >= 0.999f))
+                    if (cx >= params.progressive.width || cy >= params.progressive.height)
                     {
-                        break;
+                        cx = (px - px % stride) * packet_size<S>::w;
+                        cy = (py - py % stride) * packet_size<S>::h;
                     }
-                }
-                else if (params.mode == Params::MaxIntensity)
-                {
-                    result.color = select(
-                            t < tmax && !clipped,
-                            max(color, result.color),
-                            result.color
+
+                    detail::pixel_access::get( // detail (TODO?)!
+                            pixel_format_constant<PF_RGBA32F>{},    // dst format
+                            pixel_format_constant<PF_RGBA32F>{},    // src format
+                            cx,
+                            cy,
+                            params.progressive.width,
+                            params.progressive.height,
+                            result.color,
+                            params.progressive.accum
                             );
-                }
-                else if (params.mode == Params::MinIntensity)
+
+                    detail::pixel_access::store( // detail (TODO?)!
+                            pixel_format_constant<PF_RGBA32F>{},    // dst format
+                            pixel_format_constant<PF_RGBA32F>{},    // src format
+                            x,
+                            y,
+                            params.progressive.width,
+                            params.progressive.height,
+                            result.color,
+                            params.progressive.accum
+                            );
+                }
+
+                return result;
+            }
+
+            if (converged || index != params.progressive.pass % num_subpasses)
+            {
+                detail::pixel_access::get( // detail (TODO?)!
+                        pixel_format_constant<PF_RGBA32F>{},    // dst format
+                        pixel_format_constant<PF_RGBA32F>{},    // src format
+                        x,
+                        y,
+                        params.progressive.width,
+                        params.progressive.height,
+                        result.color,
+                        params.progressive.accum
+                        );
+
+                result.hit = hit_rec.hit;
+                return result;
+            }
+        }
+
+        if (params.reprojection.stride > 0)
+        {
+            int stride = params.reprojection.stride;
+
+            int px = x / packet_size<S>::w;
+            int py = y / packet_size<S>::h;
+
+            bool refresh = bayer_index(px % stride, py % stride, stride) == params.reprojection.frame % (stride * stride);
+
+            C pos(0.0);
+
+            if (!refresh)
+            {
+                detail::pixel_access::get( // detail (TODO?)!
+                        pixel_format_constant<PF_RGBA32F>{},    // dst format
+                        pixel_format_constant<PF_RGBA32F>{},    // src format
+                        x,
+                        y,
+                        params.reprojection.width,
+                        params.reprojection.height,
+                        pos,
+                        params.reprojection.warped_positions
+                        );
+            }
+
+            if (!refresh && visionaray::all(pos.w > S(0.0)))
+            {
+                detail::pixel_access::get( // detail (TODO?)!
+                        pixel_format_constant<PF_RGBA32F>{},    // dst format
+                        pixel_format_constant<PF_RGBA32F>{},    // src format
+                        x,
+                        y,
+                        params.reprojection.width,
+                        params.reprojection.height,
+                        result.color,
+                        params.reprojection.warped_colors
+                        );
+
+                store_reprojection(x, y, result.color, pos);
+
+                result.hit = hit_rec.hit;
+                return result;
+            }
+        }
+
+        // convert depth buffer(x,y) to "t" coordinates
+        if (params.depth_test)
+        {
+            // unproject (win to obj)
+            I depth_raw(0);
+            get_depth(x, y, depth_raw, params);
+            S depth = normalize_depth(depth_raw, params.depth_format, S{});
+
+            vector<3, S> win(expand_pixel<S>().x(x), expand_pixel<S>().y(y), depth);
+            vector<4, S> u(
+                    S(2.0 * (win[0] - params.viewport[0]) / params.viewport[2] - 1.0),
+                    S(2.0 * (win[1] - params.viewport[1]) / params.viewport[3] - 1.0),
+                    S(2.0 * win[2] - 1.0),
+                    S(1.0)
+                    );
+
+            vector<4, S> v = Mat4(params.camera_matrix_inv) * u;
+            vector<3, S> obj = v.xyz() / v.w;
+
+            // convert to "t" coordinates
+            tmax = length(obj - ray.ori);
+        }
+
+
+        auto t = max(S(0.0f), hit_rec.tnear);
+        tmax = min(hit_rec.tfar, tmax);
+
+
+        // calculate intervals clipped by planes, spheres, etc., along with the
+        // normals of the farthest intersection in view direction
+        const int MaxClipIntervals = 64;
+        vector<2, S> clip_intervals[MaxClipIntervals];
+        vector<3, S> clip_normals[MaxClipIntervals];
+
+        auto num_clip_objects = min(
+                MaxClipIntervals - 1, // room for bbox normal, which is the last clip object
+                static_cast<int>(params.clip_objects.end - params.clip_objects.begin)
+                );
+
+        for (auto it = params.clip_objects.begin; it != params.clip_objects.end; ++it)
+        {
+            clip_object_visitor<S> visitor(ray, t, tmax);
+            auto clip_data = apply_visitor(visitor, *it);
+
+            clip_intervals[it - params.clip_objects.begin] = clip_data.intervals[0];
+            clip_normals[it - params.clip_objects.begin] = clip_data.normal;
+        }
+
+        // treat the bbox entry plane as a clip
+        // object that contributes a shading normal
+        clip_normals[num_clip_objects] = hit_rec.normal;
+
+
+        auto tex_coord_at = [&](vector<3, S> const& pos)
+        {
+            return vector<3, S>(
+                    ( pos.x + (params.bbox.size().x / 2) ) / params.bbox.size().x,
+                    (-pos.y + (params.bbox.size().y / 2) ) / params.bbox.size().y,
+                    (-pos.z + (params.bbox.size().z / 2) ) / params.bbox.size().z
+                    );
+        };
+
+        // index of the grid cell that contains tex_coord
+        auto cell_at = [&](vector<3, S> const& tex_coord, vec3 const& num_cells, vec3 const& cell_size)
+        {
+            return vector<3, S>(
+                    clamp(floor(tex_coord.x / cell_size.x), S(0.0), S(num_cells.x - 1)),
+                    clamp(floor(tex_coord.y / cell_size.y), S(0.0), S(num_cells.y - 1)),
+                    clamp(floor(tex_coord.z / cell_size.z), S(0.0), S(num_cells.z - 1))
+                    );
+        };
+
+        // distance along the ray to the exit point of the grid cell at t
+        auto macrocell_exit = [&](S t, vector<3, S> const& cell, vec3 const& grid_cell_size)
+        {
+            vector<3, S> size(params.bbox.size());
+            vector<3, S> cell_size(grid_cell_size);
+
+            vector<3, S> tc0 = cell * cell_size;
+            vector<3, S> tc1 = tc0 + cell_size;
+
+            // texture to object coordinates, y and z are flipped
+            vector<3, S> p0(tc0.x * size.x - size.x / S(2.0), size.y / S(2.0) - tc1.y * size.y, size.z / S(2.0) - tc1.z * size.z);
+            vector<3, S> p1(tc1.x * size.x - size.x / S(2.0), size.y / S(2.0) - tc0.y * size.y, size.z / S(2.0) - tc0.z * size.z);
+
+            vector<3, S> inv_dir = vector<3, S>(1.0) / ray.dir;
+            vector<3, S> t0 = (p0 - ray.ori) * inv_dir;
+            vector<3, S> t1 = (p1 - ray.ori) * inv_dir;
+
+            S texit = min(min(max(t0.x, t1.x), max(t0.y, t1.y)), max(t0.z, t1.z));
+            return max(t, texit);
+        };
+
+        // Representative distance for temporal reprojection, where the ray got half opaque
+        S trep(-1.0);
+
+        // calculate the volume rendering integral over [t..tmax)
+        auto integrate = [&](S t, S tmax)
+        {
+            S tstart = t;
+
+            // Pre-integration: classify the slab between the previous and the current sample.
+            // Lanes start a new segment (front == back) at the first sample and after they
+            // jumped over clipped or empty space
+            S prev[Params::MaxPreintChannels] = {};
+            Mask restart(true);
+
+            while (visionaray::any(t < tmax))
+            {
+                Mask clipped(false);
+
+                S tnext = t + params.delta;
+                for (int i = 0; i < num_clip_objects; ++i)
                 {
-                    result.color = select(
-                            t < tmax && !clipped,
-                            min(color, result.color),
-                            result.color
+                    clipped |= t >= clip_intervals[i].x && t <= clip_intervals[i].y;
+                    tnext = select(
+                            t >= clip_intervals[i].x && t <= clip_intervals[i].y && tnext < clip_intervals[i].y,
+                            clip_intervals[i].y,
+                            tnext
                             );
                 }
-                else if (params.mode == Params::DRR)
+
+                if (params.macrocells.enabled)
+                {
+                    // Walk the two level grid from cell exit to cell exit until the lanes
+                    // reach an occupied macrocell or tmax. Empty coarse cells are crossed in
+                    // one step. After the first step cells are looked up slightly behind the
+                    // exit point so that it selects the next cell. Lanes that moved advance
+                    // to the first sample behind the empty cells they crossed
+                    enum { MaxCellSteps = 64 };
+
+                    S tcell = t;
+                    Mask walking = t < tmax;
+
+                    for (int i = 0; i < MaxCellSteps && visionaray::any(walking); ++i)
+                    {
+                        S tlookup = select(tcell > t, tcell + params.delta * S(0.01), tcell);
+                        auto tex_coord = tex_coord_at(ray.ori + ray.dir * tlookup);
+
+                        auto coarse_cell = cell_at(
+                                tex_coord,
+                                params.macrocells.num_coarse_cells,
+                                params.macrocells.coarse_cell_size
+                                );
+
+                        S coarse_occupied = tex3D(
+                                params.macrocells.coarse_grid,
+                                (coarse_cell + vector<3, S>(0.5)) / vector<3, S>(params.macrocells.num_coarse_cells)
+                                );
+
+                        auto cell = cell_at(tex_coord, params.macrocells.num_cells, params.macrocells.cell_size);
+
+                        S occupied = tex3D(
+                                params.macrocells.grid,
+                                (cell + vector<3, S>(0.5)) / vector<3, S>(params.macrocells.num_cells)
+                                );
+
+                        Mask coarse_empty = coarse_occupied == S(0.0);
+                        walking &= coarse_empty || occupied == S(0.0);
+
+                        if (!visionaray::any(walking))
+                        {
+                            break;
+                        }
+
+                        S texit = select(
+                                coarse_empty,
+                                macrocell_exit(tcell, coarse_cell, params.macrocells.coarse_cell_size),
+                                macrocell_exit(tcell, cell, params.macrocells.cell_size)
+                                );
+
+                        walking &= texit > tcell;
+                        tcell = select(walking, texit, tcell);
+                        walking &= tcell < tmax;
+                    }
+
+                    Mask empty = tcell > t;
+
+                    if (visionaray::any(empty))
+                    {
+                        S tskip = tstart + ceil((tcell - tstart) / params.delta) * params.delta;
+
+                        clipped |= empty;
+                        tnext = select(empty, max(tnext, tskip), tnext);
+                    }
+                }
+
+                if ((Mode == Params::MaxIntensity || Mode == Params::MinIntensity) && params.culling.enabled)
                 {
-                    result.color += select(
-                            t < tmax && !clipped,
-                            color,
-                            C(0.0)
+                    // Skip cells whose color bounds can't change the running maximum (minimum)
+                    auto tex_coord = tex_coord_at(ray.ori + ray.dir * t);
+                    auto cell = cell_at(tex_coord, params.culling.num_cells, params.culling.cell_size);
+
+                    C bound = tex3D(
+                            params.culling.grid,
+                            (cell + vector<3, S>(0.5)) / vector<3, S>(params.culling.num_cells)
                             );
+
+                    Mask culled = Mode == Params::MaxIntensity
+                        ? bound.x <= result.color.x && bound.y <= result.color.y && bound.z <= result.color.z && bound.w <= result.color.w
+                        : bound.x >= result.color.x && bound.y >= result.color.y && bound.z >= result.color.z && bound.w >= result.color.w;
+
+                    culled &= t < tmax;
+
+                    if (visionaray::any(culled))
+                    {
+                        S texit = macrocell_exit(t, cell, params.culling.cell_size);
+                        S tskip = tstart + ceil((texit - tstart) / params.delta) * params.delta;
+
+                        clipped |= culled;
+                        tnext = select(culled, max(tnext, tskip), tnext);
+                    }
+                }
+
+                if (!visionaray::all(clipped))
+                {
+                    auto pos = ray.ori + ray.dir * t;
+                    auto tex_coord = tex_coord_at(pos);
+
+                    C color(0.0);
+
+                    VolRef const* level_volumes = volumes;
+                    auto level_coord = tex_coord;
+
+                    if (params.lod.num_levels > 1)
+                    {
+                        // One level for the whole packet, the finest any lane requires
+                        S footprint = t * params.lod.footprint.x + params.lod.footprint.y;
+
+                        for (int l = params.lod.num_levels - 1; l > 0; --l)
+                        {
+                            if (visionaray::all(footprint >= S(static_cast<float>(1 << l))))
+                            {
+                                level_volumes += l * params.num_channels;
+                                level_coord = tex_coord * vector<3, S>(params.lod.coord_scale[l]);
+                                break;
+                            }
+                        }
+                    }
+
+                    auto voxels = prefetch_voxels(level_volumes, level_coord);
+
+                    for (int c = 0; c < params.num_channels; ++c)
+                    {
+                        S voxel  = channel_value(level_volumes, c, level_coord, voxels);
+                        S coord  = voxel * params.tf_scale_bias[c].x + params.tf_scale_bias[c].y;
+                        C colori;
+
+                        if (PreIntegration)
+                        {
+                            S front = select(restart, coord, prev[c]);
+                            colori = tex2D(params.preint_tables[c], vector<2, S>(coord, front));
+                            prev[c] = coord;
+                        }
+                        else
+                        {
+                            colori = tex1D(params.transfuncs[c], coord);
+                        }
+
+                        auto do_shade = LocalShading && colori.w >= params.shade_threshold;
+
+                        if (visionaray::any(do_shade))
+                        {
+                            // TODO: make this modifiable
+                            plastic<S> mat;
+                            mat.ca() = from_rgb(vector<3, S>(0.3f, 0.3f, 0.3f));
+                            mat.cd() = from_rgb(vector<3, S>(0.8f, 0.8f, 0.8f));
+                            mat.cs() = from_rgb(vector<3, S>(0.8f, 0.8f, 0.8f));
+                            mat.ka() = 1.0f;
+                            mat.kd() = 1.0f;
+                            mat.ks() = 1.0f;
+                            mat.specular_exp() = 1000.0f;
+
+
+                            // calculate shading
+                            vector<3, S> grad;
+
+                            if (params.gradients != nullptr)
+                            {
+                                // Quantized normal in rgb, relative magnitude in alpha
+                                auto g = tex3D(params.gradients[c], tex_coord);
+                                grad = (g.xyz() * S(2.0) - vector<3, S>(1.0)) * g.w;
+                            }
+                            else
+                            {
+                                grad = channel_gradient(level_volumes, c, level_coord);
+                            }
+
+                            auto normal = normalize(grad);
+
+                            auto float_eq = [&](S const& a, S const& b) { return abs(a - b) < params.delta * S(0.5); };
+
+                            Mask at_boundary = float_eq(t, hit_rec.tnear);
+                            I clip_normal_index = select(
+                                    at_boundary,
+                                    I(num_clip_objects), // bbox normal is stored at last position in the list
+                                    I(0)
+                                    );
+
+                            for (int i = 0; i < num_clip_objects; ++i)
+                            {
+                                Mask hit = float_eq(t, clip_intervals[i].y + params.delta); // TODO: understand why +delta
+                                clip_normal_index = select(hit, I(i), clip_normal_index);
+                                at_boundary |= hit;
+                            }
+
+                            if (visionaray::any(at_boundary))
+                            {
+                                auto boundary_normal = gatherv(clip_normals, clip_normal_index);
+                                normal = select(
+                                        at_boundary,
+                                        boundary_normal * colori.w + normal * (S(1.0) - colori.w),
+                                        normal
+                                        );
+                            }
+
+                            do_shade &= length(grad) != 0.0f;
+
+                            shade_record<S> sr;
+                            sr.normal = normal;
+                            sr.geometric_normal = normal;
+                            sr.view_dir = -ray.dir;
+                            sr.tex_color = vector<3, S>(1.0);
+                            sr.light_dir = normalize(params.light.position());
+                            sr.light_intensity = params.light.intensity(pos);
+
+                            auto shaded_clr = mat.shade(sr);
+
+                            colori.xyz() = mul(
+                                    colori.xyz(),
+                                    to_rgb(shaded_clr),
+                                    do_shade,
+                                    colori.xyz()
+                                    );
+                        }
+
+                        // premultiplied alpha
+                        colori.xyz() *= colori.w;
+
+                        color += colori;
+                    }
+
+
+                    // compositing
+                    if (Mode == Params::AlphaCompositing)
+                    {
+                        result.color += select(
+                                t < tmax && !clipped,
+                                color * (1.0f - result.color.w),
+                                C(0.0)
+                                );
+
+                        if (params.reprojection.stride > 0)
+                        {
+                            trep = select(trep < S(0.0) && result.color.w >= 0.5f, t, trep);
+                        }
+
+                        // early-ray termination - don't traverse w/o a contribution
+                        if (params.early_ray_termination && visionaray::all(result.color.w >= 0.999f))
+                        {
+                            return;
+                        }
+                    }
+                    else if (Mode == Params::MaxIntensity)
+                    {
+                        result.color = select(
+                                t < tmax && !clipped,
+                                max(color, result.color),
+                                result.color
+                                );
+                    }
+                    else if (Mode == Params::MinIntensity)
+                    {
+                        result.color = select(
+                                t < tmax && !clipped,
+                                min(color, result.color),
+                                result.color
+                                );
+
+                        sampled |= t < tmax && !clipped;
+                    }
+                    else if (Mode == Params::DRR)
+                    {
+                        result.color += select(
+                                t < tmax && !clipped,
+                                color,
+                                C(0.0)
+                                );
+                    }
+                }
+
+                if (PreIntegration)
+                {
+                    restart = clipped || tnext != t + params.delta;
+                }
+
+                // step on
+                t = tnext;
+            }
+        };
+
+        if (params.kdtree.num_nodes > 0)
+        {
+            // Traverse the k-d tree front to back and only integrate over the ray
+            // segments that overlap non-empty leaves, subtrees no ray of the packet
+            // enters are skipped. Entry points are snapped to the sampling grid of
+            // the whole ray so that leaf boundaries do not produce visible seams
+            enum { MaxStackSize = 64 };
+            int stack[MaxStackSize];
+            int stack_size = 0;
+            stack[stack_size++] = 0;
+
+            S t0 = t;
+
+            while (stack_size > 0)
+            {
+                kd_node const& node = params.kdtree.nodes[stack[--stack_size]];
+
+                auto node_rec = intersect(ray, node.bbox);
+                Mask active = node_rec.hit && node_rec.tfar > t0;
+
+                if (!visionaray::any(active))
+                {
+                    continue;
+                }
+
+                // Inner nodes are pushed as long as there is room, else their
+                // whole bounding box is integrated like a leaf
+                if (node.axis >= 0 && stack_size + 2 <= MaxStackSize)
+                {
+                    int near_child = params.kdtree.eye[node.axis] < node.splitpos ? 0 : 1;
+
+                    stack[stack_size++] = node.children + 1 - near_child;
+                    stack[stack_size++] = node.children + near_child;
+                    continue;
+                }
+
+                S tnear = max(t0, node_rec.tnear);
+                tnear = t0 + ceil((tnear - t0) / params.delta) * params.delta;
+                S tfar = select(active, min(tmax, node_rec.tfar), tnear);
+
+                integrate(tnear, tfar);
+
+                if (Mode == Params::AlphaCompositing
+                 && params.early_ray_termination
+                 && visionaray::all(result.color.w >= 0.999f))
+                {
+                    break;
                 }
             }
+        }
+        else
+        {
+            integrate(t, tmax);
+        }
+
+        // The min. starts out at 1, rays that never sampled the volume stay empty
+        if (Mode == Params::MinIntensity)
+        {
+            result.color = select(sampled, result.color, C(0.0));
+        }
+
+        if (params.reprojection.stride > 0)
+        {
+            // Rays that never got half opaque are represented by their exit point
+            S tpos = select(trep >= S(0.0), trep, tmax);
+            C pos(ray.ori + ray.dir * tpos, select(hit_rec.hit, S(1.0), S(0.0)));
+
+            store_reprojection(x, y, result.color, pos);
+        }
+
+        if (params.progressive.stride > 0)
+        {
+            detail::pixel_access::store( // detail (TODO?)!
+                    pixel_format_constant<PF_RGBA32F>{},        // dst format
+                    pixel_format_constant<PF_RGBA32F>{},        // src format
+                    x,
+                    y,
+                    params.progressive.width,
+                    params.progressive.height,
+                    result.color,
+                    params.progressive.accum
+                    );
+        }
+
+        if (crosshair()) {
+            result.color = C(1.f)-result.color;
+        }
+        result.hit = hit_rec.hit;
+        return result;
+    }
+
+    template <typename C>
+    VSNRAY_FUNC
+    void store_reprojection(int x, int y, C const& color, C const& pos) const
+    {
+        detail::pixel_access::store( // detail (TODO?)!
+                pixel_format_constant<PF_RGBA32F>{},        // dst format
+                pixel_format_constant<PF_RGBA32F>{},        // src format
+                x,
+                y,
+                params.reprojection.width,
+                params.reprojection.height,
+                color,
+                params.reprojection.colors
+                );
+
+        detail::pixel_access::store( // detail (TODO?)!
+                pixel_format_constant<PF_RGBA32F>{},        // dst format
+                pixel_format_constant<PF_RGBA32F>{},        // src format
+                x,
+                y,
+                params.reprojection.width,
+                params.reprojection.height,
+                pos,
+                params.reprojection.positions
+                );
+    }
+
+    Params params;
+    VolRef const* volumes;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Select the kernel specialization once per frame and call it
+//
+
+template <typename Volume, volume_kernel_params::projection_mode Mode, typename Sched, typename SchedParams>
+void call_volume_kernel(
+        Sched&                                  sched,
+        SchedParams const&                      sparams,
+        volume_kernel_params const&             params,
+        typename Volume::ref_type const*        volumes
+        )
+{
+    // Pre-integration is only implemented for alpha compositing
+    static const bool PreInt = Mode == volume_kernel_params::AlphaCompositing;
+
+    if (params.local_shading && params.preint_tables != nullptr)
+    {
+        volume_kernel<Volume, Mode, true, PreInt> kernel(params, volumes);
+        sched.frame(kernel, sparams);
+    }
+    else if (params.local_shading)
+    {
+        volume_kernel<Volume, Mode, true, false> kernel(params, volumes);
+        sched.frame(kernel, sparams);
+    }
+    else if (params.preint_tables != nullptr)
+    {
+        volume_kernel<Volume, Mode, false, PreInt> kernel(params, volumes);
+        sched.frame(kernel, sparams);
+    }
+    else
+    {
+        volume_kernel<Volume, Mode, false, false> kernel(params, volumes);
+        sched.frame(kernel, sparams);
+    }
+}
+
+template <typename Volume, typename Sched, typename SchedParams>
+void call_volume_kernel(
+        Sched&                                  sched,
+        SchedParams const&                      sparams,
+        volume_kernel_params const&             params,
+        typename Volume::ref_type const*        volumes
+        )
+{
+    using Params = volume_kernel_params;
+
+    switch (params.mode)
+    {
+    case Params::AlphaCompositing:
+        call_volume_kernel<Volume, Params::AlphaCompositing>(sched, sparams, params, volumes);
+        break;
+
+    case Params::MaxIntensity:
+        call_volume_kernel<Volume, Params::MaxIntensity>(sched, sparams, params, volumes);
+        break;
+
+    case Params::MinIntensity:
+        call_volume_kernel<Volume, Params::MinIntensity>(sched, sparams, params, volumes);
+        break;
+
+    case Params::DRR:
+        call_volume_kernel<Volume, Params::DRR>(sched, sparams, params, volumes);
+        break;
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Private implementation
+//
+
+struct vvRayCaster::Impl
+{
+    Impl()
+#if defined(VV_ARCH_CUDA)
+        : sched(8, 8)
+#else
+        : sched(vvToolshed::getNumProcessors())
+#endif
+        , space_skip_tree(new virvo::SkipTree(virvo::SkipTree::SVTKdTree))
+        , pool(std::thread::hardware_concurrency())
+    {
+#if !defined(VV_ARCH_CUDA)
+        char* num_threads = getenv("VV_NUM_THREADS");
+        if (num_threads != nullptr)
+        {
+            std::string str(num_threads);
+            sched.reset(std::stoi(str));
+        }
+#endif
+
+        prefetch_queue.run_in_thread();
+    }
+
+    using params_type = volume_kernel_params;
+
+    sched_type                      sched;
+    params_type                     params;
+    std::vector<volume8_type>       volumes8;
+    std::vector<volume16_type>      volumes16;
+    std::vector<volume32_type>      volumes32;
+    std::vector<volume_rgba8_type>  volumes_rgba8;  // interleaved channels, one texture per frame
+    std::vector<bricked8_type>      bricked8;       // CPU only, see VV_BRICKED_TEXTURES
+    std::vector<gradient_type>      gradients;
+    std::vector<transfunc_type>     transfuncs;
+    depth_buffer_type               depth_buffer;
+
+    // Transfer function tables before opacity correction
+    std::vector<aligned_vector<vec4>> transfunc_tables;
+
+    // Exponent the transfuncs are currently opacity corrected with, < 0 if invalid
+    float                           opacity_correction_exponent = -1.0f;
+
+    // Number of entries of the transfer function tables
+    int                             transfunc_size = 0;
+
+    // Pre-integration tables and the slab thickness they were computed for, < 0 if invalid
+    std::vector<preint_type>        preint_tables;
+    float                           preint_thickness = -1.0f;
+
+    bool                            space_skipping = false;
+    std::unique_ptr<virvo::SkipTree> space_skip_tree;
+
+    // Macrocell occupancy for the MacrocellGrid technique, and its coarse level
+    macrocell_type                  macrocells;
+    vec3i                           macrocell_size;
+    macrocell_type                  coarse_macrocells;
+    vec3i                           coarse_macrocell_size;
+
+    // Max./min. intensity projection culling, uses a private macrocell grid
+    // that is independent of the space skipping technique (VV_LEAPEMPTY)
+    std::unique_ptr<virvo::SkipTree> cull_tree;
+    bounds_type                     cull_bounds;
+    vec3i                           cull_cell_size;
+    bool                            cull_volume_valid = false;
+    bool                            cull_tf_valid = false;
+    int                             cull_mode = -1;
+
+    // For texture preprocessing on the host
+    thread_pool                     pool;
+
+    // Internal storage format for textures
+    virvo::PixelFormat              texture_format = virvo::PF_R8;
+
+    // 8-bit data with 2-4 channels is stored interleaved in a single RGBA texture
+    bool                            interleaved = false;
+
+    // Single channel 8-bit textures are stored in bricks (CPU only)
+    bool                            bricked = false;
+
+    // Number of mip pyramid levels per channel, including full resolution.
+    // Only for textures with one channel per texture, see VV_LOD
+    int                             lod_levels = 1;
+
+    // Camera of the last frame, the level of detail is biased while it moves
+    mat4                            lod_view_matrix = mat4::identity();
+    bool                            lod_first_frame = true;
+    bool                            lod_moving = false;
+
+    // Volume textures of a single animation frame, one per channel
+    struct frame_textures
+    {
+        size_t                      frame;
+        std::vector<volume8_type>   volumes8;
+        std::vector<volume16_type>  volumes16;
+        std::vector<volume32_type>  volumes32;
+        std::vector<volume_rgba8_type> volumes_rgba8;
+        std::vector<bricked8_type>  bricked8;
+        std::vector<gradient_type>  gradients;
+    };
+
+    // Texture residency: textures are built on demand per animation frame,
+    // the least recently used frames are released when the budget
+    // (VV_TEX_MEMORY_SIZE in MB, 0 = unlimited) is exceeded
+    std::list<size_t>               resident_frames;    // most recently used first
+    size_t                          frame_bytes = 0;
+    size_t                          last_frame = 0;
+    bool                            precomputed_gradients = false;
+    tex_filter_mode                 filter_mode = Linear;
+
+    // Frames that are prefetched on a background thread during playback
+    enum { NumPrefetchFrames = 2 };
+    std::mutex                      prefetch_mutex;
+    std::condition_variable         prefetch_idle;
+    std::set<size_t>                prefetch_pending;
+    std::vector<frame_textures>     prefetch_ready;
+
+    // Progressive refinement state, passes accumulate until the camera, the
+    // render target, the transfer function, the volume or a parameter changes
+    struct progressive_state
+    {
+        int                         pass = 0;
+        int                         stride = 0;
+        mat4                        view_matrix = mat4::identity();
+        mat4                        proj_matrix = mat4::identity();
+        recti                       viewport = recti(0, 0, 0, 0);
+        vec3                        light_position = vec3(0.0f);
+#ifdef VV_ARCH_CUDA
+        thrust::device_vector<vec4> accum;
+#else
+        aligned_vector<vec4>        accum;
+#endif
+    };
+
+    progressive_state               progressive;
+
+    // Temporal reprojection cache (CPU only), valid until the transfer function,
+    // the volume, the light, the render target or a parameter changes
+    struct reprojection_state
+    {
+        bool                        valid = false;
+        int                         stride = 0;
+        int                         frame = 0;
+        vec3                        light_position = vec3(0.0f);
+        aligned_vector<vec4>        colors;
+        aligned_vector<vec4>        positions;
+        aligned_vector<vec4>        warped_colors;
+        aligned_vector<vec4>        warped_positions;
+
+        // Per pixel depth (high bits) and source pixel (low bits) of the nearest warped sample
+        std::vector<std::atomic<uint64_t>> warped_keys;
+    };
+
+    reprojection_state              reprojection;
+
+    // Serializes access to the host thread pool
+    std::mutex                      pool_mutex;
+
+    // Keep last, so that the worker thread stops before any other member is destroyed
+    virvo::WorkQueue                prefetch_queue;
+
+    void updateVolumeTextures(vvVolDesc* vd, vvRenderer* renderer);
+    void updateTransfuncTexture(vvVolDesc* vd, vvRenderer* renderer);
+    void updateMacrocells();
+    void updateCulling(vvVolDesc* vd, int mode);
+    void applyOpacityCorrection(float exponent);
+    void applyPreIntegration(float thickness);
+    void warpReprojection(mat4 const& proj_view, int width, int height);
+
+    int transfuncSize(vvVolDesc const* vd, vvRenderer* renderer) const;
+    int lodLevels(vvVolDesc const* vd) const;
+
+    // Texture memory budget in bytes, 0 = unlimited
+    size_t textureBudget(vvRenderer* renderer) const;
+    vec2 transfuncScaleBias(vvVolDesc const* vd, int chan) const;
+
+    void makeResident(vvVolDesc* vd, vvRenderer* renderer, size_t frame);
+    void prefetch(vvVolDesc* vd, vvRenderer* renderer, size_t frame);
+    void adoptFrame(vvVolDesc* vd, frame_textures& ft);
+    void releaseFrame(vvVolDesc* vd, size_t frame);
+    void makeFrameTextures(vvVolDesc const* vd, uint8_t const* raw, bool gradients, frame_textures& result);
+    void makeInterleavedFrameTextures(vvVolDesc const* vd, uint8_t const* raw, bool gradients, frame_textures& result);
+
+    template <typename T>
+    void makeGradientTexture(T const* voxels, vec3i size, gradient_type& result);
+
+    template <typename Volume>
+    void makeLodTextures(
+            typename Volume::value_type const*  voxels,
+            vec3i                               size,
+            int                                 chan,
+            int                                 c,
+            std::vector<Volume>&                volumes
+            );
+
+    template <typename Volume>
+    void makeFrameTexturesImpl(
+            vvVolDesc const*            vd,
+            uint8_t const*              raw,
+            bool                        gradients,
+            std::vector<Volume>&        volumes,
+            std::vector<gradient_type>& gradient_textures
+            );
+};
+
+
+void vvRayCaster::Impl::updateVolumeTextures(vvVolDesc* vd, vvRenderer* renderer)
+{
+    // Prefetched frames may refer to stale data
+    {
+        std::unique_lock<std::mutex> lock(prefetch_mutex);
+        prefetch_idle.wait(lock, [this]() { return prefetch_pending.empty(); });
+        prefetch_ready.clear();
+    }
+
+    filter_mode = renderer->getParameter(vvRenderer::VV_SLICEINT).asInt() == virvo::Linear ? Linear : Nearest;
+    precomputed_gradients = renderer->getParameter(vvRenderer::VV_PRECOMPUTED_GRADIENTS);
+
+    // Single channel 16-bit and float data is sampled with full precision,
+    // everything else is rescaled to 8 bits by the texture util
+    bool linear = vd->_binning == vvVolDesc::LINEAR;
+
+    if (vd->getChan() == 1 && vd->bpc == 2 && linear)
+    {
+        texture_format = virvo::PF_R16UI;
+    }
+    else if (vd->getChan() == 1 && vd->bpc == 4 && linear)
+    {
+        texture_format = virvo::PF_R32F;
+    }
+    else
+    {
+        texture_format = virvo::PF_R8;
+    }
+
+    interleaved = texture_format == virvo::PF_R8 && vd->getChan() >= 2 && vd->getChan() <= 4;
+
+#if defined(VV_ARCH_CUDA)
+    bricked = false;
+#else
+    bricked = texture_format == virvo::PF_R8 && !interleaved && renderer->getParameter(vvRenderer::VV_BRICKED_TEXTURES);
+#endif
+
+    lod_levels = renderer->getParameter(vvRenderer::VV_LOD) && !interleaved && !bricked ? lodLevels(vd) : 1;
+
+    // Invalidate all frames, textures are built lazily
+    size_t num_textures = vd->frames * vd->getChan();
+    size_t num_volumes = num_textures * lod_levels;
+
+    volumes8.clear();
+    volumes16.clear();
+    volumes32.clear();
+    volumes_rgba8.clear();
+    bricked8.clear();
+    gradients.clear();
+
+    volumes8.resize(texture_format == virvo::PF_R8 && !interleaved && !bricked ? num_volumes : 0);
+    volumes16.resize(texture_format == virvo::PF_R16UI ? num_volumes : 0);
+    volumes32.resize(texture_format == virvo::PF_R32F ? num_volumes : 0);
+    volumes_rgba8.resize(interleaved ? vd->frames : 0);
+    bricked8.resize(bricked ? num_textures : 0);
+    gradients.resize(precomputed_gradients ? num_textures : 0);
+
+    resident_frames.clear();
+
+    size_t volume_bytes = interleaved
+            ? sizeof(volume_rgba8_type::value_type)
+            : virvo::getPixelSize(texture_format) * vd->getChan();
+    size_t gradient_bytes = precomputed_gradients ? sizeof(gradient_type::value_type) * vd->getChan() : 0;
+    frame_bytes = vd->getFrameVoxels() * (volume_bytes + gradient_bytes);
+
+    for (int l = 1; l < lod_levels; ++l)
+    {
+        size_t level_voxels = static_cast<size_t>(div_up(static_cast<int>(vd->vox[0]), 1 << l))
+                            * div_up(static_cast<int>(vd->vox[1]), 1 << l)
+                            * div_up(static_cast<int>(vd->vox[2]), 1 << l);
+        frame_bytes += level_voxels * volume_bytes;
+    }
+
+    if (vd->frames > 0)
+    {
+        makeResident(vd, renderer, vd->getCurrentFrame());
+    }
+
+    if (space_skipping)
+    {
+        space_skip_tree->updateVolume(*vd);
+        updateMacrocells();
+    }
+
+    cull_volume_valid = false;
+
+    // Data precision or range changed, adapt the transfer function tables
+    if (transfuncSize(vd, renderer) != transfunc_size)
+    {
+        updateTransfuncTexture(vd, renderer);
+    }
+}
+
+void vvRayCaster::Impl::updateTransfuncTexture(vvVolDesc* vd, vvRenderer* renderer)
+{
+    transfunc_size = transfuncSize(vd, renderer);
+
+    transfunc_tables.resize(vd->tf.size());
+    for (size_t i = 0; i < vd->tf.size(); ++i)
+    {
+        aligned_vector<vec4>& tf = transfunc_tables[i];
+        tf.resize(transfunc_size * 1 * 1);
+        vd->computeTFTexture(i, transfunc_size, 1, 1, reinterpret_cast<float*>(tf.data()));
+
+        // Space skipping classifies against the uncorrected opacities
+        if (space_skipping)
+        {
+            space_skip_tree->updateTransfunc(
+                    reinterpret_cast<const uint8_t*>(tf.data()),
+                    transfunc_size,
+                    1,
+                    1,
+                    virvo::PF_RGBA32F);
+        }
+    }
+
+    if (space_skipping)
+    {
+        updateMacrocells();
+    }
+
+    // Textures are rebuilt with the current step size before rendering
+    opacity_correction_exponent = -1.0f;
+    preint_thickness = -1.0f;
+}
+
+void vvRayCaster::Impl::updateMacrocells()
+{
+    virvo::vec3i num_cells;
+    virvo::vec3i cell_size;
+    float const* occupancy = space_skip_tree->getMacrocells(num_cells, cell_size);
+
+    virvo::vec3i num_coarse_cells;
+    virvo::vec3i coarse_cell_size;
+    float const* coarse_occupancy = space_skip_tree->getMacrocells(num_coarse_cells, coarse_cell_size, 1);
+
+    if (occupancy == nullptr || coarse_occupancy == nullptr)
+    {
+        macrocells = macrocell_type();
+        coarse_macrocells = macrocell_type();
+        return;
+    }
+
+    macrocells = macrocell_type(num_cells.x, num_cells.y, num_cells.z);
+    macrocells.reset(occupancy);
+    macrocells.set_address_mode(Clamp);
+    macrocells.set_filter_mode(Nearest);
+    macrocell_size = vec3i(cell_size.x, cell_size.y, cell_size.z);
+
+    coarse_macrocells = macrocell_type(num_coarse_cells.x, num_coarse_cells.y, num_coarse_cells.z);
+    coarse_macrocells.reset(coarse_occupancy);
+    coarse_macrocells.set_address_mode(Clamp);
+    coarse_macrocells.set_filter_mode(Nearest);
+    coarse_macrocell_size = vec3i(coarse_cell_size.x, coarse_cell_size.y, coarse_cell_size.z);
+}
+
+void vvRayCaster::Impl::updateCulling(vvVolDesc* vd, int mode)
+{
+    if (cull_tree == nullptr)
+    {
+        cull_tree.reset(new virvo::SkipTree(virvo::SkipTree::MacrocellGrid));
+    }
+
+    if (!cull_volume_valid)
+    {
+        cull_tree->updateVolume(*vd);
+        cull_volume_valid = true;
+        cull_mode = -1;
+    }
+
+    // Classify with the tables the kernel actually samples from
+    if (!cull_tf_valid && !transfuncs.empty())
+    {
+        aligned_vector<vec4> const& tf = transfunc_tables[0];
+        aligned_vector<vec4> corrected(tf.size());
+
+        for (size_t i = 0; i < tf.size(); ++i)
+        {
+            corrected[i] = tf[i];
+
+            if (opacity_correction_exponent != 1.0f)
+            {
+                corrected[i].w = 1.0f - std::pow(1.0f - tf[i].w, opacity_correction_exponent);
+            }
+        }
+
+        cull_tree->updateTransfunc(
+                reinterpret_cast<const uint8_t*>(corrected.data()),
+                static_cast<int>(corrected.size()),
+                1,
+                1,
+                virvo::PF_RGBA32F);
+
+        cull_tf_valid = true;
+        cull_mode = -1;
+    }
+
+    if (mode == cull_mode)
+    {
+        return;
+    }
+
+    virvo::vec3i num_cells;
+    virvo::vec3i cell_size;
+    bool maximum = mode == params_type::MaxIntensity;
+    float const* bounds = cull_tree->getMacrocellColorBounds(num_cells, cell_size, maximum);
+
+    if (bounds == nullptr)
+    {
+        cull_bounds = bounds_type();
+        return;
+    }
+
+    cull_bounds = bounds_type(num_cells.x, num_cells.y, num_cells.z);
+    cull_bounds.reset(reinterpret_cast<vec4 const*>(bounds));
+    cull_bounds.set_address_mode(Clamp);
+    cull_bounds.set_filter_mode(Nearest);
+    cull_cell_size = vec3i(cell_size.x, cell_size.y, cell_size.z);
+    cull_mode = mode;
+}
+
+int vvRayCaster::Impl::transfuncSize(vvVolDesc const* vd, vvRenderer* renderer) const
+{
+    int size = renderer->getParameter(vvRenderer::VV_TF_SIZE);
+
+    if (size > 0)
+    {
+        return size;
+    }
+
+    // 8-bit textures can't resolve more than 256 entries
+    if (texture_format == virvo::PF_R8)
+    {
+        return 256;
+    }
+
+    // One entry per data value that the transfer function range (i.e. the
+    // zoom range) spans, float data is only limited by the max. table size
+    enum { MinSize = 256, MaxSize = 4096 };
+
+    float num_values = static_cast<float>(MaxSize);
+
+    if (texture_format == virvo::PF_R16UI)
+    {
+        vec2 mapping(vd->mapping(0)[0], vd->mapping(0)[1]);
+        vec2 range(vd->range(0)[0], vd->range(0)[1]);
+
+        if (mapping.y > mapping.x)
+        {
+            num_values = (range.y - range.x) / (mapping.y - mapping.x) * 65535.0f + 1.0f;
+        }
+    }
+
+    size = MinSize;
+    while (size < num_values && size < MaxSize)
+    {
+        size *= 2;
+    }
+
+    return size;
+}
+
+void vvRayCaster::Impl::warpReprojection(mat4 const& proj_view, int width, int height)
+{
+    size_t num_pixels = static_cast<size_t>(width) * height;
+
+    if (!reprojection.valid || reprojection.positions.size() != num_pixels)
+    {
+        reprojection.warped_colors.assign(num_pixels, vec4(0.0f));
+        reprojection.warped_positions.assign(num_pixels, vec4(0.0f));
+        return;
+    }
+
+    reprojection.warped_colors.resize(num_pixels);
+    reprojection.warped_positions.resize(num_pixels);
+
+    if (reprojection.warped_keys.size() != num_pixels)
+    {
+        reprojection.warped_keys = std::vector<std::atomic<uint64_t>>(num_pixels);
+    }
+
+    static const uint64_t NoSample = std::numeric_limits<uint64_t>::max();
+
+    // Depth in [-1..1] and source pixel packed so that the nearest sample has the smallest
+    // key, equal depths resolve to the first source pixel like a serial depth test would
+    auto make_key = [](float depth, size_t i)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+        return (static_cast<uint64_t>(bits) << 32) | static_cast<uint32_t>(i);
+    };
+
+    std::lock_guard<std::mutex> lock(pool_mutex);
+
+    auto& keys = reprojection.warped_keys;
+
+    parallel_for(pool, range1d<int>(0, height), [&](int y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            keys[static_cast<size_t>(y) * width + x].store(NoSample, std::memory_order_relaxed);
+        }
+    });
+
+    // Forward warp with a depth test, rows are scattered concurrently and the nearest
+    // sample per pixel wins an atomic min. Pixels that no sample lands on (disocclusions,
+    // cracks when zooming in) are traced again
+    parallel_for(pool, range1d<int>(0, height), [&](int row)
+    {
+        for (int col = 0; col < width; ++col)
+        {
+            size_t i = static_cast<size_t>(row) * width + col;
+            vec4 const& pos = reprojection.positions[i];
+
+            if (pos.w == 0.0f)
+            {
+                continue;
+            }
+
+            vec4 clip = proj_view * vec4(pos.xyz(), 1.0f);
+
+            if (clip.w <= 0.0f)
+            {
+                continue;
+            }
+
+            vec3 ndc = clip.xyz() / clip.w;
+
+            int x = static_cast<int>(std::floor((ndc.x * 0.5f + 0.5f) * width));
+            int y = static_cast<int>(std::floor((ndc.y * 0.5f + 0.5f) * height));
+
+            if (x < 0 || x >= width || y < 0 || y >= height || ndc.z < -1.0f || ndc.z > 1.0f)
+            {
+                continue;
+            }
+
+            auto& key = keys[static_cast<size_t>(y) * width + x];
+            uint64_t new_key = make_key(ndc.z, i);
+            uint64_t old_key = key.load(std::memory_order_relaxed);
+
+            while (new_key < old_key && !key.compare_exchange_weak(old_key, new_key, std::memory_order_relaxed))
+            {
+            }
+        }
+    });
+
+    // Gather the winning samples
+    parallel_for(pool, range1d<int>(0, height), [&](int y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            size_t index = static_cast<size_t>(y) * width + x;
+            uint64_t key = keys[index].load(std::memory_order_relaxed);
+
+            if (key == NoSample)
+            {
+                reprojection.warped_colors[index]       = vec4(0.0f);
+                reprojection.warped_positions[index]    = vec4(0.0f);
+            }
+            else
+            {
+                size_t i = static_cast<size_t>(key & 0xFFFFFFFFu);
+                reprojection.warped_colors[index]       = reprojection.colors[i];
+                reprojection.warped_positions[index]    = reprojection.positions[i];
+            }
+        }
+    });
+}
+
+size_t vvRayCaster::Impl::textureBudget(vvRenderer* renderer) const
+{
+    // Specified in MB, like vvTexRend::setTexMemorySize()
+    size_t megabytes = renderer->getParameter(vvRenderer::VV_TEX_MEMORY_SIZE);
+    return megabytes * 1024 * 1024;
+}
+
+int vvRayCaster::Impl::lodLevels(vvVolDesc const* vd) const
+{
+    // Halve until the longest axis would drop below MinLodSize voxels
+    enum { MinLodSize = 32 };
+
+    int size = static_cast<int>(std::max(vd->vox[0], std::max(vd->vox[1], vd->vox[2])));
+
+    int levels = 1;
+    while (levels < params_type::MaxLodLevels && (size >> levels) >= MinLodSize)
+    {
+        ++levels;
+    }
+
+    return levels;
+}
+
+vec2 vvRayCaster::Impl::transfuncScaleBias(vvVolDesc const* vd, int chan) const
+{
+    // 8-bit textures are already rescaled to the range of the transfer function
+    if (texture_format == virvo::PF_R8)
+    {
+        return vec2(1.0f, 0.0f);
+    }
+
+    vec2 range(vd->range(chan)[0], vd->range(chan)[1]);
+
+    if (range.y <= range.x)
+    {
+        return vec2(1.0f, 0.0f);
+    }
+
+    // 16-bit textures store [0..1] normalized raw values, apply the data mapping first
+    vec2 mapping = texture_format == virvo::PF_R16UI
+            ? vec2(vd->mapping(chan)[0], vd->mapping(chan)[1])
+            : vec2(0.0f, 1.0f);
+
+    float scale = (mapping.y - mapping.x) / (range.y - range.x);
+    float bias  = (mapping.x - range.x) / (range.y - range.x);
+
+    return vec2(scale, bias);
+}
+
+void vvRayCaster::Impl::applyOpacityCorrection(float exponent)
+{
+    if (exponent == opacity_correction_exponent)
+    {
+        return;
+    }
+
+    transfuncs.resize(transfunc_tables.size());
+    for (size_t i = 0; i < transfunc_tables.size(); ++i)
+    {
+        aligned_vector<vec4> tf(transfunc_tables[i]);
+
+        if (exponent != 1.0f)
+        {
+            for (auto& rgba : tf)
+            {
+                rgba.w = 1.0f - std::pow(1.0f - rgba.w, exponent);
+            }
+        }
+
+        transfuncs[i] = transfunc_type(tf.size());
+        transfuncs[i].reset(tf.data());
+        transfuncs[i].set_address_mode(Clamp);
+        transfuncs[i].set_filter_mode(Nearest);
+    }
+
+    opacity_correction_exponent = exponent;
+    cull_tf_valid = false;
+}
+
+void vvRayCaster::Impl::applyPreIntegration(float thickness)
+{
+    if (thickness == preint_thickness)
+    {
+        return;
+    }
+
+    // The table is quadratic in the number of entries
+    int n = std::min(transfunc_size, 512);
+
+    preint_tables.resize(transfunc_tables.size());
+    for (size_t i = 0; i < transfunc_tables.size(); ++i)
+    {
+        aligned_vector<vec4> const& tf = transfunc_tables[i];
+        int m = static_cast<int>(tf.size());
+
+        // Prefix sums of the extinction coefficient and of the extinction weighted color.
+        // The extinction is derived from the opacities so that the diagonal of the table
+        // (front == back) equals the opacity corrected transfer function
+        std::vector<vec4> prefix(n + 1, vec4(0.0f));
+
+        for (int j = 0; j < n; ++j)
+        {
+            vec4 rgba = tf[std::min(static_cast<int>((j + 0.5f) / n * m), m - 1)];
+            float tau = -std::log(std::max(1.0f - rgba.w, 1e-6f));
+            prefix[j + 1] = prefix[j] + vec4(rgba.xyz() * tau, tau);
+        }
+
+        // Average over the value range of the slab, self attenuation inside
+        // the slab is neglected (like vvTransFunc::makePreintLUTOptimized())
+        aligned_vector<vec4> table(n * n);
+
+        for (int front = 0; front < n; ++front)
+        {
+            for (int back = 0; back < n; ++back)
+            {
+                int lo = std::min(front, back);
+                int hi = std::max(front, back);
+
+                vec4 sum = prefix[hi + 1] - prefix[lo];
+                float tau = sum.w / (hi - lo + 1);
+
+                vec3 color = sum.w > 0.0f ? sum.xyz() / sum.w : vec3(0.0f);
+                float alpha = 1.0f - std::exp(-tau * thickness);
+
+                table[front * n + back] = vec4(color, alpha);
+            }
+        }
+
+        preint_tables[i] = preint_type(n, n);
+        preint_tables[i].reset(table.data());
+        preint_tables[i].set_address_mode(Clamp);
+        preint_tables[i].set_filter_mode(Linear);
+    }
+
+    preint_thickness = thickness;
+}
+
+void vvRayCaster::Impl::makeResident(vvVolDesc* vd, vvRenderer* renderer, size_t frame)
+{
+    // Take over frames the background thread has finished in the meantime
+    {
+        std::lock_guard<std::mutex> lock(prefetch_mutex);
+
+        for (auto& ft : prefetch_ready)
+        {
+            if (std::find(resident_frames.begin(), resident_frames.end(), ft.frame) == resident_frames.end())
+            {
+                adoptFrame(vd, ft);
+                resident_frames.push_front(ft.frame);
+            }
+        }
+
+        prefetch_ready.clear();
+    }
+
+    auto it = std::find(resident_frames.begin(), resident_frames.end(), frame);
+
+    if (it != resident_frames.end())
+    {
+        resident_frames.splice(resident_frames.begin(), resident_frames, it);
+    }
+    else
+    {
+        // Hold the frame while the textures are made from it, the frame
+        // cache may evict it in the meantime
+        vvVolDesc::FramePointer data = vd->getFrame(frame);
+
+        frame_textures ft;
+        ft.frame = frame;
+        makeFrameTextures(vd, data.get(), precomputed_gradients, ft);
+        adoptFrame(vd, ft);
+        resident_frames.push_front(frame);
+    }
+
+    // Evict least recently used frames, but always keep the current one
+    size_t budget = textureBudget(renderer);
+
+    while (budget > 0 && resident_frames.size() > 1 && resident_frames.size() * frame_bytes > budget)
+    {
+        releaseFrame(vd, resident_frames.back());
+        resident_frames.pop_back();
+    }
+}
+
+void vvRayCaster::Impl::prefetch(vvVolDesc* vd, vvRenderer* renderer, size_t frame)
+{
+    if (vd->frames <= 1)
+    {
+        return;
+    }
+
+    // Follow the playback direction
+    int dir = frame >= last_frame ? 1 : -1;
+    last_frame = frame;
+
+    // Don't prefetch more than fits into the budget alongside the current frame
+    size_t num_frames = NumPrefetchFrames;
+    size_t budget = textureBudget(renderer);
+
+    if (budget > 0 && frame_bytes > 0)
+    {
+        size_t max_frames = budget / frame_bytes;
+        num_frames = max_frames > 1 ? std::min(num_frames, max_frames - 1) : 0;
+    }
+
+    for (size_t i = 1; i <= num_frames; ++i)
+    {
+        std::ptrdiff_t n = static_cast<std::ptrdiff_t>(vd->frames);
+        size_t f = static_cast<size_t>(((static_cast<std::ptrdiff_t>(frame) + dir * static_cast<std::ptrdiff_t>(i)) % n + n) % n);
+
+        if (std::find(resident_frames.begin(), resident_frames.end(), f) != resident_frames.end())
+        {
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(prefetch_mutex);
+
+            if (!prefetch_pending.insert(f).second)
+            {
+                continue;
+            }
+        }
+
+        // Look up the frame data here, the volume description is not
+        // safe to be queried for frames from the worker thread. The task
+        // holds the frame, a plain pointer would dangle once the frame
+        // cache evicts it
+        vvVolDesc::FramePointer data = vd->getFrame(f);
+        bool gradients = precomputed_gradients;
+
+        if (!data)
+        {
+            std::lock_guard<std::mutex> lock(prefetch_mutex);
+            prefetch_pending.erase(f);
+            continue;
+        }
+
+        prefetch_queue.post([this, vd, data, f, gradients]()
+        {
+            frame_textures ft;
+            ft.frame = f;
+            makeFrameTextures(vd, data.get(), gradients, ft);
+
+            std::lock_guard<std::mutex> lock(prefetch_mutex);
+            prefetch_ready.push_back(std::move(ft));
+            prefetch_pending.erase(f);
+            prefetch_idle.notify_all();
+        });
+    }
+}
 
-            // step on
-            t = tnext;
-        }
+void vvRayCaster::Impl::adoptFrame(vvVolDesc* vd, frame_textures& ft)
+{
+    if (!volumes_rgba8.empty() && !ft.volumes_rgba8.empty())
+    {
+        volumes_rgba8[ft.frame] = std::move(ft.volumes_rgba8[0]);
+        volumes_rgba8[ft.frame].set_filter_mode(filter_mode);
+    }
 
-        if (crosshair()) {
-            result.color = C(1.f)-result.color;
+    // Volume textures of all pyramid levels
+    int num_volumes = vd->getChan() * lod_levels;
+
+    for (int i = 0; i < num_volumes; ++i)
+    {
+        size_t index = ft.frame * num_volumes + i;
+
+        if (!volumes8.empty())
+        {
+            volumes8[index] = std::move(ft.volumes8[i]);
+            volumes8[index].set_filter_mode(filter_mode);
         }
-        result.hit = hit_rec.hit;
-        return result;
-    }
 
-    Params params;
-    VolRef const* volumes;
-};
+        if (!volumes16.empty())
+        {
+            volumes16[index] = std::move(ft.volumes16[i]);
+            volumes16[index].set_filter_mode(filter_mode);
+        }
 
+        if (!volumes32.empty())
+        {
+            volumes32[index] = std::move(ft.volumes32[i]);
+            volumes32[index].set_filter_mode(filter_mode);
+        }
 
-//-------------------------------------------------------------------------------------------------
-// Private implementation
-//
+        if (!bricked8.empty())
+        {
+            bricked8[index] = std::move(ft.bricked8[i]);
+            bricked8[index].set_filter_mode(filter_mode);
+        }
+    }
 
-struct vvRayCaster::Impl
-{
-    Impl()
-#if defined(VV_ARCH_CUDA)
-        : sched(8, 8)
-#else
-        : sched(vvToolshed::getNumProcessors())
-#endif
-        , space_skip_tree(virvo::SkipTree::SVTKdTree)
+    for (int c = 0; c < vd->getChan(); ++c)
     {
-#if !defined(VV_ARCH_CUDA)
-        char* num_threads = getenv("VV_NUM_THREADS");
-        if (num_threads != nullptr)
+        size_t index = ft.frame * vd->getChan() + c;
+
+        if (!gradients.empty() && !ft.gradients.empty())
         {
-            std::string str(num_threads);
-            sched.reset(std::stoi(str));
+            gradients[index] = std::move(ft.gradients[c]);
+            gradients[index].set_filter_mode(filter_mode);
         }
-#endif
     }
+}
 
-    using params_type = volume_kernel_params;
+void vvRayCaster::Impl::releaseFrame(vvVolDesc* vd, size_t frame)
+{
+    if (!volumes_rgba8.empty())
+    {
+        volumes_rgba8[frame] = volume_rgba8_type();
+    }
 
-    sched_type                      sched;
-    params_type                     params;
-    std::vector<volume8_type>       volumes8;
-    std::vector<volume16_type>      volumes16;
-    std::vector<volume32_type>      volumes32;
-    std::vector<transfunc_type>     transfuncs;
-    depth_buffer_type               depth_buffer;
+    int num_volumes = vd->getChan() * lod_levels;
 
-    bool                            space_skipping = false;
-    virvo::SkipTree                 space_skip_tree;
+    for (int i = 0; i < num_volumes; ++i)
+    {
+        size_t index = frame * num_volumes + i;
 
-    // Internal storage format for textures
-    virvo::PixelFormat              texture_format = virvo::PF_R8;
+        if (!volumes8.empty())
+        {
+            volumes8[index] = volume8_type();
+        }
 
-    void updateVolumeTextures(vvVolDesc* vd, vvRenderer* renderer);
-    void updateTransfuncTexture(vvVolDesc* vd, vvRenderer* renderer);
+        if (!volumes16.empty())
+        {
+            volumes16[index] = volume16_type();
+        }
 
-    template <typename Volumes>
-    void updateVolumeTexturesImpl(vvVolDesc* vd, vvRenderer* renderer, Volumes& volume);
-};
+        if (!volumes32.empty())
+        {
+            volumes32[index] = volume32_type();
+        }
+
+        if (!bricked8.empty())
+        {
+            bricked8[index] = bricked8_type();
+        }
+    }
 
+    for (int c = 0; c < vd->getChan(); ++c)
+    {
+        size_t index = frame * vd->getChan() + c;
 
-void vvRayCaster::Impl::updateVolumeTextures(vvVolDesc* vd, vvRenderer* renderer)
+        if (!gradients.empty())
+        {
+            gradients[index] = gradient_type();
+        }
+    }
+}
+
+void vvRayCaster::Impl::makeFrameTextures(
+        vvVolDesc const*    vd,
+        uint8_t const*      raw,
+        bool                gradients,
+        frame_textures&     result
+        )
 {
-    if (texture_format == virvo::PF_R8)
+    if (interleaved)
+    {
+        makeInterleavedFrameTextures(vd, raw, gradients, result);
+    }
+    else if (bricked)
     {
-        updateVolumeTexturesImpl(vd, renderer, volumes8);
+        makeFrameTexturesImpl(vd, raw, gradients, result.bricked8, result.gradients);
+    }
+    else if (texture_format == virvo::PF_R8)
+    {
+        makeFrameTexturesImpl(vd, raw, gradients, result.volumes8, result.gradients);
     }
     else if (texture_format == virvo::PF_R16UI)
     {
-        updateVolumeTexturesImpl(vd, renderer, volumes16);
+        makeFrameTexturesImpl(vd, raw, gradients, result.volumes16, result.gradients);
     }
     else if (texture_format == virvo::PF_R32F)
     {
-        updateVolumeTexturesImpl(vd, renderer, volumes32);
+        makeFrameTexturesImpl(vd, raw, gradients, result.volumes32, result.gradients);
     }
+}
 
-    if (space_skipping)
+void vvRayCaster::Impl::makeInterleavedFrameTextures(
+        vvVolDesc const*    vd,
+        uint8_t const*      raw,
+        bool                gradients,
+        frame_textures&     result
+        )
+{
+    using texel_type = volume_rgba8_type::value_type;
+
+    vec3i size(vd->vox[0], vd->vox[1], vd->vox[2]);
+    size_t num_voxels = vd->getFrameVoxels();
+
+    // Unused channels stay zero
+    aligned_vector<texel_type> texels(num_voxels, texel_type(unorm<8>(0.0f)));
+
+    result.gradients.resize(gradients ? vd->getChan() : 0);
+
+    virvo::TextureUtil tu(vd);
+    for (int c = 0; c < vd->getChan(); ++c)
     {
-        space_skip_tree.updateVolume(*vd);
+        virvo::TextureUtil::Channels channelbits = 1ULL << c;
+
+        auto tex_data = reinterpret_cast<unorm<8> const*>(tu.getTexture(virvo::vec3i(0),
+            virvo::vec3i(vd->vox),
+            raw,
+            virvo::PF_R8,
+            channelbits));
+
+        for (size_t i = 0; i < num_voxels; ++i)
+        {
+            texels[i][c] = tex_data[i];
+        }
+
+        if (gradients)
+        {
+            makeGradientTexture(tex_data, size, result.gradients[c]);
+            result.gradients[c].set_address_mode(Clamp);
+        }
     }
+
+    result.volumes_rgba8.resize(1);
+    result.volumes_rgba8[0] = volume_rgba8_type(size.x, size.y, size.z);
+    result.volumes_rgba8[0].reset(texels.data());
+    result.volumes_rgba8[0].set_address_mode(Clamp);
 }
 
-void vvRayCaster::Impl::updateTransfuncTexture(vvVolDesc* vd, vvRenderer* /*renderer*/)
+template <typename Volume>
+void vvRayCaster::Impl::makeFrameTexturesImpl(
+        vvVolDesc const*            vd,
+        uint8_t const*              raw,
+        bool                        gradients,
+        std::vector<Volume>&        volumes,
+        std::vector<gradient_type>& gradient_textures
+        )
 {
-    transfuncs.resize(vd->tf.size());
-    for (size_t i = 0; i < vd->tf.size(); ++i)
+    tex_address_mode address_mode = Clamp;
+
+    // Level major, full resolution first
+    volumes.resize(vd->getChan() * lod_levels);
+    gradient_textures.resize(gradients ? vd->getChan() : 0);
+
+    virvo::TextureUtil tu(vd);
+    for (int c = 0; c < vd->getChan(); ++c)
     {
-        aligned_vector<vec4> tf(256 * 1 * 1);
-        vd->computeTFTexture(i, 256, 1, 1, reinterpret_cast<float*>(tf.data()));
+        virvo::TextureUtil::Pointer tex_data = nullptr;
 
-        transfuncs[i] = transfunc_type(tf.size());
-        transfuncs[i].reset(tf.data());
-        transfuncs[i].set_address_mode(Clamp);
-        transfuncs[i].set_filter_mode(Nearest);
+        virvo::TextureUtil::Channels channelbits = 1ULL << c;
 
-        if (space_skipping)
+        tex_data = tu.getTexture(virvo::vec3i(0),
+            virvo::vec3i(vd->vox),
+            raw,
+            texture_format,
+            channelbits);
+
+        volumes[c] = Volume(vd->vox[0], vd->vox[1], vd->vox[2]);
+        volumes[c].reset(reinterpret_cast<typename Volume::value_type const*>(tex_data));
+        volumes[c].set_address_mode(address_mode);
+
+        if (lod_levels > 1)
         {
-            space_skip_tree.updateTransfunc(
-                    reinterpret_cast<const uint8_t*>(tf.data()),
-                    256,
-                    1,
-                    1,
-                    virvo::PF_RGBA32F);
+            makeLodTextures(
+                    reinterpret_cast<typename Volume::value_type const*>(tex_data),
+                    vec3i(vd->vox[0], vd->vox[1], vd->vox[2]),
+                    vd->getChan(),
+                    c,
+                    volumes
+                    );
+        }
+
+        if (gradients)
+        {
+            makeGradientTexture(
+                    reinterpret_cast<typename Volume::value_type const*>(tex_data),
+                    vec3i(vd->vox[0], vd->vox[1], vd->vox[2]),
+                    gradient_textures[c]
+                    );
+            gradient_textures[c].set_address_mode(address_mode);
         }
     }
 }
 
-template <typename Volumes>
-void vvRayCaster::Impl::updateVolumeTexturesImpl(vvVolDesc* vd, vvRenderer* renderer, Volumes& volumes)
+template <typename Volume>
+void vvRayCaster::Impl::makeLodTextures(
+        typename Volume::value_type const*  voxels,
+        vec3i                               size,
+        int                                 chan,
+        int                                 c,
+        std::vector<Volume>&                volumes
+        )
 {
-    using Volume = typename Volumes::value_type;
+    using value_type = typename Volume::value_type;
 
-    tex_filter_mode filter_mode = renderer->getParameter(vvRenderer::VV_SLICEINT).asInt() == virvo::Linear ? Linear : Nearest;
-    tex_address_mode address_mode = Clamp;
+    std::lock_guard<std::mutex> lock(pool_mutex);
 
-    volumes.resize(vd->frames * vd->getChan());
+    // The full resolution level is read in place
+    value_type const* prev = voxels;
+    aligned_vector<value_type> src;
+    aligned_vector<value_type> dst;
 
-    virvo::TextureUtil tu(vd);
-    for (size_t f = 0; f < vd->frames; ++f)
+    // Box filter, odd sizes are rounded up and the last voxel is replicated. The
+    // kernel scales texture coordinates by lod.coord_scale to skip the padding
+    for (int l = 1; l < lod_levels; ++l)
     {
-        for (int c = 0; c < vd->getChan(); ++c)
+        vec3i level_size(div_up(size.x, 2), div_up(size.y, 2), div_up(size.z, 2));
+        dst.resize(level_size.x * level_size.y * level_size.z);
+
+        parallel_for(pool, range1d<int>(0, level_size.z), [&](int z)
+        {
+            for (int y = 0; y < level_size.y; ++y)
+            {
+                for (int x = 0; x < level_size.x; ++x)
+                {
+                    float sum = 0.0f;
+
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        int xx = std::min(x * 2 + (k & 1), size.x - 1);
+                        int yy = std::min(y * 2 + ((k >> 1) & 1), size.y - 1);
+                        int zz = std::min(z * 2 + (k >> 2), size.z - 1);
+                        sum += static_cast<float>(prev[zz * size.x * size.y + yy * size.x + xx]);
+                    }
+
+                    dst[z * level_size.x * level_size.y + y * level_size.x + x] = value_type(sum / 8.0f);
+                }
+            }
+        });
+
+        size_t index = l * chan + c;
+        volumes[index] = Volume(level_size.x, level_size.y, level_size.z);
+        volumes[index].reset(dst.data());
+        volumes[index].set_address_mode(Clamp);
+
+        src.swap(dst);
+        prev = src.data();
+        size = level_size;
+    }
+}
+
+template <typename T>
+void vvRayCaster::Impl::makeGradientTexture(T const* voxels, vec3i size, gradient_type& result)
+{
+    // Central differences with the same orientation as gradient(),
+    // y and z are swapped because of the texture orientation
+    auto diff = [&](int x, int y, int z)
+    {
+        auto at = [&](int xx, int yy, int zz)
         {
-            virvo::TextureUtil::Pointer tex_data = nullptr;
+            xx = clamp(xx, 0, size.x - 1);
+            yy = clamp(yy, 0, size.y - 1);
+            zz = clamp(zz, 0, size.z - 1);
+            return static_cast<float>(voxels[zz * size.x * size.y + yy * size.x + xx]);
+        };
 
-            virvo::TextureUtil::Channels channelbits = 1ULL << c;
+        return vec3(
+                at(x - 1, y, z) - at(x + 1, y, z),
+                at(x, y + 1, z) - at(x, y - 1, z),
+                at(x, y, z + 1) - at(x, y, z - 1)
+                );
+    };
 
-            tex_data = tu.getTexture(virvo::vec3i(0),
-                virvo::vec3i(vd->vox),
-                texture_format,
-                channelbits,
-                f);
+    std::lock_guard<std::mutex> lock(pool_mutex);
 
-            size_t index = f * vd->getChan() + c;
+    // 1st pass: max. gradient magnitude, used to normalize the magnitudes
+    std::vector<float> slice_max(size.z, 0.0f);
 
-            volumes[index] = Volume(vd->vox[0], vd->vox[1], vd->vox[2]);
-            volumes[index].reset(reinterpret_cast<typename Volume::value_type const*>(tex_data));
-            volumes[index].set_address_mode(address_mode);
-            volumes[index].set_filter_mode(filter_mode);
+    parallel_for(pool, range1d<int>(0, size.z), [&](int z)
+    {
+        for (int y = 0; y < size.y; ++y)
+        {
+            for (int x = 0; x < size.x; ++x)
+            {
+                slice_max[z] = max(slice_max[z], length(diff(x, y, z)));
+            }
         }
+    });
+
+    float max_mag = 0.0f;
+    for (float m : slice_max)
+    {
+        max_mag = max(max_mag, m);
     }
+
+    // 2nd pass: quantize, normal in rgb, relative magnitude in alpha. Any
+    // non-zero gradient maps to a non-zero magnitude so that the set of
+    // shaded samples matches on-the-fly central differences
+    aligned_vector<vector<4, unorm<8>>> packed(size.x * size.y * size.z);
+
+    parallel_for(pool, range1d<int>(0, size.z), [&](int z)
+    {
+        for (int y = 0; y < size.y; ++y)
+        {
+            for (int x = 0; x < size.x; ++x)
+            {
+                vec3 g = diff(x, y, z);
+                float mag = length(g);
+                vec3 n = mag > 0.0f ? g / mag : vec3(0.0f);
+                float m = mag > 0.0f ? max(mag / max_mag, 1.0f / 255.0f) : 0.0f;
+
+                packed[z * size.x * size.y + y * size.x + x] = vector<4, unorm<8>>(
+                        vec4(n * 0.5f + vec3(0.5f), m)
+                        );
+            }
+        }
+    });
+
+    result = gradient_type(size.x, size.y, size.z);
+    result.reset(packed.data());
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Per frame camera, light and depth buffer state, either queried from OpenGL or passed in
+//
+
+struct vvRayCaster::FrameState
+{
+    mat4                            view_matrix;
+    mat4                            proj_matrix;
+    recti                           viewport;
+    point_light<float>              light;
+    bool                            depth_test;
+    pixel_format                    depth_format;
+    unsigned const*                 depth_buffer;   // nullptr with depth_test: read back from OpenGL
+};
+
+
 //-------------------------------------------------------------------------------------------------
 // Public interface
 //
@@ -1071,30 +3505,147 @@ void vvRayCaster::renderVolumeGL()
 
         virvo::vec4 clearColor = vvGLTools::queryClearColor();
         vvColor color(1.0f - clearColor[0], 1.0f - clearColor[1], 1.0f - clearColor[2]);
-        impl_->space_skip_tree.renderGL(color);
+        impl_->space_skip_tree->renderGL(color);
 
         if (isLightingEnabled)
             glEnable(GL_LIGHTING);
     }
 
-    mat4 view_matrix;
-    mat4 proj_matrix;
-    recti viewport;
+    FrameState state;
+
+    glGetFloatv(GL_MODELVIEW_MATRIX, state.view_matrix.data());
+    glGetFloatv(GL_PROJECTION_MATRIX, state.proj_matrix.data());
+    glGetIntegerv(GL_VIEWPORT, state.viewport.data());
+
+    // Get OpenGL depth buffer to clip against. A depth buffer that only holds its clear
+    // value clips nothing, so the readback is skipped if the application says so
+    state.depth_format = PF_UNSPECIFIED;
+    state.depth_buffer = nullptr;
+
+    state.depth_test = glIsEnabled(GL_DEPTH_TEST) && !getParameter(VV_DEPTH_CLEARED);
+
+    if (state.depth_test)
+    {
+        GLint depth_bits = 0;
+        glGetFramebufferAttachmentParameteriv(
+                GL_FRAMEBUFFER,
+                GL_DEPTH,
+                GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE,
+                &depth_bits
+                );
+
+        GLint stencil_bits = 0;
+        glGetFramebufferAttachmentParameteriv(
+                GL_FRAMEBUFFER,
+                GL_STENCIL,
+                GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE,
+                &stencil_bits
+                );
+
+
+        // TODO: make this more general
+        // 24-bit depth buffer and 8-bit stencil buffer
+        // is however a quite common case
+        state.depth_format = (depth_bits == 24 && stencil_bits == 8) ? PF_DEPTH24_STENCIL8 : PF_DEPTH32F;
+
+#ifdef __APPLE__
+        // PIXEL_PACK_BUFFER with unsigned does not work
+        // on Mac OS X, default to 32-bit floating point
+        // depth buffer
+        state.depth_format = PF_DEPTH32F;
+#endif
+
+        // Only start the transfer, render() waits for it right before the kernel runs
+        impl_->depth_buffer.map(state.viewport, state.depth_format);
+    }
+
+    // Lights
+    if (getParameter(VV_LIGHTING))
+    {
+        assert( glIsEnabled(GL_LIGHTING) );
+        auto l = virvo::gl::getLight(GL_LIGHT0);
+        vec4 lpos(l.position.x, l.position.y, l.position.z, l.position.w);
+
+        state.light.set_position( (inverse(state.view_matrix) * lpos).xyz() );
+        state.light.set_cl(vec3(l.diffuse.x, l.diffuse.y, l.diffuse.z));
+        state.light.set_kl(l.diffuse.w);
+        state.light.set_constant_attenuation(l.constant_attenuation);
+        state.light.set_linear_attenuation(l.linear_attenuation);
+        state.light.set_quadratic_attenuation(l.quadratic_attenuation);
+    }
+
+    render(state, getRenderTarget());
+
+    if (state.depth_test)
+    {
+        impl_->depth_buffer.unmap();
+    }
+}
+
+void vvRayCaster::renderVolume(HostRenderParams const& params, virvo::HostBufferRT* rt)
+{
+    assert(rt);
+
+#ifdef VV_ARCH_CUDA
+    // The CUDA kernel cannot write to host memory
+    VV_LOG(0) << "vvRayCaster::renderVolume(): not supported by the CUDA ray caster";
+    (void)params;
+#else
+    FrameState state;
+
+    state.view_matrix = mat4(params.viewMatrix.data());
+    state.proj_matrix = mat4(params.projMatrix.data());
+    state.viewport = recti(params.viewport.x, params.viewport.y, params.viewport.w, params.viewport.h);
+
+    // Window space depth values as 32-bit floats
+    state.depth_test = params.depthBuffer != nullptr;
+    state.depth_format = state.depth_test ? PF_DEPTH32F : PF_UNSPECIFIED;
+    state.depth_buffer = reinterpret_cast<unsigned const*>(params.depthBuffer);
+
+    if (getParameter(VV_LIGHTING))
+    {
+        vec4 lpos(params.lightPosition.x, params.lightPosition.y, params.lightPosition.z, params.lightPosition.w);
+
+        state.light.set_position( (inverse(state.view_matrix) * lpos).xyz() );
+        state.light.set_cl(vec3(params.lightDiffuse.x, params.lightDiffuse.y, params.lightDiffuse.z));
+        state.light.set_kl(params.lightDiffuse.w);
+        state.light.set_constant_attenuation(params.lightAttenuation.x);
+        state.light.set_linear_attenuation(params.lightAttenuation.y);
+        state.light.set_quadratic_attenuation(params.lightAttenuation.z);
+    }
+
+    rt->resize(params.viewport.w, params.viewport.h);
+    rt->beginFrame(virvo::CLEAR_COLOR | virvo::CLEAR_DEPTH);
+    render(state, rt);
+    rt->endFrame();
+#endif
+}
 
-    glGetFloatv(GL_MODELVIEW_MATRIX, view_matrix.data());
-    glGetFloatv(GL_PROJECTION_MATRIX, proj_matrix.data());
-    glGetIntegerv(GL_VIEWPORT, viewport.data());
+void vvRayCaster::render(FrameState const& state, virvo::RenderTarget* rt)
+{
+    // Frame textures are built lazily
+    if (vd->frames > 0)
+    {
+        impl_->makeResident(vd, this, vd->getCurrentFrame());
+    }
 
-    virvo::RenderTarget* rt = getRenderTarget();
+    mat4 const& view_matrix = state.view_matrix;
+    mat4 const& proj_matrix = state.proj_matrix;
+    recti const& viewport = state.viewport;
 
     assert(rt);
 
+#if defined(VV_ARCH_CUDA)
     virvo_render_target virvo_rt(
         rt->width(),
         rt->height(),
         static_cast<virvo_render_target::color_type*>(rt->deviceColor()),
         static_cast<virvo_render_target::depth_type*>(rt->deviceDepth())
         );
+#else
+    // The CPU ray caster writes 8-bit or float colors
+    assert(rt->colorFormat() == virvo::PF_RGBA8 || rt->colorFormat() == virvo::PF_RGBA32F);
+#endif
 
     // determine ray integration step size (aka delta)
     int axis = 0;
@@ -1109,48 +3660,62 @@ void vvRayCaster::renderVolumeGL()
 
     float delta = (vd->getSize()[axis] / vd->vox[axis]) / _quality;
 
-    auto bbox = vd->getBoundingBox();
-
-    // Get OpenGL depth buffer to clip against
-    pixel_format depth_format = PF_UNSPECIFIED;
-
-    bool depth_test = glIsEnabled(GL_DEPTH_TEST);
+    // Progressive refinement, not with one pass per brick
+    // as passes would overwrite each other's accumulated results
+    int stride = getParameter(VV_PROGRESSIVE);
 
-    if (depth_test)
+    if (impl_->space_skipping
+     && impl_->space_skip_tree->getTechnique() == virvo::SkipTree::SVTKdTree
+     && !getParameter(VV_SINGLE_PASS_SKIPPING))
     {
-        GLint depth_bits = 0;
-        glGetFramebufferAttachmentParameteriv(
-                GL_FRAMEBUFFER,
-                GL_DEPTH,
-                GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE,
-                &depth_bits
-                );
-
-        GLint stencil_bits = 0;
-        glGetFramebufferAttachmentParameteriv(
-                GL_FRAMEBUFFER,
-                GL_STENCIL,
-                GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE,
-                &stencil_bits
-                );
+        stride = 0;
+    }
 
+    auto& progressive = impl_->progressive;
 
-        // TODO: make this more general
-        // 24-bit depth buffer and 8-bit stencil buffer
-        // is however a quite common case
-        depth_format = (depth_bits == 24 && stencil_bits == 8) ? PF_DEPTH24_STENCIL8 : PF_DEPTH32F;
+    size_t num_pixels = static_cast<size_t>(rt->width()) * rt->height();
+    vec3 light_position = getParameter(VV_LIGHTING) ? state.light.position() : vec3(0.0f);
 
-#ifdef __APPLE__
-        // PIXEL_PACK_BUFFER with unsigned does not work
-        // on Mac OS X, default to 32-bit floating point
-        // depth buffer
-        depth_format = PF_DEPTH32F;
-#endif
+    if (stride != progressive.stride
+     || std::memcmp(state.view_matrix.data(), progressive.view_matrix.data(), sizeof(mat4)) != 0
+     || std::memcmp(state.proj_matrix.data(), progressive.proj_matrix.data(), sizeof(mat4)) != 0
+     || std::memcmp(state.viewport.data(), progressive.viewport.data(), sizeof(recti)) != 0
+     || light_position != progressive.light_position
+     || (stride > 0 && progressive.accum.size() != num_pixels))
+    {
+        progressive.pass            = 0;
+        progressive.stride          = stride;
+        progressive.view_matrix     = state.view_matrix;
+        progressive.proj_matrix     = state.proj_matrix;
+        progressive.viewport        = state.viewport;
+        progressive.light_position  = light_position;
+        progressive.accum.assign(stride > 0 ? num_pixels : 0, vec4(0.0f));
+    }
+
+    // Fill the image with a coarser step size first
+    if (stride > 0 && progressive.pass < stride * stride)
+    {
+        delta *= 2.0f;
+    }
+
+    // Opacity correction depends on the step size and is baked into the
+    // transfer function tables, the kernel only performs plain lookups
+    bool opacity_correction = getParameter(VV_OPCORR);
+    float opacity_correction_exponent = opacity_correction ? delta : 1.0f;
+    impl_->applyOpacityCorrection(opacity_correction_exponent);
 
-        impl_->depth_buffer.map(viewport, depth_format);
-        depth_test = true;
+    // Pre-integrated classification, one table per channel
+    bool preint = getParameter(VV_PREINT)
+            && vd->getChan() <= Impl::params_type::MaxPreintChannels
+            && impl_->transfunc_tables.size() >= static_cast<size_t>(vd->getChan());
+
+    if (preint)
+    {
+        impl_->applyPreIntegration(opacity_correction_exponent);
     }
 
+    auto bbox = vd->getBoundingBox();
+
     // assemble clip objects
     aligned_vector<typename Impl::params_type::clip_object> clip_objects;
 
@@ -1223,33 +3788,16 @@ void vvRayCaster::renderVolumeGL()
 #endif
 
 
-    // Lights
-    point_light<float> light;
-
-    if (getParameter(VV_LIGHTING))
-    {
-        assert( glIsEnabled(GL_LIGHTING) );
-        auto l = virvo::gl::getLight(GL_LIGHT0);
-        vec4 lpos(l.position.x, l.position.y, l.position.z, l.position.w);
-
-        light.set_position( (inverse(view_matrix) * lpos).xyz() );
-        light.set_cl(vec3(l.diffuse.x, l.diffuse.y, l.diffuse.z));
-        light.set_kl(l.diffuse.w);
-        light.set_constant_attenuation(l.constant_attenuation);
-        light.set_linear_attenuation(l.linear_attenuation);
-        light.set_quadratic_attenuation(l.quadratic_attenuation);
-    }
-
-
 #ifdef VV_ARCH_CUDA
     // TODO: consolidate!
     thrust::device_vector<typename volume8_type::ref_type>  device_volumes8;
     auto volumes8_data = [&]()
     {
-        device_volumes8.resize(vd->getChan());
-        for (int c = 0; c < vd->getChan(); ++c)
+        int num_volumes = vd->getChan() * impl_->lod_levels;
+        device_volumes8.resize(num_volumes);
+        for (int i = 0; i < num_volumes; ++i)
         {
-            device_volumes8[c] = typename volume8_type::ref_type(impl_->volumes8[vd->getCurrentFrame() * vd->getChan() + c]);
+            device_volumes8[i] = typename volume8_type::ref_type(impl_->volumes8[vd->getCurrentFrame() * num_volumes + i]);
         }
         return thrust::raw_pointer_cast(device_volumes8.data());
     };
@@ -1257,10 +3805,11 @@ void vvRayCaster::renderVolumeGL()
     thrust::device_vector<typename volume16_type::ref_type> device_volumes16;
     auto volumes16_data = [&]()
     {
-        device_volumes16.resize(vd->getChan());
-        for (int c = 0; c < vd->getChan(); ++c)
+        int num_volumes = vd->getChan() * impl_->lod_levels;
+        device_volumes16.resize(num_volumes);
+        for (int i = 0; i < num_volumes; ++i)
         {
-            device_volumes16[c] = typename volume16_type::ref_type(impl_->volumes16[vd->getCurrentFrame() * vd->getChan() + c]);
+            device_volumes16[i] = typename volume16_type::ref_type(impl_->volumes16[vd->getCurrentFrame() * num_volumes + i]);
         }
         return thrust::raw_pointer_cast(device_volumes16.data());
     };
@@ -1268,14 +3817,39 @@ void vvRayCaster::renderVolumeGL()
     thrust::device_vector<typename volume32_type::ref_type> device_volumes32;
     auto volumes32_data = [&]()
     {
-        device_volumes32.resize(vd->getChan());
-        for (int c = 0; c < vd->getChan(); ++c)
+        int num_volumes = vd->getChan() * impl_->lod_levels;
+        device_volumes32.resize(num_volumes);
+        for (int i = 0; i < num_volumes; ++i)
         {
-            device_volumes32[c] = typename volume32_type::ref_type(impl_->volumes32[vd->getCurrentFrame()* vd->getChan()  + c]);
+            device_volumes32[i] = typename volume32_type::ref_type(impl_->volumes32[vd->getCurrentFrame() * num_volumes + i]);
         }
         return thrust::raw_pointer_cast(device_volumes32.data());
     };
 
+    thrust::device_vector<typename volume_rgba8_type::ref_type> device_volumes_rgba8;
+    auto volumes_rgba8_data = [&]()
+    {
+        device_volumes_rgba8.resize(1);
+        device_volumes_rgba8[0] = typename volume_rgba8_type::ref_type(impl_->volumes_rgba8[vd->getCurrentFrame()]);
+        return thrust::raw_pointer_cast(device_volumes_rgba8.data());
+    };
+
+    thrust::device_vector<typename gradient_type::ref_type> device_gradients;
+    auto gradients_data = [&]() -> typename gradient_type::ref_type const*
+    {
+        if (impl_->gradients.empty())
+        {
+            return nullptr;
+        }
+
+        device_gradients.resize(vd->getChan());
+        for (int c = 0; c < vd->getChan(); ++c)
+        {
+            device_gradients[c] = typename gradient_type::ref_type(impl_->gradients[vd->getCurrentFrame() * vd->getChan() + c]);
+        }
+        return thrust::raw_pointer_cast(device_gradients.data());
+    };
+
     std::vector<typename transfunc_type::ref_type> trefs;
     for (const auto &tf : impl_->transfuncs)
         trefs.push_back(tf);
@@ -1286,15 +3860,30 @@ void vvRayCaster::renderVolumeGL()
         return thrust::raw_pointer_cast(device_transfuncs.data());
     };
 
-    thrust::device_vector<vec2> device_ranges;
-    auto ranges_data = [&]()
+    thrust::device_vector<typename preint_type::ref_type> device_preint_tables;
+    auto preint_tables_data = [&]() -> typename preint_type::ref_type const*
+    {
+        if (!preint)
+        {
+            return nullptr;
+        }
+
+        std::vector<typename preint_type::ref_type> refs;
+        for (const auto& table : impl_->preint_tables)
+            refs.push_back(table);
+        device_preint_tables = refs;
+        return thrust::raw_pointer_cast(device_preint_tables.data());
+    };
+
+    thrust::device_vector<vec2> device_tf_scale_bias;
+    auto tf_scale_bias_data = [&]()
     {
         for (int c = 0; c < vd->getChan(); ++c)
         {
-            device_ranges.push_back(vec2(vd->range(c).x, vd->range(c).y));
+            device_tf_scale_bias.push_back(impl_->transfuncScaleBias(vd, c));
         }
 
-        return thrust::raw_pointer_cast(device_ranges.data());
+        return thrust::raw_pointer_cast(device_tf_scale_bias.data());
     };
 
     thrust::device_vector<typename Impl::params_type::clip_object> device_objects(clip_objects);
@@ -1311,10 +3900,11 @@ void vvRayCaster::renderVolumeGL()
     aligned_vector<typename volume8_type::ref_type>  host_volumes8;
     auto volumes8_data = [&]()
     {
-        host_volumes8.resize(vd->getChan());
-        for (int c = 0; c < vd->getChan(); ++c)
+        int num_volumes = vd->getChan() * impl_->lod_levels;
+        host_volumes8.resize(num_volumes);
+        for (int i = 0; i < num_volumes; ++i)
         {
-            host_volumes8[c] = typename volume8_type::ref_type(impl_->volumes8[vd->getCurrentFrame() + c]);
+            host_volumes8[i] = typename volume8_type::ref_type(impl_->volumes8[vd->getCurrentFrame() * num_volumes + i]);
         }
         return host_volumes8.data();
     };
@@ -1322,10 +3912,11 @@ void vvRayCaster::renderVolumeGL()
     aligned_vector<typename volume16_type::ref_type> host_volumes16;
     auto volumes16_data = [&]()
     {
-        host_volumes16.resize(vd->getChan());
-        for (int c = 0; c < vd->getChan(); ++c)
+        int num_volumes = vd->getChan() * impl_->lod_levels;
+        host_volumes16.resize(num_volumes);
+        for (int i = 0; i < num_volumes; ++i)
         {
-            host_volumes16[c] = typename volume16_type::ref_type(impl_->volumes16[vd->getCurrentFrame() + c]);
+            host_volumes16[i] = typename volume16_type::ref_type(impl_->volumes16[vd->getCurrentFrame() * num_volumes + i]);
         }
         return host_volumes16.data();
     };
@@ -1333,14 +3924,50 @@ void vvRayCaster::renderVolumeGL()
     aligned_vector<typename volume32_type::ref_type> host_volumes32;
     auto volumes32_data = [&]()
     {
-        host_volumes32.resize(vd->getChan());
-        for (int c = 0; c < vd->getChan(); ++c)
+        int num_volumes = vd->getChan() * impl_->lod_levels;
+        host_volumes32.resize(num_volumes);
+        for (int i = 0; i < num_volumes; ++i)
         {
-            host_volumes32[c] = typename volume32_type::ref_type(impl_->volumes32[vd->getCurrentFrame() + c]);
+            host_volumes32[i] = typename volume32_type::ref_type(impl_->volumes32[vd->getCurrentFrame() * num_volumes + i]);
         }
         return host_volumes32.data();
     };
 
+    aligned_vector<typename volume_rgba8_type::ref_type> host_volumes_rgba8;
+    auto volumes_rgba8_data = [&]()
+    {
+        host_volumes_rgba8.resize(1);
+        host_volumes_rgba8[0] = typename volume_rgba8_type::ref_type(impl_->volumes_rgba8[vd->getCurrentFrame()]);
+        return host_volumes_rgba8.data();
+    };
+
+    aligned_vector<typename bricked8_type::ref_type> host_bricked8;
+    auto bricked8_data = [&]()
+    {
+        host_bricked8.resize(vd->getChan());
+        for (int c = 0; c < vd->getChan(); ++c)
+        {
+            host_bricked8[c] = typename bricked8_type::ref_type(impl_->bricked8[vd->getCurrentFrame() * vd->getChan() + c]);
+        }
+        return host_bricked8.data();
+    };
+
+    aligned_vector<typename gradient_type::ref_type> host_gradients;
+    auto gradients_data = [&]() -> typename gradient_type::ref_type const*
+    {
+        if (impl_->gradients.empty())
+        {
+            return nullptr;
+        }
+
+        host_gradients.resize(vd->getChan());
+        for (int c = 0; c < vd->getChan(); ++c)
+        {
+            host_gradients[c] = typename gradient_type::ref_type(impl_->gradients[vd->getCurrentFrame() * vd->getChan() + c]);
+        }
+        return host_gradients.data();
+    };
+
     aligned_vector<typename transfunc_type::ref_type> host_transfuncs(impl_->transfuncs.size());
     auto transfuncs_data = [&]()
     {
@@ -1351,15 +3978,30 @@ void vvRayCaster::renderVolumeGL()
         return host_transfuncs.data();
     };
 
-    aligned_vector<vec2> host_ranges;
-    auto ranges_data = [&]()
+    aligned_vector<typename preint_type::ref_type> host_preint_tables(impl_->preint_tables.size());
+    auto preint_tables_data = [&]() -> typename preint_type::ref_type const*
+    {
+        if (!preint)
+        {
+            return nullptr;
+        }
+
+        for (size_t i = 0; i < impl_->preint_tables.size(); ++i)
+        {
+            host_preint_tables[i] = typename preint_type::ref_type(impl_->preint_tables[i]);
+        }
+        return host_preint_tables.data();
+    };
+
+    aligned_vector<vec2> host_tf_scale_bias;
+    auto tf_scale_bias_data = [&]()
     {
         for (int c = 0; c < vd->getChan(); ++c)
         {
-            host_ranges.push_back(vec2(vd->range(c).x, vd->range(c).y));
+            host_tf_scale_bias.push_back(impl_->transfuncScaleBias(vd, c));
         }
 
-        return host_ranges.data();
+        return host_tf_scale_bias.data();
     };
 
     auto clip_objects_begin = [&]()
@@ -1373,87 +4015,330 @@ void vvRayCaster::renderVolumeGL()
     };
 #endif
 
-    std::vector<virvo::aabb> boxes;
+    // Assemble volume kernel params
+    impl_->params.bbox                      = clip_box(vec3(bbox.min.data()), vec3(bbox.max.data()));
+    impl_->params.roi                       = clip_box(vec3(bbox.min.data()), vec3(bbox.max.data()));
+    impl_->params.delta                     = delta;
+    impl_->params.num_channels              = vd->getChan();
+    impl_->params.transfuncs                = transfuncs_data();
+    impl_->params.preint_tables             = preint_tables_data();
+    impl_->params.gradients                 = gradients_data();
+    impl_->params.tf_scale_bias             = tf_scale_bias_data();
+    impl_->params.depth_buffer              = state.depth_buffer;
+    impl_->params.depth_format              = state.depth_format;
+    impl_->params.mode                      = Impl::params_type::projection_mode(getParameter(VV_MIP_MODE).asInt());
+    impl_->params.depth_test                = state.depth_test;
+    impl_->params.early_ray_termination     = getParameter(VV_TERMINATEEARLY);
+    impl_->params.local_shading             = getParameter(VV_LIGHTING);
+    impl_->params.shade_threshold           = 1.0f - std::pow(1.0f - 0.1f, opacity_correction_exponent);
+    impl_->params.camera_matrix_inv         = inverse(proj_matrix * view_matrix);
+    impl_->params.viewport                  = viewport;
+    impl_->params.light                     = state.light;
+    impl_->params.clip_objects.begin        = clip_objects_begin();
+    impl_->params.clip_objects.end          = clip_objects_end();
+    impl_->params.kdtree.nodes              = nullptr;
+    impl_->params.kdtree.num_nodes          = 0;
+    impl_->params.macrocells.enabled        = false;
+    impl_->params.culling.enabled           = false;
+    impl_->params.progressive.width         = rt->width();
+    impl_->params.progressive.height        = rt->height();
+    impl_->params.progressive.stride        = stride;
+    impl_->params.progressive.pass          = progressive.pass;
+    impl_->params.progressive.replicate     = false;
+#ifdef VV_ARCH_CUDA
+    impl_->params.progressive.accum         = thrust::raw_pointer_cast(progressive.accum.data());
+#else
+    impl_->params.progressive.accum         = progressive.accum.data();
+#endif
+
+    // Max./min. intensity projection: skip cells whose color bounds can't
+    // change the running result. Classification is per channel and lighting
+    // modulates the colors, so this is restricted to unlit single channel data
+    int mode = impl_->params.mode;
+    bool culling = (mode == Impl::params_type::MaxIntensity || mode == Impl::params_type::MinIntensity)
+            && !getParameter(VV_LIGHTING)
+            && vd->getChan() == 1;
 
-    if (impl_->space_skipping)
+    if (culling)
     {
-        virvo::vec3 eye(getEyePosition().x, getEyePosition().y, getEyePosition().z);
-        bool frontToBack = false;
-        auto bricks = impl_->space_skip_tree.getSortedBricks(eye, frontToBack);
+        impl_->updateCulling(vd, mode);
+
+        if (impl_->cull_bounds.width() > 0)
+        {
+            vec3 num_cells(impl_->cull_bounds.width(), impl_->cull_bounds.height(), impl_->cull_bounds.depth());
 
-        boxes.insert(boxes.end(), bricks.begin(), bricks.end());
+            impl_->params.culling.grid          = bounds_type::ref_type(impl_->cull_bounds);
+            impl_->params.culling.num_cells     = num_cells;
+            impl_->params.culling.cell_size     = vec3(impl_->cull_cell_size) / vec3(vd->vox[0], vd->vox[1], vd->vox[2]);
+            impl_->params.culling.enabled       = true;
+        }
     }
-    else
+
+    // Level of detail: primary rays start at the near plane, the size of a pixel grows
+    // linearly from its size on the near plane to its size on the far plane
+    bool moving = !impl_->lod_first_frame
+            && std::memcmp(state.view_matrix.data(), impl_->lod_view_matrix.data(), sizeof(mat4)) != 0;
+    impl_->lod_view_matrix = state.view_matrix;
+    impl_->lod_first_frame = false;
+    impl_->lod_moving = moving && impl_->lod_levels > 1;
+
+    impl_->params.lod.num_levels            = impl_->lod_levels;
+    impl_->params.lod.footprint             = vec2(0.0f);
+
+    if (impl_->lod_levels > 1)
     {
-        boxes.emplace_back(virvo::vec3(bbox.min.data()), virvo::vec3(bbox.max.data()));
-    }
-
-    for (unsigned i = 0; i < boxes.size(); ++i)
-    {
-        const virvo::aabb& b = boxes[i];
-
-        // Assemble volume kernel params and call kernel
-        impl_->params.bbox                      = clip_box(vec3(bbox.min.data()), vec3(bbox.max.data()));
-        impl_->params.roi                       = clip_box(vec3(b.min.data()), vec3(b.max.data()));
-        impl_->params.delta                     = delta;
-        impl_->params.num_channels              = vd->getChan();
-        impl_->params.transfuncs                = transfuncs_data();
-        impl_->params.ranges                    = ranges_data();
-        impl_->params.depth_buffer              = impl_->depth_buffer.data();
-        impl_->params.depth_format              = depth_format;
-        impl_->params.mode                      = Impl::params_type::projection_mode(getParameter(VV_MIP_MODE).asInt());
-        impl_->params.depth_test                = depth_test;
-        impl_->params.opacity_correction        = getParameter(VV_OPCORR);
-        impl_->params.early_ray_termination     = getParameter(VV_TERMINATEEARLY);
-        impl_->params.local_shading             = getParameter(VV_LIGHTING);
-        impl_->params.camera_matrix_inv         = inverse(proj_matrix * view_matrix);
-        impl_->params.viewport                  = viewport;
-        impl_->params.light                     = light;
-        impl_->params.clip_objects.begin        = clip_objects_begin();
-        impl_->params.clip_objects.end          = clip_objects_end();
-
-        // Composite bricks in back-to-front order
-        pixel_sampler::basic_uniform_blend_type<blending::scale_factor> blend_params;
-        blend_params.sfactor = blending::One;
-        blend_params.dfactor = blending::OneMinusSrcAlpha;
-
-        auto sparams = make_sched_params(
-            blend_params,
-            view_matrix,
-            proj_matrix,
-            virvo_rt
-            );
+        // Level sizes as in makeLodTextures(), a voxel of level l spans 2^l voxels of level 0
+        vec3i size(vd->vox[0], vd->vox[1], vd->vox[2]);
+        vec3i level_size = size;
+
+        for (int l = 0; l < impl_->lod_levels; ++l)
+        {
+            impl_->params.lod.coord_scale[l] = vec3(size) / vec3(level_size * (1 << l));
+            level_size = vec3i(div_up(level_size.x, 2), div_up(level_size.y, 2), div_up(level_size.z, 2));
+        }
+
+        mat4 inv = impl_->params.camera_matrix_inv;
+
+        auto unproject = [&](float x, float y, float z)
+        {
+            vec4 v = inv * vec4(x, y, z, 1.0f);
+            return v.xyz() / v.w;
+        };
+
+        float pixel = 2.0f / viewport.w;
+
+        vec3 near_center = unproject(0.0f, 0.0f, -1.0f);
+        vec3 far_center  = unproject(0.0f, 0.0f,  1.0f);
+        float near_size  = length(unproject(pixel, 0.0f, -1.0f) - near_center);
+        float far_size   = length(unproject(pixel, 0.0f,  1.0f) - far_center);
+        float dist       = length(far_center - near_center);
+
+        // In voxels of the full resolution level, coarsest axis
+        vec3 voxel = impl_->params.bbox.size() / vec3(vd->vox[0], vd->vox[1], vd->vox[2]);
+        float voxel_size = max(voxel.x, max(voxel.y, voxel.z));
+
+        // Coarser levels while the camera moves
+        float bias = impl_->lod_moving ? std::pow(2.0f, static_cast<float>(getParameter(VV_LOD_MOTION).asInt())) : 1.0f;
+
+        impl_->params.lod.footprint = vec2(
+                dist > 0.0f ? (far_size - near_size) / dist : 0.0f,
+                near_size
+                ) * (bias / voxel_size);
+    }
+
+    // Temporal reprojection: warp the previous frame into the current view, the kernel
+    // only traces pixels without a warped sample and a rotating subset of packets.
+    // Geometry in the depth buffer may change independently of the camera, and
+    // progressive refinement and per brick passes already reuse or blend the image
+    int reprojection_stride = getParameter(VV_REPROJECTION);
+
+    if (stride > 0
+     || state.depth_test
+     || impl_->params.mode != Impl::params_type::AlphaCompositing
+     || (impl_->space_skipping
+      && impl_->space_skip_tree->getTechnique() == virvo::SkipTree::SVTKdTree
+      && !getParameter(VV_SINGLE_PASS_SKIPPING)))
+    {
+        reprojection_stride = 0;
+    }
+
+    auto& reprojection = impl_->reprojection;
+
+    if (reprojection_stride != reprojection.stride || light_position != reprojection.light_position)
+    {
+        reprojection.valid          = false;
+        reprojection.stride         = reprojection_stride;
+        reprojection.light_position = light_position;
+    }
+
+    impl_->params.reprojection.stride       = 0;
+
+#if !defined(VV_ARCH_CUDA)
+    if (reprojection_stride > 0)
+    {
+        impl_->warpReprojection(proj_matrix * view_matrix, rt->width(), rt->height());
+
+        reprojection.colors.resize(num_pixels);
+        reprojection.positions.resize(num_pixels);
+
+        impl_->params.reprojection.warped_colors    = reprojection.warped_colors.data();
+        impl_->params.reprojection.warped_positions = reprojection.warped_positions.data();
+        impl_->params.reprojection.colors           = reprojection.colors.data();
+        impl_->params.reprojection.positions        = reprojection.positions.data();
+        impl_->params.reprojection.width            = rt->width();
+        impl_->params.reprojection.height           = rt->height();
+        impl_->params.reprojection.stride           = reprojection_stride;
+        impl_->params.reprojection.frame            = reprojection.frame++;
+    }
+#endif
+
+    // Depth buffer readback that renderVolumeGL() started, wait for it as late as possible
+    if (state.depth_test && state.depth_buffer == nullptr)
+    {
+        impl_->params.depth_buffer = impl_->depth_buffer.data();
+
+        // Render without clipping against geometry rather than read from a null buffer
+        if (impl_->params.depth_buffer == nullptr)
+        {
+            impl_->params.depth_test = false;
+        }
+    }
+
+    // Composite bricks in back-to-front order
+#if defined(VV_ARCH_CUDA)
+    pixel_sampler::basic_uniform_blend_type<blending::scale_factor> blend_params;
+    blend_params.sfactor = blending::One;
+    blend_params.dfactor = blending::OneMinusSrcAlpha;
+
+    auto sparams = make_sched_params(
+        blend_params,
+        view_matrix,
+        proj_matrix,
+        virvo_rt
+        );
+#else
+    cost_sched_params sparams;
+    sparams.view_matrix  = view_matrix;
+    sparams.proj_matrix  = proj_matrix;
+    sparams.color        = rt->deviceColor();
+    sparams.color_format = rt->colorFormat() == virvo::PF_RGBA8 ? PF_RGBA8 : PF_RGBA32F;
+    sparams.width        = rt->width();
+    sparams.height       = rt->height();
+
+    impl_->sched.begin_frame();
+#endif
 
-        if (impl_->texture_format == virvo::PF_R8)
+    auto render_pass = [&]()
+    {
+        if (impl_->interleaved)
+        {
+            call_volume_kernel<volume_rgba8_type>(impl_->sched, sparams, impl_->params, volumes_rgba8_data());
+        }
+#if !defined(VV_ARCH_CUDA)
+        else if (impl_->bricked)
+        {
+            call_volume_kernel<bricked8_type>(impl_->sched, sparams, impl_->params, bricked8_data());
+        }
+#endif
+        else if (impl_->texture_format == virvo::PF_R8)
         {
-            volume_kernel<volume8_type> kernel(impl_->params, volumes8_data());
-            impl_->sched.frame(kernel, sparams);
+            call_volume_kernel<volume8_type>(impl_->sched, sparams, impl_->params, volumes8_data());
         }
         else if (impl_->texture_format == virvo::PF_R16UI)
         {
-            volume_kernel<volume16_type> kernel(impl_->params, volumes16_data());
-            impl_->sched.frame(kernel, sparams);
+            call_volume_kernel<volume16_type>(impl_->sched, sparams, impl_->params, volumes16_data());
         }
         else if (impl_->texture_format == virvo::PF_R32F)
         {
-            volume_kernel<volume32_type> kernel(impl_->params, volumes32_data());
-            impl_->sched.frame(kernel, sparams);
+            call_volume_kernel<volume32_type>(impl_->sched, sparams, impl_->params, volumes32_data());
+        }
+    };
+
+    // Eye position in object space, like vvRenderer::getEyePosition()
+    vec4 proj_eye = inverse(view_matrix) * (inverse(proj_matrix) * vec4(0.0f, 0.0f, -1.0f, 0.0f));
+    vec3 eye_pos = proj_eye.xyz() / proj_eye.w;
+
+    if (impl_->space_skipping && impl_->space_skip_tree->getTechnique() == virvo::SkipTree::MacrocellGrid)
+    {
+        // Rays step through the macrocell grid in a single pass
+        if (impl_->macrocells.width() > 0)
+        {
+            vec3 vox(vd->vox[0], vd->vox[1], vd->vox[2]);
+            vec3 num_cells(impl_->macrocells.width(), impl_->macrocells.height(), impl_->macrocells.depth());
+            vec3 num_coarse_cells(
+                    impl_->coarse_macrocells.width(),
+                    impl_->coarse_macrocells.height(),
+                    impl_->coarse_macrocells.depth()
+                    );
+
+            impl_->params.macrocells.grid               = macrocell_type::ref_type(impl_->macrocells);
+            impl_->params.macrocells.num_cells          = num_cells;
+            impl_->params.macrocells.cell_size          = vec3(impl_->macrocell_size) / vox;
+            impl_->params.macrocells.coarse_grid        = macrocell_type::ref_type(impl_->coarse_macrocells);
+            impl_->params.macrocells.num_coarse_cells   = num_coarse_cells;
+            impl_->params.macrocells.coarse_cell_size   = vec3(impl_->coarse_macrocell_size) / vox;
+            impl_->params.macrocells.enabled            = true;
         }
+
+        render_pass();
     }
+    else if (impl_->space_skipping && getParameter(VV_SINGLE_PASS_SKIPPING))
+    {
+        // Upload the k-d tree once, rays traverse it
+        // front to back and only enter the leaves they hit
+        auto nodes = impl_->space_skip_tree->getNodes();
+
+        aligned_vector<kd_node> host_nodes(nodes.size());
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            host_nodes[i].bbox      = aabb(vec3(nodes[i].bbox.min.data()), vec3(nodes[i].bbox.max.data()));
+            host_nodes[i].axis      = nodes[i].axis;
+            host_nodes[i].splitpos  = nodes[i].splitpos;
+            host_nodes[i].children  = nodes[i].children;
+        }
+
+#ifdef VV_ARCH_CUDA
+        thrust::device_vector<kd_node> device_nodes(host_nodes.begin(), host_nodes.end());
+        impl_->params.kdtree.nodes = thrust::raw_pointer_cast(device_nodes.data());
+#else
+        impl_->params.kdtree.nodes = host_nodes.data();
+#endif
+        impl_->params.kdtree.num_nodes = static_cast<int>(host_nodes.size());
+        impl_->params.kdtree.eye       = eye_pos;
 
-    if (depth_test)
+        // No tree, nothing to render
+        if (!host_nodes.empty())
+        {
+            render_pass();
+        }
+    }
+    else if (impl_->space_skipping)
     {
-        impl_->depth_buffer.unmap();
+        virvo::vec3 eye(eye_pos.x, eye_pos.y, eye_pos.z);
+        bool frontToBack = false;
+        auto bricks = impl_->space_skip_tree->getSortedBricks(eye, frontToBack);
+
+        // One pass per brick, composited in back-to-front order
+        for (size_t i = 0; i < bricks.size(); ++i)
+        {
+            const virvo::aabb& b = bricks[i];
+            impl_->params.roi = clip_box(vec3(b.min.data()), vec3(b.max.data()));
+            render_pass();
+        }
+    }
+    else
+    {
+        render_pass();
+    }
+
+    // Fill the rest of each block only after the
+    // pass has completed, see volume_kernel_params
+    if (stride > 0 && progressive.pass < stride * stride - 1)
+    {
+        impl_->params.progressive.replicate = true;
+        render_pass();
+        impl_->params.progressive.replicate = false;
     }
+
+    if (stride > 0 && progressive.pass < 2 * stride * stride)
+    {
+        ++progressive.pass;
+    }
+
+    reprojection.valid = impl_->params.reprojection.stride > 0;
 }
 
 void vvRayCaster::updateTransferFunction()
 {
+    impl_->progressive.pass = 0;
+    impl_->reprojection.valid = false;
     impl_->updateTransfuncTexture(vd, this);
 }
 
 void vvRayCaster::updateVolumeData()
 {
+    impl_->progressive.pass = 0;
+    impl_->reprojection.valid = false;
     impl_->updateVolumeTextures(vd, this);
 }
 
@@ -1461,9 +4346,17 @@ void vvRayCaster::setCurrentFrame(size_t frame)
 {
     vvRenderer::setCurrentFrame(frame);
 
+    impl_->progressive.pass = 0;
+    impl_->reprojection.valid = false;
+
+    impl_->makeResident(vd, this, vd->getCurrentFrame());
+    impl_->prefetch(vd, this, vd->getCurrentFrame());
+
+    impl_->cull_volume_valid = false;
+
     if (impl_->space_skipping)
     {
-        impl_->space_skip_tree.updateVolume(*vd);
+        impl_->space_skip_tree->updateVolume(*vd);
         impl_->updateTransfuncTexture(vd, this);
     }
 }
@@ -1491,8 +4384,49 @@ bool vvRayCaster::checkParameter(ParameterType param, vvParam const& value) cons
     case VV_CLIP_OBJ5:
     case VV_CLIP_OBJ6:
     case VV_CLIP_OBJ7:
+    case VV_LEAPEMPTY:
+    case VV_PREINT:
+    case VV_SINGLE_PASS_SKIPPING:
+    case VV_PRECOMPUTED_GRADIENTS:
+    case VV_DEPTH_CLEARED:
+        return true;
+
+#if !defined(VV_ARCH_CUDA)
+    case VV_BRICKED_TEXTURES:
+        return true;
+
+    case VV_IMG_PRECISION:
+    case VV_IMAGE_PRECISION:
+        return value.asInt() == 8 || value.asInt() == 16 || value.asInt() == 32;
+
+    case VV_REPROJECTION:
+        {
+            // Off, or a power of two for the refresh pattern
+            int stride = value.asInt();
+            return stride == 0 || (stride >= 2 && stride <= 8 && (stride & (stride - 1)) == 0);
+        }
+#endif
+
+    case VV_TF_SIZE:
+        return value.asInt() == 0 || (value.asInt() >= 2 && value.asInt() <= 65536);
+
+    case VV_LOD:
         return true;
 
+    case VV_LOD_MOTION:
+        return value.asInt() >= 0 && value.asInt() <= 8;
+
+    case VV_SKIP_TECHNIQUE:
+        return value.asInt() == virvo::SkipTree::SVTKdTree
+            || value.asInt() == virvo::SkipTree::MacrocellGrid;
+
+    case VV_PROGRESSIVE:
+        {
+            // Off, or a power of two for the interleaved pattern
+            int stride = value.asInt();
+            return stride == 0 || (stride >= 2 && stride <= 8 && (stride & (stride - 1)) == 0);
+        }
+
     default:
         return vvRenderer::checkParameter(param, value);
     }
@@ -1500,6 +4434,11 @@ bool vvRayCaster::checkParameter(ParameterType param, vvParam const& value) cons
 
 void vvRayCaster::setParameter(ParameterType param, vvParam const& value)
 {
+    // Any parameter may change the image, restart progressive
+    // refinement and drop the reprojection cache
+    impl_->progressive.pass = 0;
+    impl_->reprojection.valid = false;
+
     switch (param)
     {
     case VV_SLICEINT:
@@ -1508,6 +4447,7 @@ void vvRayCaster::setParameter(ParameterType param, vvParam const& value)
             {
                 _interpolation = static_cast< virvo::tex_filter_mode >(value.asInt());
                 tex_filter_mode filter_mode = _interpolation == virvo::Linear ? Linear : Nearest;
+                impl_->filter_mode = filter_mode;
 
                 for (auto& tex : impl_->volumes8)
                 {
@@ -1523,6 +4463,105 @@ void vvRayCaster::setParameter(ParameterType param, vvParam const& value)
                 {
                     tex.set_filter_mode(filter_mode);
                 }
+
+                for (auto& tex : impl_->volumes_rgba8)
+                {
+                    tex.set_filter_mode(filter_mode);
+                }
+
+                for (auto& tex : impl_->bricked8)
+                {
+                    tex.set_filter_mode(filter_mode);
+                }
+
+                for (auto& tex : impl_->gradients)
+                {
+                    tex.set_filter_mode(filter_mode);
+                }
+            }
+        }
+        break;
+
+    case VV_LEAPEMPTY:
+        {
+            vvRenderer::setParameter(param, value);
+
+            bool space_skipping = value;
+
+            if (impl_->space_skipping != space_skipping)
+            {
+                impl_->space_skipping = space_skipping;
+
+                if (impl_->space_skipping)
+                {
+                    impl_->space_skip_tree->updateVolume(*vd);
+                    impl_->updateTransfuncTexture(vd, this);
+                }
+            }
+        }
+        break;
+
+    case VV_PRECOMPUTED_GRADIENTS:
+        if (_precomputedGradients != static_cast<bool>(value))
+        {
+            vvRenderer::setParameter(param, value);
+            impl_->updateVolumeTextures(vd, this);
+        }
+        break;
+
+    case VV_BRICKED_TEXTURES:
+        if (_brickedTextures != static_cast<bool>(value))
+        {
+            vvRenderer::setParameter(param, value);
+            impl_->updateVolumeTextures(vd, this);
+        }
+        break;
+
+    case VV_TF_SIZE:
+        if (_tfSize != value.asInt())
+        {
+            vvRenderer::setParameter(param, value);
+            impl_->updateTransfuncTexture(vd, this);
+        }
+        break;
+
+#if !defined(VV_ARCH_CUDA)
+    case VV_IMG_PRECISION:
+    case VV_IMAGE_PRECISION:
+        {
+            // 8 bits per channel, everything else renders to float
+            _imagePrecision = value.asInt() == 8 ? virvo::Byte : virvo::Float;
+
+            virvo::PixelFormat format = _imagePrecision == virvo::Byte ? virvo::PF_RGBA8 : virvo::PF_RGBA32F;
+
+            if (getRenderTarget() == nullptr || getRenderTarget()->colorFormat() != format)
+            {
+                setRenderTarget(virvo::HostBufferRT::create(format, virvo::PF_UNSPECIFIED));
+            }
+        }
+        break;
+#endif
+
+    case VV_LOD:
+        if (_lod != static_cast<bool>(value))
+        {
+            vvRenderer::setParameter(param, value);
+            impl_->updateVolumeTextures(vd, this);
+        }
+        break;
+
+    case VV_SKIP_TECHNIQUE:
+        if (_skipTechnique != value.asInt())
+        {
+            vvRenderer::setParameter(param, value);
+
+            auto technique = static_cast<virvo::SkipTree::Technique>(_skipTechnique);
+            impl_->space_skip_tree.reset(new virvo::SkipTree(technique));
+
+            if (impl_->space_skipping)
+            {
+                impl_->space_skip_tree->updateVolume(*vd);
+                impl_->updateTransfuncTexture(vd, this);
             }
         }
         break;
@@ -1538,6 +4577,18 @@ bool vvRayCaster::instantClassification() const
     return true;
 }
 
+bool vvRayCaster::isConverged() const
+{
+    // Frames rendered with the coarser level of detail of a moving camera need a refresh
+    if (impl_->lod_moving)
+    {
+        return false;
+    }
+
+    int stride = impl_->progressive.stride;
+    return stride == 0 || impl_->progressive.pass >= 2 * stride * stride;
+}
+
 vvRenderer* createRayCaster(vvVolDesc* vd, vvRenderState const& rs)
 {
     return new vvRayCaster(vd, rs);
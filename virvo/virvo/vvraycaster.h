@@ -27,11 +27,31 @@
 
 class vvRayCaster : public vvRenderer
 {
+public:
+    // Camera, viewport, light and depth buffer for rendering without OpenGL
+    struct HostRenderParams
+    {
+        virvo::mat4 viewMatrix;                 ///< modelview matrix
+        virvo::mat4 projMatrix;                 ///< projection matrix
+        virvo::recti viewport;                  ///< x, y, width, height [pixels]
+        virvo::vec4 lightPosition;              ///< light position in eye coordinates (like GL_LIGHT0), used with VV_LIGHTING
+        virvo::vec4 lightDiffuse;               ///< diffuse light color (rgb) and intensity (w)
+        virvo::vec3 lightAttenuation;           ///< constant, linear and quadratic light attenuation
+        const float* depthBuffer;               ///< viewport sized window space depth [0..1] to clip against, NULL = no depth test
+    };
+
 public:
     VVAPI vvRayCaster(vvVolDesc* vd, vvRenderState renderState);
     VVAPI ~vvRayCaster();
 
     VVAPI virtual void renderVolumeGL() VV_OVERRIDE;
+
+    // Render into a host memory render target without querying or modifying
+    // OpenGL state, so that no OpenGL context is required (CPU ray casters only).
+    // The render target must have a PF_RGBA8 or PF_RGBA32F color buffer, it
+    // is resized to the viewport and cleared
+    VVAPI void renderVolume(HostRenderParams const& params, virvo::HostBufferRT* rt);
+
     VVAPI virtual void updateTransferFunction() VV_OVERRIDE;
     VVAPI virtual void updateVolumeData() VV_OVERRIDE;
     VVAPI virtual void  setCurrentFrame(size_t frame) VV_OVERRIDE;
@@ -39,10 +59,19 @@ public:
     VVAPI virtual void setParameter(ParameterType param, const vvParam& newValue) VV_OVERRIDE;
     /*VVAPI virtual vvParam getParameter(ParameterType param) const VV_OVERRIDE;*/
     VVAPI virtual bool instantClassification() const VV_OVERRIDE;
+
+    // With VV_PROGRESSIVE, true if the image is fully refined and further
+    // frames with unchanged camera, transfer function and frame would be
+    // identical. Always true if progressive refinement is off. With VV_LOD,
+    // false after a frame that was rendered coarser because the camera moved
+    VVAPI bool isConverged() const;
 private:
     struct Impl;
     boost::scoped_ptr<Impl> impl_;
 
+    struct FrameState;
+    void render(FrameState const& state, virvo::RenderTarget* rt);
+
 private:
 
     VV_NOT_COPYABLE(vvRayCaster)
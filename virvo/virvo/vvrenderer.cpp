@@ -108,6 +108,16 @@ vvRenderState::vvRenderState()
   , _preIntegration(false)
   , _depthPrecision(8)
   , depth_range_(0.0f, 0.0f)
+  , _singlePassSkipping(true)
+  , _precomputedGradients(false)
+  , _skipTechnique(0)
+  , _progressive(0)
+  , _brickedTextures(false)
+  , _tfSize(0)
+  , _lod(false)
+  , _lodMotion(1)
+  , _reprojection(0)
+  , _depthCleared(false)
   , _focusClipObj(0)
 {
   // initialize clip objects
@@ -331,6 +341,37 @@ void vvRenderState::setParameter(ParameterType param, const vvParam& value)
     break;
   case VV_PIX_SHADER:
     _currentShader = value;
+    break;
+  case VV_SINGLE_PASS_SKIPPING:
+    _singlePassSkipping = value;
+    break;
+  case VV_PRECOMPUTED_GRADIENTS:
+    _precomputedGradients = value;
+    break;
+  case VV_SKIP_TECHNIQUE:
+    _skipTechnique = value;
+    break;
+  case VV_PROGRESSIVE:
+    _progressive = value;
+    break;
+  case VV_BRICKED_TEXTURES:
+    _brickedTextures = value;
+    break;
+  case VV_TF_SIZE:
+    _tfSize = value;
+    break;
+  case VV_LOD:
+    _lod = value;
+    break;
+  case VV_LOD_MOTION:
+    _lodMotion = value;
+    break;
+  case VV_REPROJECTION:
+    _reprojection = value;
+    break;
+  case VV_DEPTH_CLEARED:
+    _depthCleared = value;
+    break;
   default:
     break;
   }
@@ -479,6 +520,26 @@ vvParam vvRenderState::getParameter(ParameterType param) const
     return _clipOutlines[param - VV_CLIP_OUTLINE0];
   case VV_PIX_SHADER:
     return _currentShader;
+  case VV_SINGLE_PASS_SKIPPING:
+    return _singlePassSkipping;
+  case VV_PRECOMPUTED_GRADIENTS:
+    return _precomputedGradients;
+  case VV_SKIP_TECHNIQUE:
+    return _skipTechnique;
+  case VV_PROGRESSIVE:
+    return _progressive;
+  case VV_BRICKED_TEXTURES:
+    return _brickedTextures;
+  case VV_TF_SIZE:
+    return _tfSize;
+  case VV_LOD:
+    return _lod;
+  case VV_LOD_MOTION:
+    return _lodMotion;
+  case VV_REPROJECTION:
+    return _reprojection;
+  case VV_DEPTH_CLEARED:
+    return _depthCleared;
   default:
     return vvParam();
   }
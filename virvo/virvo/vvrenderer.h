@@ -160,7 +160,20 @@ public:
     VV_CLIP_OUTLINE5,
     VV_CLIP_OUTLINE6,
     VV_CLIP_OUTLINE7,
-    VV_CLIP_OUTLINE_LAST
+    VV_CLIP_OUTLINE_LAST,
+
+    // Appended so that the values above, which are sent to remote
+    // renderers, stay the same
+    VV_SINGLE_PASS_SKIPPING,                    ///< traverse all empty space leaping bricks in a single rendering pass
+    VV_PRECOMPUTED_GRADIENTS,                   ///< shade with a precomputed, quantized gradient volume
+    VV_SKIP_TECHNIQUE,                          ///< empty space leaping data structure, see virvo::SkipTree::Technique
+    VV_PROGRESSIVE,                             ///< progressive refinement, render every n-th pixel per axis first (0 = off)
+    VV_BRICKED_TEXTURES,                        ///< store CPU volume textures in bricks for view independent cache behavior
+    VV_TF_SIZE,                                 ///< number of transfer function table entries, 0 = derive from data precision
+    VV_LOD,                                     ///< sample from a mip pyramid, level chosen by the projected voxel footprint
+    VV_LOD_MOTION,                              ///< number of additional, coarser levels while the camera moves
+    VV_REPROJECTION,                            ///< reuse the previous frame, re-trace one in n x n pixels per frame (0 = off)
+    VV_DEPTH_CLEARED                            ///< hint: the OpenGL depth buffer holds no opaque geometry, skip reading it back
   };
 
   BOOST_STATIC_ASSERT( VV_CLIP_OBJ_LAST - VV_CLIP_OBJ0 == NUM_CLIP_OBJS );
@@ -199,7 +212,7 @@ protected:
                                                      max value: min(brickSize[d])/2-1 */
   bool  _showBricks;                            ///< true = show brick boundarys
   bool  _computeBrickSize;                      ///< true = calculate brick size
-  size_t   _texMemorySize;                      ///< size of texture memory
+  size_t   _texMemorySize;                      ///< size of texture memory [MB], 0 = unlimited
   bool  _fpsDisplay;                            ///< true = show frame rate, might be costly if e. g. glFinish is called
   bool  _gammaCorrection;                       ///< true = gamma correction on
   virvo::vec4f gamma_;                          ///< gamma correction value: 0=red, 1=green, 2=blue, 3=4th channel
@@ -223,6 +236,16 @@ protected:
   bool _preIntegration;                         ///< true = try to use pre-integrated rendering (planar 3d textures)
   int _depthPrecision;                          ///< number of bits in depth buffer for image based rendering
   virvo::vec2f depth_range_;
+  bool _singlePassSkipping;                     ///< true = rays walk all non-empty bricks in one pass, false = one pass per brick
+  bool _precomputedGradients;                   ///< true = trade memory for speed and look up gradients from a precomputed volume
+  int  _skipTechnique;                          ///< empty space leaping technique (virvo::SkipTree::Technique)
+  int  _progressive;                            ///< interleaved sub-sampling factor per axis for progressive refinement, 0 = off
+  bool _brickedTextures;                        ///< true = CPU volume textures are stored in 8^3 bricks instead of linearly
+  int  _tfSize;                                 ///< transfer function table size, 0 = automatic
+  bool _lod;                                    ///< true = build a mip pyramid of the volume and pick levels by footprint
+  int  _lodMotion;                              ///< level bias while the camera moves
+  int  _reprojection;                           ///< refresh stride per axis for temporal reprojection, 0 = off
+  bool _depthCleared;                           ///< true = the depth buffer only holds its clear value
 
   boost::shared_ptr<vvClipObj> _clipObjs[NUM_CLIP_OBJS];
   int _focusClipObj;                            ///< clip object that is currently manipulated
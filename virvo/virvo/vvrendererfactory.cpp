@@ -150,6 +150,21 @@ static void get_cpuid(int reg[4], int type)
   __cpuidex(reg, type, 0);
 }
 
+static unsigned long long get_xcr0()
+{
+#if VV_CXX_MSVC
+  return _xgetbv(0);
+#else
+  unsigned eax = 0;
+  unsigned edx = 0;
+  __asm__ __volatile__
+  (
+    ".byte 0x0f, 0x01, 0xd0": "=a" (eax), "=d" (edx) : "c" (0) // xgetbv
+  );
+  return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
 #elif VV_ARCH == VV_ARCH_ARM
 // TODO
 #elif VV_ARCH == VV_ARCH_ARM64
@@ -170,6 +185,17 @@ static void get_cpuid(int reg[4], int type)
   );
 }
 
+static unsigned long long get_xcr0()
+{
+  unsigned eax = 0;
+  unsigned edx = 0;
+  __asm__ __volatile__
+  (
+    ".byte 0x0f, 0x01, 0xd0": "=a" (eax), "=d" (edx) : "c" (0) // xgetbv
+  );
+  return (static_cast<unsigned long long>(edx) << 32) | eax;
+}
+
 #endif
 
 namespace {
@@ -203,6 +229,7 @@ void init()
   rendererAliasMap["12"] = "rayrendsse4_1";
   rendererAliasMap["13"] = "rayrendavx";
   rendererAliasMap["14"] = "rayrendavx2";
+  rendererAliasMap["15"] = "rayrendavx512";
   rendererAliasMap["20"] = "serbrick";
   rendererAliasMap["21"] = "parbrick";
   rendererAliasMap["30"] = "ibr";
@@ -233,6 +260,7 @@ void init()
   rendererTypeMap["rayrendsse4_1"] = vvRenderer::RAYREND;
   rendererTypeMap["rayrendavx"] = vvRenderer::RAYREND;
   rendererTypeMap["rayrendavx2"] = vvRenderer::RAYREND;
+  rendererTypeMap["rayrendavx512"] = vvRenderer::RAYREND;
   rendererTypeMap["volpack"] = vvRenderer::VOLPACK;
   rendererTypeMap["image"] = vvRenderer::REMOTE_IMAGE;
   rendererTypeMap["ibr"] = vvRenderer::REMOTE_IBR;
@@ -246,6 +274,7 @@ void init()
   rayRendArchs.push_back("sse4_1");
   rayRendArchs.push_back("avx");
   rayRendArchs.push_back("avx2");
+  rayRendArchs.push_back("avx512");
 }
 
 static bool test_bit(int value, int bit)
@@ -280,10 +309,22 @@ static bool archSupported(std::string const& arch)
   get_cpuid(reg, 0);
   int nids = reg[EAX];
 
+  // The OS must save the AVX (ymm) and AVX-512 (opmask, zmm) register
+  // state on context switches, otherwise these instructions fault
+  bool os_avx = false;
+  bool os_avx512 = false;
+
   if (nids >= 1)
   {
     get_cpuid(reg, 1);
 
+    if (test_bit(reg[ECX], 27)) // OSXSAVE
+    {
+      unsigned long long xcr0 = get_xcr0();
+      os_avx = (xcr0 & 0x06) == 0x06;
+      os_avx512 = (xcr0 & 0xE6) == 0xE6;
+    }
+
     if (arch == "mmx")
       return test_bit(reg[EDX], 23);
     if (arch == "sse")
@@ -299,7 +340,7 @@ static bool archSupported(std::string const& arch)
     if (arch == "sse4_2")
       return test_bit(reg[ECX], 20);
     if (arch == "avx")
-      return test_bit(reg[ECX], 28);
+      return os_avx && test_bit(reg[ECX], 28);
   }
 
   if (nids >= 7)
@@ -307,9 +348,9 @@ static bool archSupported(std::string const& arch)
     get_cpuid(reg, 7);
 
     if (arch == "avx2")
-      return test_bit(reg[EBX], 5);
-    if (arch == "avx512f")
-      return test_bit(reg[EBX], 16);
+      return os_avx && test_bit(reg[EBX], 5);
+    if (arch == "avx512" || arch == "avx512f")
+      return os_avx512 && test_bit(reg[EBX], 16);
     if (arch == "avx512pf")
       return test_bit(reg[EBX], 26);
     if (arch == "avx512er")
@@ -342,15 +383,7 @@ std::string findRayRendPlugin(std::string const& plugindir, std::string const& a
 #else
   namestr << "librayrend";
 #endif
-  if (arch == "best")
-  {
-    // TODO: determine *best available*
-    namestr << "sse4_1";
-  }
-  else
-  {
-    namestr << arch;
-  }
+  namestr << arch;
 #define DO_EXPAND(VAL)  VAL ## 1
 #define EXPAND(VAL)     DO_EXPAND(VAL)
 
@@ -401,6 +434,23 @@ std::string findRayRendPlugin(std::string const& plugindir, std::string const& a
 }
 
 
+// Widest instruction set that is supported by the CPU and has a plugin
+std::string bestRayRendArch(std::string const& plugindir)
+{
+  static const char* archs[] = { "avx512", "avx2", "avx", "sse4_1", "sse2", "fpu" };
+
+  for (size_t i = 0; i < sizeof(archs) / sizeof(archs[0]); ++i)
+  {
+    if (archSupported(archs[i]) && !findRayRendPlugin(plugindir, archs[i]).empty())
+    {
+      return archs[i];
+    }
+  }
+
+  return std::string();
+}
+
+
 static bool hasRayRenderer(std::string const& arch)
 {
   const char* pluginEnv = "VV_PLUGIN_PATH";
@@ -417,6 +467,11 @@ static bool hasRayRenderer(std::string const& arch)
   }
 #endif
 
+  if (arch == "best")
+  {
+    return !bestRayRendArch(ppath).empty();
+  }
+
   if (!archSupported(arch))
   {
     return false;
@@ -444,7 +499,7 @@ struct ParsedOptions
   vvRendererFactory::Options options;
   std::string voxeltype;
   std::vector<vvTcpSocket*> sockets;
-  std::string arch; // fpu|sse2|sse4_1|avx|avx2|best (default)
+  std::string arch; // fpu|sse2|sse4_1|avx|avx2|avx512|best (default)
   std::vector<std::string> filenames;
   size_t bricks;
   std::vector<std::string> displays;
@@ -670,6 +725,13 @@ vvRenderer *create(vvVolDesc *vd, const vvRenderState &rs, const char *t, const
     char* pluginPath = getenv(pluginEnv);
     std::string ppath = pluginPath == NULL ? "." : pluginPath;
 
+    // pick the widest instruction set the CPU supports
+    if (arch.empty() || arch == "best")
+    {
+      arch = bestRayRendArch(ppath);
+      VV_LOG(1) << "Selected ray casting plugin for architecture " << arch;
+    }
+
     // if VV_PLUGIN_PATH not set, try "."
     std::string path = findRayRendPlugin(ppath, arch);
     if (!path.empty())
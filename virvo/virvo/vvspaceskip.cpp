@@ -21,6 +21,7 @@
 #include <cassert>
 
 #undef MATH_NAMESPACE
+#include "spaceskip/grid.h"
 #include "spaceskip/kdtree.h"
 #undef MATH_NAMESPACE
 
@@ -35,6 +36,8 @@ struct SkipTree::Impl
   SkipTree::Technique technique;
 
   KdTree kdtree;
+
+  MacrocellGrid grid;
 };
 
 SkipTree::SkipTree(SkipTree::Technique tech)
@@ -51,6 +54,8 @@ void SkipTree::updateVolume(const vvVolDesc& vd)
 {
   if (impl_->technique == SVTKdTree)
     impl_->kdtree.updateVolume(vd);
+  else if (impl_->technique == MacrocellGrid)
+    impl_->grid.updateVolume(vd);
 }
 
 void SkipTree::updateTransfunc(const uint8_t* data,
@@ -64,7 +69,7 @@ void SkipTree::updateTransfunc(const uint8_t* data,
   (void)numEntriesY; (void)numEntriesZ;
   assert(numEntriesY == 1 && numEntriesZ == 1); // Currently only 1D TF support
 
-  if (format == PF_RGBA32F)
+  if (format == PF_RGBA32F && impl_->technique == SVTKdTree)
   {
     texture_ref<visionaray::vec4, 1> transfunc(numEntriesX);
     transfunc.reset(reinterpret_cast<const visionaray::vec4*>(data));
@@ -73,18 +78,21 @@ void SkipTree::updateTransfunc(const uint8_t* data,
 
     impl_->kdtree.updateTransfunc(transfunc);
   }
+  else if (format == PF_RGBA32F && impl_->technique == MacrocellGrid)
+  {
+    impl_->grid.updateTransfunc(reinterpret_cast<const visionaray::vec4*>(data), numEntriesX);
+  }
 }
 
 std::vector<aabb> SkipTree::getSortedBricks(vec3 eye, bool frontToBack)
 {
   std::vector<aabb> result;
 
-  if (impl_->technique == SVTKdTree)
+  if (impl_->technique == SVTKdTree || impl_->technique == MacrocellGrid)
   {
-    auto leaves = impl_->kdtree.get_leaf_nodes(
-        visionaray::vec3(eye.x, eye.y, eye.z),
-        frontToBack
-        );
+    auto leaves = impl_->technique == SVTKdTree
+        ? impl_->kdtree.get_leaf_nodes(visionaray::vec3(eye.x, eye.y, eye.z), frontToBack)
+        : impl_->grid.get_leaf_nodes(visionaray::vec3(eye.x, eye.y, eye.z), frontToBack);
 
     result.resize(leaves.size());
 
@@ -100,9 +108,96 @@ std::vector<aabb> SkipTree::getSortedBricks(vec3 eye, bool frontToBack)
   return result;
 }
 
+std::vector<SkipTree::Node> SkipTree::getNodes() const
+{
+  std::vector<Node> result;
+
+  if (impl_->technique == SVTKdTree)
+  {
+    auto nodes = impl_->kdtree.get_flat_nodes();
+
+    result.resize(nodes.size());
+
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+      const auto& node = nodes[i];
+
+      result[i].bbox.min = virvo::vec3(node.bbox.min.x, node.bbox.min.y, node.bbox.min.z);
+      result[i].bbox.max = virvo::vec3(node.bbox.max.x, node.bbox.max.y, node.bbox.max.z);
+      result[i].axis = node.axis;
+      result[i].splitpos = node.splitpos;
+      result[i].children = node.children;
+    }
+  }
+
+  return result;
+}
+
+const float* SkipTree::getMacrocells(vec3i& numCells, vec3i& cellSize, int level) const
+{
+  if (impl_->technique != MacrocellGrid || impl_->grid.occupancy.empty())
+    return nullptr;
+
+  const auto& grid = impl_->grid;
+
+  if (level == 1)
+  {
+    numCells = vec3i(grid.num_coarse_cells.x, grid.num_coarse_cells.y, grid.num_coarse_cells.z);
+    cellSize = vec3i(grid.cellsize.x, grid.cellsize.y, grid.cellsize.z) * grid.coarse_factor;
+
+    return grid.coarse_occupancy.data();
+  }
+
+  numCells = vec3i(grid.num_cells.x, grid.num_cells.y, grid.num_cells.z);
+  cellSize = vec3i(grid.cellsize.x, grid.cellsize.y, grid.cellsize.z);
+
+  return grid.occupancy.data();
+}
+
+const float* SkipTree::getMacrocellColorBounds(vec3i& numCells, vec3i& cellSize, bool maximum) const
+{
+  if (impl_->technique != MacrocellGrid || impl_->grid.max_colors.empty())
+    return nullptr;
+
+  const auto& grid = impl_->grid;
+
+  numCells = vec3i(grid.num_cells.x, grid.num_cells.y, grid.num_cells.z);
+  cellSize = vec3i(grid.cellsize.x, grid.cellsize.y, grid.cellsize.z);
+
+  const auto& bounds = maximum ? grid.max_colors : grid.min_colors;
+  return reinterpret_cast<const float*>(bounds.data());
+}
+
+SkipTree::Technique SkipTree::getTechnique() const
+{
+  return impl_->technique;
+}
+
+SkipTree::BuildTiming SkipTree::getBuildTiming() const
+{
+  BuildTiming result = { 0.0, 0.0, 0.0 };
+
+  if (impl_->technique == SVTKdTree)
+  {
+    result.volume = impl_->kdtree.volume_time;
+    result.classify = impl_->kdtree.svt_time;
+    result.hierarchy = impl_->kdtree.splitting_time;
+  }
+  else if (impl_->technique == MacrocellGrid)
+  {
+    result.volume = impl_->grid.volume_time;
+    result.classify = impl_->grid.classify_time;
+  }
+
+  return result;
+}
+
 void SkipTree::renderGL(vvColor color)
 {
-  impl_->kdtree.renderGL(color);
+  if (impl_->technique == SVTKdTree)
+    impl_->kdtree.renderGL(color);
+  else if (impl_->technique == MacrocellGrid)
+    impl_->grid.renderGL(color);
 }
 
 } // namespace virvo
@@ -50,6 +50,11 @@ namespace virvo
        * "Rapid k-d Tree Construction for Sparse Volume Data"
        */
       SVTKdTree,
+
+      /** Uniform grid of min/max macrocells, reclassified against
+       * a new transfer function in O(#cells) time
+       */
+      MacrocellGrid,
     };
 
     VVAPI SkipTree(Technique tech);
@@ -67,6 +72,61 @@ namespace virvo
      */
     VVAPI std::vector<aabb> getSortedBricks(vec3 eye, bool frontToBack = true);
 
+    /** Node of the flattened k-d tree, see getNodes()
+     */
+    struct Node
+    {
+      aabb bbox;        ///< object space bounds
+      int axis;         ///< split axis, -1 for leaves
+      float splitpos;   ///< object space position of the split plane
+      int children;     ///< index of the child below the split plane, the child above it follows
+    };
+
+    /**
+     * @brief The k-d tree as a flat node array with the root first, only
+     *        available with the SVTKdTree technique
+     *
+     * Leaves are the bricks returned by getSortedBricks(). Visiting the
+     * child on the eye's side of the split plane first traverses the
+     * bricks in front-to-back order. Empty for other techniques.
+     */
+    VVAPI std::vector<Node> getNodes() const;
+
+    /**
+     * @brief Macrocell occupancy, only available with the MacrocellGrid technique
+     *
+     * One value per cell in voxel order (x runs fastest), 1 if the cell contains
+     * voxels that are visible with the current transfer function, otherwise 0.
+     * The cell edge length in voxels is returned in cellSize, cells on the upper
+     * volume boundaries may be clipped. Level 1 is a coarser grid whose cells
+     * each cover several cells of level 0. Returns nullptr for other techniques.
+     */
+    VVAPI const float* getMacrocells(vec3i& numCells, vec3i& cellSize, int level = 0) const;
+
+    /**
+     * @brief Per cell bounds of the classified color, only available with the
+     *        MacrocellGrid technique
+     *
+     * Four floats (premultiplied rgba) per cell in the same layout as returned
+     * by getMacrocells(). With maximum == true the component-wise maximum over
+     * all colors a voxel in the cell can be classified as, else the minimum.
+     * Used to cull cells in max. and min. intensity projection.
+     */
+    VVAPI const float* getMacrocellColorBounds(vec3i& numCells, vec3i& cellSize, bool maximum) const;
+
+    VVAPI Technique getTechnique() const;
+
+    /** Build times of the last updates [sec.]
+     */
+    struct BuildTiming
+    {
+      double volume;      ///< last updateVolume()
+      double classify;    ///< transfer function classification in the last updateTransfunc()
+      double hierarchy;   ///< hierarchy construction in the last updateTransfunc()
+    };
+
+    VVAPI BuildTiming getBuildTiming() const;
+
 
     /**
      * @brief Render with OpenGL (need an OpenGL context)
@@ -111,6 +111,17 @@ namespace virvo
 
     // Memory to hold the texture, in case we need it
     std::vector<uint8_t> mem;
+
+    // The frame the last texture was made from, held so that a texture
+    // pointing into the frame data stays valid if the frame cache evicts
+    // the frame before the next call
+    vvVolDesc::FramePointer frame;
+
+    const uint8_t* pinFrame(int f)
+    {
+      frame = vd->getFrame(f == -1 ? vd->getCurrentFrame() : static_cast<size_t>(f));
+      return frame.get();
+    }
   };
 
 
@@ -141,6 +152,19 @@ namespace virvo
       PixelFormat tf,
       TextureUtil::Channels chans,
       int frame)
+  {
+    return getTexture(first,
+        last,
+        impl_->pinFrame(frame),
+        tf,
+        chans);
+  }
+
+  TextureUtil::Pointer TextureUtil::getTexture(vec3i first,
+      vec3i last,
+      const uint8_t* raw,
+      PixelFormat tf,
+      TextureUtil::Channels chans)
   {
     PixelFormatInfo info = mapPixelFormat(tf);
 
@@ -164,7 +188,7 @@ namespace virvo
     // Maybe we can just return a pointer from the voldesc
     if (nativeFormat(vd) == tf && first.xy() == vec2i(0) && last.xy() == vec2i(vd->vox.xy()))
     {
-      return vd->getRaw(frame) + first.z * vd->getSliceBytes();
+      return raw + first.z * vd->getSliceBytes();
     }
 
     // Maybe the conversion operation is trivial and we can
@@ -174,7 +198,7 @@ namespace virvo
       // Reserve memory
       impl_->mem.resize(computeTextureSize(first, last, tf));
 
-      const uint8_t* raw = vd->getRaw(frame);
+      const uint8_t* src = raw;
       uint8_t* dst = &impl_->mem[0];
 
       for (int z = first.z; z < last.z; ++z)
@@ -183,8 +207,8 @@ namespace virvo
         {
           for (int x = first.x; x < last.x; ++x)
           {
-            memcpy(dst, raw, vd->getBPV());
-            raw += vd->getBPV();
+            memcpy(dst, src, vd->getBPV());
+            src += vd->getBPV();
             dst += vd->getBPV();
           }
         }
@@ -200,7 +224,7 @@ namespace virvo
       // Reserve memory
       impl_->mem.resize(computeTextureSize(first, last, tf));
 
-      const uint8_t* raw = vd->getRaw(frame);
+      const uint8_t* src = raw;
       uint8_t* dst = &impl_->mem[0];
 
       for (int z = first.z; z < last.z; ++z)
@@ -213,10 +237,10 @@ namespace virvo
             {
               if ((chans >> c) & 1)
               {
-                *dst++ = static_cast<uint8_t>(vd->rescaleVoxel(raw, 1/*byte*/, c));
+                *dst++ = static_cast<uint8_t>(vd->rescaleVoxel(src, 1/*byte*/, c));
               }
 
-              raw += vd->bpc;
+              src += vd->bpc;
             }
           }
         }
@@ -247,7 +271,7 @@ namespace virvo
       // Reserve memory
       impl_->mem.resize(computeTextureSize(first, last, PF_RGBA8));
 
-      const uint8_t* raw = vd->getRaw(frame);
+      const uint8_t* raw = impl_->pinFrame(frame);
       uint8_t* dst = &impl_->mem[0];
 
       for (int z = first.z; z < last.z; ++z)
@@ -281,7 +305,7 @@ namespace virvo
       // Reserve memory
       impl_->mem.resize(computeTextureSize(first, last, PF_RGBA8));
 
-      const uint8_t* raw = vd->getRaw(frame);
+      const uint8_t* raw = impl_->pinFrame(frame);
       uint8_t* dst = &impl_->mem[0];
 
       for (int z = first.z; z != last.z; ++z)
@@ -56,7 +56,7 @@ namespace virvo
           RGB=7, RGA=11, RBA=13, GBA=14,
           RGBA=15 };
 
-      /// Return type for getTexture() functions
+      /// Return type for getTexture() functions, valid until the next call
       typedef const uint8_t* Pointer;
 
 
@@ -107,6 +107,27 @@ namespace virvo
           Channels chans = All,
           int frame = 0);
 
+      /**
+       * @brief @see getTexture(), overload that converts the frame data
+       *        pointed to by raw instead of looking the frame up in the
+       *        volume description. The volume description is only read
+       *        from, so this can be used on threads other than the one
+       *        that owns the volume description
+       *
+       * @return output
+       * @param first 3-D index of first voxel
+       * @param last 3-D index of last voxel
+       * @param raw frame data as returned by vvVolDesc::getFrame(), the
+       *        caller must hold the frame while the texture is in use
+       * @param tf texel format of the output texture
+       * @param chans bitfield with channels to copy: default=all
+       */
+      Pointer getTexture(vec3i first,
+          vec3i last,
+          const uint8_t* raw,
+          PixelFormat tf,
+          Channels chans = All);
+
       /**
        * @brief @see getTexture(), overload to obtain only a section
        *        of the texture specified by the *right-open* interval
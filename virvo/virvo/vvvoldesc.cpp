@@ -32,6 +32,17 @@
 #include <limits>
 #include <numeric>
 #include <sstream>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/make_shared.hpp>
 
 #ifdef VV_DEBUG_MEMORY
 #include <crtdbg.h>
@@ -44,10 +55,12 @@
 
 #include "vvplatform.h"
 #include "vvdebugmsg.h"
+#include "vvframeprovider.h"
 #include "vvtoolshed.h"
 #include "vvclock.h"
 #include "vvvecmath.h"
 #include "vvvoldesc.h"
+#include "vvvolumeview.h"
 #include "mem/swap.h"
 
 #ifdef __sun
@@ -61,6 +74,844 @@ using namespace virvo;
 const size_t vvVolDesc::DEFAULT_ICON_SIZE = 64;
 const size_t vvVolDesc::NUM_HDR_BINS = vvTransFunc::NUM_HDR_BINS;
 
+//============================================================================
+// Class vvVolDesc::FrameCache
+//============================================================================
+
+/** Bounded LRU working set of frames delivered by a vvFrameProvider.
+  Frames following the current one are loaded ahead of time on a
+  background thread. The most recently requested frame is never evicted,
+  so the pointer returned by vvVolDesc::getRaw() stays valid until another
+  frame is requested.
+*/
+class vvVolDesc::FrameCache
+{
+  public:
+    FrameCache(boost::shared_ptr<vvFrameProvider> provider, size_t numFrames, size_t capacity, size_t prefetch)
+      : provider(provider)
+      , numFrames(numFrames)
+      , capacity(std::max(capacity, size_t(1)))
+      , prefetchFrames(std::min(prefetch, this->capacity - 1))
+      , lastUsed(numFrames)
+      , loading(numFrames)
+      , quit(false)
+    {
+      worker = std::thread(&FrameCache::run, this);
+    }
+
+    ~FrameCache()
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        quit = true;
+      }
+      cond.notify_all();
+      worker.join();
+    }
+
+    /// Returns a frame, loads it synchronously if it is not resident
+    FramePointer get(size_t frame)
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      lastUsed = frame;
+
+      // Wait if the frame is just being prefetched
+      cond.wait(lock, [&]() { return loading != frame; });
+
+      EntryMap::iterator it = entries.find(frame);
+      if (it != entries.end())
+      {
+        lru.splice(lru.begin(), lru, it->second.lru);
+        return it->second.data;
+      }
+
+      lock.unlock();
+      FramePointer data = provider->loadFrame(frame);
+      lock.lock();
+      insert(frame, data);
+      return data;
+    }
+
+    /// Schedules the frames following frame for loading, drops stale requests
+    void prefetch(size_t frame)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        queue.clear();
+        for (size_t i=1; i<=prefetchFrames && i<numFrames; ++i)
+        {
+          size_t f = (frame + i) % numFrames;     // animations loop
+          if (entries.find(f) == entries.end() && f != loading)
+            queue.push_back(f);
+        }
+      }
+      cond.notify_all();
+    }
+
+    bool isResident(size_t frame) const
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      return entries.find(frame) != entries.end();
+    }
+
+    boost::shared_ptr<vvFrameProvider> getProvider() const
+    {
+      return provider;
+    }
+
+  private:
+    typedef std::list<size_t> LRUList;            ///< frame indices, most recently used first
+    struct Entry
+    {
+      FramePointer data;
+      LRUList::iterator lru;
+    };
+    typedef std::map<size_t, Entry> EntryMap;
+
+    boost::shared_ptr<vvFrameProvider> provider;
+    size_t numFrames;
+    size_t capacity;                              ///< max. number of resident frames
+    size_t prefetchFrames;                        ///< number of frames to load ahead
+    size_t lastUsed;                              ///< most recently requested frame, never evicted
+    size_t loading;                               ///< frame currently being prefetched, numFrames if none
+    bool quit;
+
+    EntryMap entries;
+    LRUList lru;
+    std::deque<size_t> queue;                     ///< pending prefetch requests
+
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+    std::thread worker;
+
+    /// Adds a frame to the working set and evicts the least recently used ones, mutex must be locked
+    void insert(size_t frame, FramePointer const& data)
+    {
+      if (!data || entries.find(frame) != entries.end()) return;
+
+      lru.push_front(frame);
+      Entry entry = { data, lru.begin() };
+      entries[frame] = entry;
+
+      LRUList::iterator it = lru.end();
+      while (entries.size() > capacity && it != lru.begin())
+      {
+        --it;
+        if (*it == lastUsed) continue;
+        entries.erase(*it);
+        it = lru.erase(it);
+      }
+    }
+
+    /// Prefetch thread
+    void run()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      for (;;)
+      {
+        cond.wait(lock, [&]() { return quit || !queue.empty(); });
+        if (quit) return;
+
+        size_t frame = queue.front();
+        queue.pop_front();
+        if (entries.find(frame) != entries.end() || frame == loading) continue;
+
+        loading = frame;
+        lock.unlock();
+        FramePointer data = provider->loadFrame(frame);
+        lock.lock();
+        loading = numFrames;
+        insert(frame, data);
+        cond.notify_all();
+      }
+    }
+};
+
+//============================================================================
+// Typed voxel kernels
+//============================================================================
+
+// The bulk operations of vvVolDesc dispatch on the voxel data type once per
+// frame instead of switching per voxel, so the inner loops below are plain
+// typed loops the compiler can vectorize. Independent slices, lines or
+// voxels are distributed over threads with OpenMP where it is enabled; the
+// pragmas only use OpenMP 2.0 constructs.
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Data type conversion, see vvVolDesc::convertBPC()
+
+template <typename T>
+inline void convertValue(T s, T& d, float, float)                 { d = s; }
+inline void convertValue(uint8_t s, uint16_t& d, float, float)    { d = uint16_t(s << 8); }
+inline void convertValue(uint8_t s, float& d, float, float)       { d = s / 255.0f; }
+inline void convertValue(uint16_t s, uint8_t& d, float, float)    { d = uint8_t(s >> 8); }
+inline void convertValue(uint16_t s, float& d, float, float)      { d = s / 65535.0f; }
+inline void convertValue(float s, uint8_t& d, float lo, float hi)
+{
+  d = uint8_t((ts_clamp(s, lo, hi) - lo) / (hi - lo) * 255.0f);
+}
+inline void convertValue(float s, uint16_t& d, float lo, float hi)
+{
+  d = uint16_t((ts_clamp(s, lo, hi) - lo) / (hi - lo) * 65535.0f);
+}
+
+template <typename Src, typename Dst>
+void convertVoxels(const uint8_t* src, uint8_t* dst, ssize_t voxels, int chan, const vec2* range)
+{
+  const Src* s = reinterpret_cast<const Src*>(src);
+  Dst* d = reinterpret_cast<Dst*>(dst);
+  for (int c=0; c<chan; ++c)
+  {
+    const float lo = range[c][0];
+    const float hi = range[c][1];
+    #pragma omp parallel for
+    for (ssize_t i=0; i<voxels; ++i)
+      convertValue(s[i * chan + c], d[i * chan + c], lo, hi);
+  }
+}
+
+template <typename Src>
+void convertVoxels(const uint8_t* src, uint8_t* dst, size_t newBPC, ssize_t voxels, int chan, const vec2* range)
+{
+  switch (newBPC)
+  {
+    case 1: convertVoxels<Src, uint8_t>(src, dst, voxels, chan, range); break;
+    case 2: convertVoxels<Src, uint16_t>(src, dst, voxels, chan, range); break;
+    case 4: convertVoxels<Src, float>(src, dst, voxels, chan, range); break;
+    default: assert(0); break;
+  }
+}
+
+//----------------------------------------------------------------------------
+// Bit shifts, see vvVolDesc::bitShiftData()
+
+template <typename T>
+void shiftValues(uint8_t* data, ssize_t n, int bits)
+{
+  T* d = reinterpret_cast<T*>(data);
+  const int shift = ts_max(bits, -bits);
+  if (bits > 0)
+  {
+    #pragma omp parallel for
+    for (ssize_t i=0; i<n; ++i)
+      d[i] = T(static_cast<unsigned long>(d[i]) >> shift);
+  }
+  else
+  {
+    #pragma omp parallel for
+    for (ssize_t i=0; i<n; ++i)
+      d[i] = T(static_cast<unsigned long>(d[i]) << shift);
+  }
+}
+
+//----------------------------------------------------------------------------
+// Byte swapping, see vvVolDesc::toggleEndianness()
+
+template <typename T>
+void swapValues(uint8_t* data, ssize_t n)
+{
+  T* d = reinterpret_cast<T*>(data);
+  #pragma omp parallel for
+  for (ssize_t i=0; i<n; ++i)
+    d[i] = byte_swap<little_endian, big_endian, T>(d[i]);
+}
+
+//----------------------------------------------------------------------------
+// Voxel copies, V is an unsigned integer type with the size of one voxel
+
+/// Reverses the order of the voxels in each of numLines lines
+template <typename V>
+void reverseLines(uint8_t* data, ssize_t numLines, ssize_t width)
+{
+  V* d = reinterpret_cast<V*>(data);
+  #pragma omp parallel for
+  for (ssize_t l=0; l<numLines; ++l)
+    std::reverse(d + l * width, d + (l + 1) * width);
+}
+
+/** Copies voxels from src to dst. Source voxels are visited in order, the
+  destination index of source voxel (i, j, k) is i*di + j*dj + k*dk + d0.
+*/
+template <typename V>
+void permuteVoxels(const uint8_t* src, uint8_t* dst, ssize_t ni, ssize_t nj, ssize_t nk,
+    ssize_t di, ssize_t dj, ssize_t dk, ssize_t d0)
+{
+  const V* s = reinterpret_cast<const V*>(src);
+  V* d = reinterpret_cast<V*>(dst);
+  #pragma omp parallel for
+  for (ssize_t i=0; i<ni; ++i)
+  {
+    const V* sp = s + i * nj * nk;
+    for (ssize_t j=0; j<nj; ++j)
+    {
+      V* dp = d + d0 + i * di + j * dj;
+      for (ssize_t k=0; k<nk; ++k)
+        dp[k * dk] = *sp++;
+    }
+  }
+}
+
+/// Generic version of permuteVoxels() for arbitrary voxel sizes
+inline void permuteVoxels(const uint8_t* src, uint8_t* dst, size_t bpv, ssize_t ni, ssize_t nj, ssize_t nk,
+    ssize_t di, ssize_t dj, ssize_t dk, ssize_t d0)
+{
+  switch (bpv)
+  {
+    case 1: permuteVoxels<uint8_t>(src, dst, ni, nj, nk, di, dj, dk, d0); return;
+    case 2: permuteVoxels<uint16_t>(src, dst, ni, nj, nk, di, dj, dk, d0); return;
+    case 4: permuteVoxels<uint32_t>(src, dst, ni, nj, nk, di, dj, dk, d0); return;
+    case 8: permuteVoxels<uint64_t>(src, dst, ni, nj, nk, di, dj, dk, d0); return;
+    default: break;
+  }
+  #pragma omp parallel for
+  for (ssize_t i=0; i<ni; ++i)
+  {
+    const uint8_t* sp = src + i * nj * nk * bpv;
+    for (ssize_t j=0; j<nj; ++j)
+      for (ssize_t k=0; k<nk; ++k)
+      {
+        memcpy(dst + (d0 + i * di + j * dj + k * dk) * bpv, sp, bpv);
+        sp += bpv;
+      }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Trilinear interpolation, see vvVolDesc::trilinearInterpolation()
+
+/// Converts an interpolated value back to the voxel type, integer types are truncated
+template <typename T>
+inline T fromInterpolated(float v) { return T(v); }
+
+/// Interpolates all channels of the voxel at (x,y,z), which must be inside the volume
+template <typename T>
+inline void interpolateVoxel(const T* data, virvo::vector< 3, ssize_t > const& vox, int chan,
+    float x, float y, float z, T* result)
+{
+  const float pos[3] = { x, y, z };
+  ssize_t tfl[3];                                 // coordinates of neighbor 0 (top-front-left)
+  float dist[3];                                  // distance to neighbor 0
+  ssize_t step[3];                                // offsets to the next neighbor along each axis
+  const ssize_t stride[3] = { chan, vox[0] * chan, vox[0] * vox[1] * chan };
+  for (int i=0; i<3; ++i)
+  {
+    tfl[i] = (ssize_t)pos[i];
+    dist[i] = pos[i] - (float)tfl[i];
+    step[i] = stride[i];
+    if (vox[i] < 2)                               // flat axis: no neighbor
+    {
+      tfl[i] = 0;
+      dist[i] = 0.0f;
+      step[i] = 0;
+    }
+    else if (tfl[i] >= vox[i]-1)                  // border values need special treatment
+    {
+      tfl[i] = vox[i]-2;
+      dist[i] = 1.0f;
+    }
+  }
+
+  const T* n0 = data + tfl[0] * stride[0] + tfl[1] * stride[1] + tfl[2] * stride[2];
+  for (int c=0; c<chan; ++c)
+  {
+    const T* n = n0 + c;
+    float v00 = float(n[0])                  * (1.0f - dist[0]) + float(n[step[0]])                  * dist[0];
+    float v10 = float(n[step[1]])            * (1.0f - dist[0]) + float(n[step[1] + step[0]])        * dist[0];
+    float v01 = float(n[step[2]])            * (1.0f - dist[0]) + float(n[step[2] + step[0]])        * dist[0];
+    float v11 = float(n[step[2] + step[1]])  * (1.0f - dist[0]) + float(n[step[2] + step[1] + step[0]]) * dist[0];
+    float v0 = v00 * (1.0f - dist[1]) + v10 * dist[1];
+    float v1 = v01 * (1.0f - dist[1]) + v11 * dist[1];
+    result[c] = fromInterpolated<T>(v0 * (1.0f - dist[2]) + v1 * dist[2]);
+  }
+}
+
+template <typename T>
+void resampleTrilinear(const uint8_t* src, virvo::vector< 3, ssize_t > const& vox, int chan,
+    uint8_t* dst, ssize_t w, ssize_t h, ssize_t s)
+{
+  const T* sd = reinterpret_cast<const T*>(src);
+  T* dd = reinterpret_cast<T*>(dst);
+  const float sx = w>1 ? float(vox[0]-1) / float(w-1) : 0.0f;
+  const float sy = h>1 ? float(vox[1]-1) / float(h-1) : 0.0f;
+  const float sz = s>1 ? float(vox[2]-1) / float(s-1) : 0.0f;
+  #pragma omp parallel for
+  for (ssize_t z=0; z<s; ++z)
+  {
+    T* dp = dd + z * w * h * chan;
+    for (ssize_t y=0; y<h; ++y)
+      for (ssize_t x=0; x<w; ++x)
+      {
+        interpolateVoxel(sd, vox, chan, x * sx, y * sy, z * sz, dp);
+        dp += chan;
+      }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Reductions, see vvVolDesc::findMinMax() and vvVolDesc::makeHistogram()
+
+template <typename T>
+void findMinMaxValues(VolumeView<T> const& view, int channel, T& minVal, T& maxVal)
+{
+  const T* d = view.data() + channel;
+  const int chan = view.channels();
+  const ssize_t voxels = view.voxels();
+  #pragma omp parallel
+  {
+    T localMin = minVal;
+    T localMax = maxVal;
+    #pragma omp for
+    for (ssize_t i=0; i<voxels; ++i)
+    {
+      T v = d[i * chan];
+      localMin = v < localMin ? v : localMin;
+      localMax = v > localMax ? v : localMax;
+    }
+    #pragma omp critical
+    {
+      if (localMin < minVal) minVal = localMin;
+      if (localMax > maxVal) maxVal = localMax;
+    }
+  }
+}
+
+/// Histogram bucket index of a data value, see vvVolDesc::makeHistogram()
+inline int bucketOf(float voxVal, int buckets, float min, float max)
+{
+  int bucketIndex = (int)((voxVal - min) * (buckets / (max-min)));
+  return ts_clamp(bucketIndex, 0, buckets-1);
+}
+
+/** Maps voxel values of one channel to offsets into the histogram array.
+  Integer types use a lookup table over all possible values.
+*/
+template <typename T>
+class HistogramBins
+{
+  public:
+    HistogramBins(vec2 const& mapping, int buckets, int factor, float min, float max)
+      : table(size_t(std::numeric_limits<T>::max()) + 1)
+    {
+      for (size_t v=0; v<table.size(); ++v)
+      {
+        float voxVal = lerp(mapping[0], mapping[1], float(v) / std::numeric_limits<T>::max());
+        table[v] = bucketOf(voxVal, buckets, min, max) * factor;
+      }
+    }
+
+    int operator()(T v) const { return table[v]; }
+
+  private:
+    std::vector<int> table;
+};
+
+template <>
+class HistogramBins<float>
+{
+  public:
+    HistogramBins(vec2 const&, int buckets, int factor, float min, float max)
+      : buckets(buckets), factor(factor), min(min), max(max)
+    {
+    }
+
+    int operator()(float v) const { return bucketOf(v, buckets, min, max) * factor; }
+
+  private:
+    int buckets;
+    int factor;
+    float min;
+    float max;
+};
+
+template <typename T>
+void countHistogram(VolumeView<T> const& view, int chan1, int numChan,
+    const int* buckets, float min, float max, int* count, int totalBuckets)
+{
+  const T* d = view.data();
+  const int chan = view.channels();
+  const ssize_t voxels = view.voxels();
+
+  std::vector< HistogramBins<T> > bins;
+  int factor = 1;
+  for (int c=0; c<numChan; ++c)
+  {
+    bins.push_back(HistogramBins<T>(view.mapping(chan1 + c), buckets[c], factor, min, max));
+    factor *= buckets[c];
+  }
+
+  #pragma omp parallel
+  {
+    std::vector<int> localCount(totalBuckets, 0);
+    #pragma omp for
+    for (ssize_t i=0; i<voxels; ++i)
+    {
+      const T* v = d + i * chan + chan1;
+      int dstIndex = 0;
+      for (int c=0; c<numChan; ++c)
+        dstIndex += bins[c](v[c]);
+      ++localCount[dstIndex];
+    }
+    #pragma omp critical
+    for (int b=0; b<totalBuckets; ++b)
+      count[b] += localCount[b];
+  }
+}
+
+struct CountHistogram
+{
+  CountHistogram(int chan1, int numChan, const int* buckets, float min, float max, int* count, int totalBuckets)
+    : chan1(chan1), numChan(numChan), buckets(buckets), min(min), max(max), count(count), totalBuckets(totalBuckets)
+  {
+  }
+
+  template <typename T>
+  void operator()(VolumeView<T> const& view) const
+  {
+    countHistogram(view, chan1, numChan, buckets, min, max, count, totalBuckets);
+  }
+
+  int chan1;
+  int numChan;
+  const int* buckets;
+  float min;
+  float max;
+  int* count;
+  int totalBuckets;
+};
+
+//----------------------------------------------------------------------------
+// Statistics, see vvVolDesc::calculateDistribution(), vvVolDesc::voxelStatistics() etc.
+
+/// Integer values are compared after truncating the search value, see vvVolDesc::findNumValue()
+template <typename T>
+inline bool equalsValue(T v, float val) { return int(v) == int(val); }
+inline bool equalsValue(float v, float val) { return v == val; }
+
+/// Voxel value scaled to 0..1 for integer data types, see vvVolDesc::addGradient()
+inline float normalizedValue(uint8_t v)   { return v / 255.0f; }
+inline float normalizedValue(uint16_t v)  { return v / 65535.0f; }
+inline float normalizedValue(float v)     { return v; }
+
+/// Inverse of normalizedValue(), without clamping
+inline void storeNormalized(float v, uint8_t& d)  { d = uint8_t(int(v * 255.0f)); }
+inline void storeNormalized(float v, uint16_t& d) { d = uint16_t(int(v * 65535.0f)); }
+inline void storeNormalized(float v, float& d)    { d = v; }
+
+/// Gradient vector component in -1..1, stored with an offset for integer data types
+inline void storeSigned(float v, uint8_t& d)  { d = uint8_t(ts_clamp(int((v + 1.0f) * 127.5f), 0, 255)); }
+inline void storeSigned(float v, uint16_t& d) { d = uint16_t(ts_clamp(int((v + 1.0f) * 32767.5f), 0, 65535)); }
+inline void storeSigned(float v, float& d)    { d = v; }
+
+template <typename T>
+double sumValues(VolumeView<T> const& view, int c)
+{
+  const T* d = view.data() + c;
+  const int chan = view.channels();
+  const ssize_t voxels = view.voxels();
+  double sum = 0.0;
+  #pragma omp parallel for reduction(+:sum)
+  for (ssize_t i=0; i<voxels; ++i)
+    sum += d[i * chan];
+  return sum;
+}
+
+template <typename T>
+double sumSquaredDeviations(VolumeView<T> const& view, int c, float mean)
+{
+  const T* d = view.data() + c;
+  const int chan = view.channels();
+  const ssize_t voxels = view.voxels();
+  double sumSquares = 0.0;
+  #pragma omp parallel for reduction(+:sumSquares)
+  for (ssize_t i=0; i<voxels; ++i)
+  {
+    float diff = float(d[i * chan]) - mean;
+    sumSquares += diff * diff;
+  }
+  return sumSquares;
+}
+
+/// Mean and, if requested, variance of channel c, see vvVolDesc::calculateDistribution()
+struct CalculateDistribution
+{
+  CalculateDistribution(int c, float& mean, float* variance)
+    : c(c), mean(mean), variance(variance)
+  {
+  }
+
+  template <typename T>
+  void operator()(VolumeView<T> const& view) const
+  {
+    mean = float(sumValues(view, c) / double(view.voxels()));
+    if (variance)
+      *variance = float(sumSquaredDeviations(view, c, mean) / double(view.voxels()));
+  }
+
+  int c;
+  float& mean;
+  float* variance;
+};
+
+/// Mean and variance of the 3x3x3 neighborhood of voxel (x,y,z) that lies inside the volume
+template <typename T>
+void neighborhoodStatistics(VolumeView<T> const& view, int c, ssize_t x, ssize_t y, ssize_t z, float& mean, float& variance)
+{
+  virvo::vector< 3, ssize_t > const& vox = view.vox();
+  ssize_t x0 = ts_max(x-1, ssize_t(0)), x1 = ts_min(x+1, vox[0]-1);
+  ssize_t y0 = ts_max(y-1, ssize_t(0)), y1 = ts_min(y+1, vox[1]-1);
+  ssize_t z0 = ts_max(z-1, ssize_t(0)), z1 = ts_min(z+1, vox[2]-1);
+  double num = double((x1-x0+1) * (y1-y0+1) * (z1-z0+1));
+
+  double sum = 0.0;
+  for (ssize_t zz=z0; zz<=z1; ++zz)
+    for (ssize_t yy=y0; yy<=y1; ++yy)
+      for (ssize_t xx=x0; xx<=x1; ++xx)
+        sum += view(xx, yy, zz, c);
+  mean = float(sum / num);
+
+  double sumSquares = 0.0;
+  for (ssize_t zz=z0; zz<=z1; ++zz)
+    for (ssize_t yy=y0; yy<=y1; ++yy)
+      for (ssize_t xx=x0; xx<=x1; ++xx)
+      {
+        float diff = float(view(xx, yy, zz, c)) - mean;
+        sumSquares += diff * diff;
+      }
+  variance = float(sumSquares / num);
+}
+
+struct VoxelStatistics
+{
+  VoxelStatistics(int c, ssize_t x, ssize_t y, ssize_t z, float& mean, float& variance)
+    : c(c), x(x), y(y), z(z), mean(mean), variance(variance)
+  {
+  }
+
+  template <typename T>
+  void operator()(VolumeView<T> const& view) const
+  {
+    neighborhoodStatistics(view, c, x, y, z, mean, variance);
+  }
+
+  int c;
+  ssize_t x, y, z;
+  float& mean;
+  float& variance;
+};
+
+/// Stores the neighborhood variance of channel src in channel dst, see vvVolDesc::addVariance()
+struct AddVariance
+{
+  AddVariance(int src, int dst) : src(src), dst(dst) {}
+
+  template <typename T>
+  void operator()(VolumeView<T> const& view) const
+  {
+    virvo::vector< 3, ssize_t > const& vox = view.vox();
+    #pragma omp parallel for
+    for (ssize_t z=0; z<vox[2]; ++z)
+      for (ssize_t y=0; y<vox[1]; ++y)
+        for (ssize_t x=0; x<vox[0]; ++x)
+        {
+          float mean, variance;
+          neighborhoodStatistics(view, src, x, y, z, mean, variance);
+          storeNormalized(variance, view(x, y, z, dst));
+        }
+  }
+
+  int src;
+  int dst;
+};
+
+/// Stores central difference gradients of channel src in channel(s) dst, see vvVolDesc::addGradient()
+struct AddGradient
+{
+  AddGradient(int src, int dst, bool magnitude, float& minMagnitude, float& maxMagnitude)
+    : src(src), dst(dst), magnitude(magnitude), minMagnitude(minMagnitude), maxMagnitude(maxMagnitude)
+  {
+  }
+
+  template <typename T>
+  void operator()(VolumeView<T> const& view) const
+  {
+    const float SQRT3 = float(sqrt(3.0));
+    virvo::vector< 3, ssize_t > const& vox = view.vox();
+    const ptrdiff_t chan = view.channels();
+    const ptrdiff_t lineValues = chan * vox[0];
+    const ptrdiff_t sliceValues = lineValues * vox[1];
+
+    #pragma omp parallel
+    {
+      float localMin = minMagnitude;
+      float localMax = maxMagnitude;
+      #pragma omp for
+      for (ssize_t z=1; z<vox[2]-1; ++z)
+      {
+        for (ssize_t y=1; y<vox[1]-1; ++y)
+        {
+          const T* s = &view(1, y, z, src);
+          T* d = &view(1, y, z, dst);
+          for (ssize_t x=1; x<vox[0]-1; ++x)
+          {
+            float diff[3] = {
+              normalizedValue(s[chan])        - normalizedValue(s[-chan]),
+              normalizedValue(s[lineValues])  - normalizedValue(s[-lineValues]),
+              normalizedValue(s[sliceValues]) - normalizedValue(s[-sliceValues])
+            };
+
+            if (magnitude)
+            {
+              // reduce value to range 0..1
+              float grad = sqrtf(diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2]) / SQRT3;
+              grad = ts_clamp(grad, 0.0f, 1.0f);
+              storeNormalized(grad, *d);
+              localMin = ts_min(grad, localMin);
+              localMax = ts_max(grad, localMax);
+            }
+            else
+            {
+              for (int i=0; i<3; ++i)
+                storeSigned(diff[i], d[i]);
+            }
+            s += chan;
+            d += chan;
+          }
+        }
+      }
+      #pragma omp critical
+      {
+        minMagnitude = ts_min(localMin, minMagnitude);
+        maxMagnitude = ts_max(localMax, maxMagnitude);
+      }
+    }
+  }
+
+  int src;
+  int dst;
+  bool magnitude;
+  float& minMagnitude;
+  float& maxMagnitude;
+};
+
+/// Number of voxels whose channels all equal val, see vvVolDesc::findNumValue()
+struct CountValue
+{
+  CountValue(float val, int& num) : val(val), num(num) {}
+
+  template <typename T>
+  void operator()(VolumeView<T> const& view) const
+  {
+    const ssize_t voxels = view.voxels();
+    const int chan = view.channels();
+    int n = 0;
+    #pragma omp parallel for reduction(+:n)
+    for (ssize_t i=0; i<voxels; ++i)
+    {
+      bool allEqual = true;
+      for (int c=0; c<chan; ++c)
+        allEqual &= equalsValue(view(i, c), val);
+      if (allEqual) ++n;
+    }
+    num = n;
+  }
+
+  float val;
+  int& num;
+};
+
+/// Marks the values of an integer channel that occur in the data, see vvVolDesc::findNumUsed()
+struct MarkUsedValues
+{
+  MarkUsedValues(int c, std::vector<uint8_t>& used) : c(c), used(used) {}
+
+  template <typename T>
+  void operator()(VolumeView<T> const& view) const
+  {
+    for (typename VolumeView<T>::ChannelIterator it = view.begin(c); it != view.end(c); ++it)
+      used[size_t(*it)] = 1;
+  }
+
+  int c;
+  std::vector<uint8_t>& used;
+};
+
+/// Number of voxels classified as transparent, see vvVolDesc::findNumTransparent()
+struct CountTransparent
+{
+  CountTransparent(const float* rgba, int& num) : rgba(rgba), num(num) {}
+
+  template <typename T>
+  void operator()(VolumeView<T> const& view) const
+  {
+    int n = 0;
+    for (typename VolumeView<T>::ChannelIterator it = view.begin(0); it != view.end(0); ++it)
+    {
+      size_t scalar = size_t(*it);
+      if (rgba ? rgba[scalar * 4 + 3] == 0.0f : scalar == 0)
+        ++n;
+    }
+    num = n;
+  }
+
+  const float* rgba;
+  int& num;
+};
+
+/// Stored values of all channels of the given voxels, see vvVolDesc::getLineHistData()
+struct GatherVoxels
+{
+  GatherVoxels(std::vector<size_t> const& indices, std::vector< std::vector< float > >& result)
+    : indices(indices), result(result)
+  {
+  }
+
+  template <typename T>
+  void operator()(VolumeView<T> const& view) const
+  {
+    result.resize(indices.size());
+    for (size_t i=0; i<indices.size(); ++i)
+    {
+      result[i].resize(view.channels());
+      for (int c=0; c<view.channels(); ++c)
+        result[i][c] = float(view(indices[i], c));
+    }
+  }
+
+  std::vector<size_t> const& indices;
+  std::vector< std::vector< float > >& result;
+};
+
+/// Clears channel c of the voxels where the mask is zero, see vvVolDesc::applyMask()
+struct ApplyMask
+{
+  ApplyMask(uint8_t* data, size_t bpv, size_t offset, size_t bpc)
+    : data(data), bpv(bpv), offset(offset), bpc(bpc)
+  {
+  }
+
+  template <typename T>
+  void operator()(VolumeView<T> const& mask) const
+  {
+    const ssize_t voxels = mask.voxels();
+    #pragma omp parallel for
+    for (ssize_t i=0; i<voxels; ++i)
+    {
+      if (mask.value(i) == 0.0f)
+        memset(data + bpv * i + offset, 0, bpc);
+    }
+  }
+
+  uint8_t* data;
+  size_t bpv;
+  size_t offset;
+  size_t bpc;
+};
+
+} // namespace
+
 //============================================================================
 // Class vvVolDesc
 //============================================================================
@@ -404,8 +1255,9 @@ void vvVolDesc::removeSequence()
 {
   vvDebugMsg::msg(2, "vvVolDesc::removeSequence()");
   frames = 0;
-  if (raw.isEmpty()) return;
-  raw.removeAll();
+  frameCache.reset();
+  if (raw.empty()) return;
+  raw.clear();
   deleteChannelNames();
 }
 
@@ -517,6 +1369,7 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
 
   vvDebugMsg::msg(2, "vvVolDesc::merge()");
   if (src->frames==0) return OK;                  // is source src empty?
+  src->makeResident();
                                                   // are data types the same?
   if ((bpc != src->bpc) && frames != 0) return TYPE_ERROR;
 
@@ -531,7 +1384,8 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
     bpc    = src->bpc;
     chan   = src->chan;
     dt     = src->dt;
-    raw.merge(&src->raw);
+    raw.insert(raw.end(), src->raw.begin(), src->raw.end());
+    src->raw.clear();
     for (size_t i=0; i<3; ++i) dist[i] = src->dist[i];
     range_.resize(src->range_.size());
     std::copy(src->range_.begin(), src->range_.end(), range_.begin());
@@ -559,8 +1413,7 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
     {
       for (size_t f=0; f<frames; ++f)
       {
-        raw.makeCurrent(f);
-        rd = raw.getData();
+        rd = frameData(f);
         uint8_t* srcRD = src->getRaw(f);
         newRaw = new uint8_t[getFrameBytes() + src->getFrameBytes()];
         for (size_t i=0; i<getFrameVoxels(); ++i)
@@ -568,9 +1421,7 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
           memcpy(newRaw + i * bpc * (chan+src->chan), rd + i * getBPV(), getBPV());
           memcpy(newRaw + i * bpc * (chan+src->chan) + getBPV(), srcRD + i * src->getBPV(), src->getBPV());
         }
-        raw.remove();
-        if (f==0) raw.insertBefore(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
-        else raw.insertAfter(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
+        raw[f] = makeFrame(newRaw, ARRAY_DELETE);
       }
       for (int i=0; i<src->chan; ++i) setChannelName((chan+i), src->channelNames[i]);
       chan += src->chan;                          // update target channel number
@@ -590,8 +1441,9 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
       bpc==src->bpc && chan==src->chan)
     {
       // Append all volume time steps to target volume:
-      raw.merge(&src->raw);
-      frames = raw.count();
+      raw.insert(raw.end(), src->raw.begin(), src->raw.end());
+      src->raw.clear();
+      frames = raw.size();
 
       // Delete sequence information from src:
       src->bpc = src->chan = src->vox[0] = src->vox[1] = src->vox[2] = src->frames = src->currentFrame = 0;
@@ -612,15 +1464,12 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
       // Append all slices of each animation step to target volume:
       for (size_t f=0; f<frames; ++f)
       {
-        raw.makeCurrent(f);
-        rd = raw.getData();
+        rd = frameData(f);
         newRaw = new uint8_t[getFrameBytes() + src->getFrameBytes()];
         memcpy(newRaw, rd, getFrameBytes());      // copy current frame to new raw data array
                                                   // copy source frame to new raw data array
         memcpy(newRaw + getFrameBytes(), src->getRaw(f), src->getFrameBytes());
-        raw.remove();
-        if (f==0) raw.insertBefore(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
-        else raw.insertAfter(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
+        raw[f] = makeFrame(newRaw, ARRAY_DELETE);
       }
       vox[2] += src->vox[2];                      // update target slice number
       src->removeSequence();                      // delete copied frames from source
@@ -722,14 +1571,30 @@ uint8_t* vvVolDesc::getRaw(int frame) const
 
 //----------------------------------------------------------------------------
 /** Returns a pointer to the raw data of a specific frame.
+  If the frames are served by a frame cache, the pointer only stays valid
+  until another frame is requested, use getFrame() to hold on to a frame.
   @param frame  index of desired frame (0 for first frame) if frame does not
                 exist, NULL will be returned
 */
 uint8_t* vvVolDesc::getRaw(size_t frame) const
 {
-  if (frame>=frames) return NULL;     // frame does not exist
-  raw.makeCurrent(frame);
-  return raw.getData();
+  if (frame>=frames || frame>=raw.size()) return NULL;     // frame does not exist
+  if (!raw[frame] && frameCache) return frameCache->get(frame).get();
+  return raw[frame].get();
+}
+
+//----------------------------------------------------------------------------
+/** Returns a shared reference to the raw data of a specific frame.
+  The buffer stays valid as long as the returned pointer is held, even if
+  the frame is replaced or removed from the volume in the meantime.
+  @param frame  index of desired frame (0 for first frame) if frame does not
+                exist, an empty pointer will be returned
+*/
+vvVolDesc::FramePointer vvVolDesc::getFrame(size_t frame) const
+{
+  if (frame>=frames || frame>=raw.size()) return FramePointer();
+  if (!raw[frame] && frameCache) return frameCache->get(frame);
+  return raw[frame];
 }
 
 //----------------------------------------------------------------------------
@@ -755,14 +1620,100 @@ the back slice.
 */
 void vvVolDesc::addFrame(uint8_t* ptr, DeleteType deleteData,int fn)
 {
-  switch(deleteData)
+  raw.push_back(makeFrame(ptr, deleteData));
+  rawFrameNumber.push_back(fn);
+
+  // Make sure channel names exist:
+  if (channelNames.size() == 0)
   {
-    case NO_DELETE:     raw.append(ptr, vvSLNode<uint8_t*>::NO_DELETE); break;
-    case NORMAL_DELETE: raw.append(ptr, vvSLNode<uint8_t*>::NORMAL_DELETE); break;
-    case ARRAY_DELETE:  raw.append(ptr, vvSLNode<uint8_t*>::ARRAY_DELETE); break;
-    default: assert(0); break;
+    channelNames.resize(chan);
   }
-  rawFrameNumber.push_back(fn);
+}
+
+//----------------------------------------------------------------------------
+/** Adds a new frame that is backed by a memory mapped region of a file
+    instead of a heap copy. The region is mapped copy-on-write: pages
+    are shared with the OS page cache (and thus with other processes
+    mapping the same file) until an operation modifies them, at which
+    point the OS creates a private copy of the modified page only.
+    The file itself is never written to, and it must neither be modified
+    nor truncated while the frame is in use.
+    <BR>
+    The frames variable is not adjusted, this must be done separately.
+  @param fn       name of the file containing the voxel data
+  @param offset   byte offset of the frame in the file
+  @param fnum     frame number, see addFrame()
+  @return true if the frame was mapped, false if mapping is not possible
+          (e.g. file too short or misaligned data); the caller is expected
+          to fall back to reading the data in that case
+*/
+bool vvVolDesc::addMappedFrame(const char* fn, size_t offset, int fnum)
+{
+  namespace bip = boost::interprocess;
+
+  vvDebugMsg::msg(3, "vvVolDesc::addMappedFrame()");
+
+  size_t frameSize = getFrameBytes();
+  if (frameSize == 0 || (offset % bpc) != 0) return false;
+
+  boost::system::error_code ec;
+  boost::uintmax_t fileSize = boost::filesystem::file_size(fn, ec);
+  if (ec || fileSize < offset + frameSize) return false;
+
+  try
+  {
+    bip::file_mapping file(fn, bip::read_only);
+    boost::shared_ptr<bip::mapped_region> region = boost::make_shared<bip::mapped_region>(
+        file, bip::copy_on_write, static_cast<bip::offset_t>(offset), frameSize);
+
+    // The frame pointer shares ownership of the region, the mapping is
+    // released together with the last reference to the frame
+    raw.push_back(FramePointer(region, static_cast<uint8_t*>(region->get_address())));
+  }
+  catch (bip::interprocess_exception& e)
+  {
+    vvDebugMsg::msg(1, "Cannot map frame: ", e.what());
+    return false;
+  }
+  rawFrameNumber.push_back(fnum);
+
+  // Make sure channel names exist:
+  if (channelNames.size() == 0)
+  {
+    channelNames.resize(chan);
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/** Attaches a source for frames that are not kept in memory.
+    All frames of the current sequence which are not stored yet are from
+    now on requested from the provider on demand. At most cacheFrames of
+    them are kept resident (least recently used ones are evicted), and
+    setCurrentFrame() loads the next prefetchFrames frames ahead on a
+    background thread, so animations longer than physical memory can be
+    played back.
+    <BR>
+    The frames variable must already be set to the length of the sequence.
+    Operations modifying the volume data make the frames they modify
+    resident permanently. Changes made through pointers returned by
+    getRaw() are lost when the frame is evicted.
+  @param provider       frame source, NULL to make all frames resident and
+                        detach the current provider
+  @param cacheFrames    max. number of provided frames kept in memory
+  @param prefetchFrames number of frames to load ahead of the current one
+*/
+void vvVolDesc::setFrameProvider(boost::shared_ptr<vvFrameProvider> provider, size_t cacheFrames, size_t prefetchFrames)
+{
+  vvDebugMsg::msg(2, "vvVolDesc::setFrameProvider()");
+
+  makeResident();
+  if (!provider) return;
+
+  raw.resize(frames);
+  rawFrameNumber.resize(frames, -1);
+  frameCache = boost::make_shared<FrameCache>(provider, frames, cacheFrames, prefetchFrames);
+  frameCache->prefetch(currentFrame + frames - 1);  // load the working set starting at the current frame
 
   // Make sure channel names exist:
   if (channelNames.size() == 0)
@@ -771,11 +1722,47 @@ void vvVolDesc::addFrame(uint8_t* ptr, DeleteType deleteData,int fn)
   }
 }
 
+//----------------------------------------------------------------------------
+/// Returns the frame provider, NULL if all frames are resident.
+boost::shared_ptr<vvFrameProvider> vvVolDesc::getFrameProvider() const
+{
+  return frameCache ? frameCache->getProvider() : boost::shared_ptr<vvFrameProvider>();
+}
+
+//----------------------------------------------------------------------------
+/// Returns true if a frame can be accessed without loading it from the frame provider.
+bool vvVolDesc::isFrameResident(size_t frame) const
+{
+  if (frame>=raw.size()) return false;
+  return raw[frame] || (frameCache && frameCache->isResident(frame));
+}
+
+//----------------------------------------------------------------------------
+/** Returns the data of a frame for modification. Frames delivered by the
+  frame provider are stored permanently, so changes are not lost when the
+  frame would be evicted from the working set.
+*/
+uint8_t* vvVolDesc::frameData(size_t frame)
+{
+  if (!raw[frame] && frameCache) raw[frame] = frameCache->get(frame);
+  return raw[frame].get();
+}
+
+//----------------------------------------------------------------------------
+/// Loads all frames from the frame provider and detaches it.
+void vvVolDesc::makeResident()
+{
+  if (!frameCache) return;
+  for (size_t f=0; f<raw.size(); ++f)
+    frameData(f);
+  frameCache.reset();
+}
+
 //----------------------------------------------------------------------------
 /// Return the number of frames actually stored.
 size_t vvVolDesc::getStoredFrames() const
 {
-  return raw.count();
+  return raw.size();
 }
 
 //----------------------------------------------------------------------------
@@ -790,7 +1777,7 @@ void vvVolDesc::copyFrame(uint8_t* ptr)
   vvDebugMsg::msg(3, "vvVolDesc::copyFrame()");
   newData = new uint8_t[getFrameBytes()];
   memcpy(newData, ptr, getFrameBytes());
-  raw.append(newData, vvSLNode<uint8_t*>::ARRAY_DELETE);
+  raw.push_back(makeFrame(newData, ARRAY_DELETE));
 
   // Make sure channel names exist:
   if (channelNames.size() == 0)
@@ -809,15 +1796,25 @@ the same.
 void vvVolDesc::updateFrame(int frame, uint8_t* newData, DeleteType deleteData)
 {
   vvDebugMsg::msg(3, "vvVolDesc::updateFrame()");
-  raw.makeCurrent(frame);
-  raw.remove();
+  assert(frame >= 0 && size_t(frame) < raw.size());
+  raw[frame] = makeFrame(newData, deleteData);
+}
+
+//----------------------------------------------------------------------------
+/** Wraps a frame buffer into a reference counted frame pointer.
+  @param ptr          pointer to raw data
+  @param deleteData   how to release the buffer once the last reference is gone
+*/
+vvVolDesc::FramePointer vvVolDesc::makeFrame(uint8_t* ptr, DeleteType deleteData)
+{
   switch(deleteData)
   {
-    case NO_DELETE:     raw.insertAfter(newData, vvSLNode<uint8_t*>::NO_DELETE); break;
-    case NORMAL_DELETE: raw.insertAfter(newData, vvSLNode<uint8_t*>::NORMAL_DELETE); break;
-    case ARRAY_DELETE:  raw.insertAfter(newData, vvSLNode<uint8_t*>::ARRAY_DELETE); break;
+    case NO_DELETE:     return FramePointer(ptr, NoDeleter());
+    case NORMAL_DELETE: return FramePointer(ptr);
+    case ARRAY_DELETE:  return FramePointer(ptr, ArrayDeleter());
     default: assert(0); break;
   }
+  return FramePointer();
 }
 
 //----------------------------------------------------------------------------
@@ -889,23 +1886,7 @@ void vvVolDesc::makeHistogram(int frame, int chan1, int numChan, int* buckets, i
     if (frame != -1 && frame != f)
       continue; // only compute histogram for a specific frame
 
-    for (size_t i=0; i<getFrameVoxels(); ++i)     // count each voxel value
-    {
-      int dstIndex = 0;                           // index into histogram array
-      int factor = 1;                             // multiplication factor for dstIndex
-      for (int c=0; c<numChan; ++c)
-      {
-        float voxVal = getChannelValue(f, i, chan1+c);
-
-        // Bucket index with respect to channel c
-        int bucketIndex = (int)((voxVal - min) * (buckets[c] / (max-min)));
-        bucketIndex = ts_clamp(bucketIndex, 0, buckets[c]-1);
-
-        dstIndex += bucketIndex * factor;
-        factor *= buckets[c];
-      }
-      ++count[dstIndex];
-    }
+    dispatchVolumeView(*this, size_t(f), CountHistogram(chan1, numChan, buckets, min, max, count, totalBuckets));
   }
   //std::cout << sw.getTime() << '\n';
 }
@@ -1283,6 +2264,7 @@ const char* vvVolDesc::getFilename() const
 void vvVolDesc::setCurrentFrame(size_t f)
 {
   if (f<frames) currentFrame = f;
+  if (frameCache) frameCache->prefetch(currentFrame);
 }
 
 //----------------------------------------------------------------------------
@@ -1380,10 +2362,6 @@ void vvVolDesc::convertBPC(size_t newBPC, bool verbose)
 {
   uint8_t* newRaw;
   uint8_t* rd;
-  uint8_t* src;
-  uint8_t* dst;
-  float val;
-  size_t newSliceSize;
 
   vvDebugMsg::msg(2, "vvVolDesc::convertBPC()");
 
@@ -1391,75 +2369,22 @@ void vvVolDesc::convertBPC(size_t newBPC, bool verbose)
   if (bpc==newBPC) return;                        // this was easy!
   assert(newBPC==1 || newBPC==2 || newBPC==4);
 
-  newSliceSize = vox[0] * vox[1] * newBPC * chan;
-  if (verbose) vvToolshed::initProgress(vox[2] * frames);
+  size_t voxels = getFrameVoxels();
+  if (verbose) vvToolshed::initProgress(frames);
 
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
-    newRaw = new uchar[newSliceSize * vox[2]];
-    src = rd;
-    dst = newRaw;
-    for (ssize_t z=0; z<vox[2]; ++z)
+    rd = frameData(f);
+    newRaw = new uchar[voxels * newBPC * chan];
+    switch (bpc)                                  // switch by source voxel type
     {
-      for (ssize_t y=0; y<vox[1]; ++y)
-      {
-        for (ssize_t x=0; x<vox[0]; ++x)
-        {
-          for (int c=0; c<chan; ++c)
-          {
-            // Perform actual conversion:
-            switch (bpc)                          // switch by source voxel type
-            {
-              case 1:                             // 8 bit source
-                switch (newBPC)                   // switch by destination voxel type
-                {
-                  case 2:
-                    virvo::serialization::write16(dst, src[0]);
-                    break;
-                  case 4:
-                    *((float*)dst) = src[0] / 255.0f;
-                    break;
-                }
-                break;
-              case 2: {                           // 16 bit source 
-                uint16_t s = *(uint16_t *)src;
-                switch (newBPC)                   // switch by destination voxel type
-                {
-                  case 1:
-                    *dst = s >> 8;
-                    break;
-                  case 4:
-                    *((float*)dst) = s / 65535.0f;
-                    break;
-                }
-                break;
-              }
-              case 4:                             // float source
-                val = ts_clamp(*((float*)src), range(c)[0], range(c)[1]);
-                switch (newBPC)                   // switch by destination voxel type
-                {
-                  case 1:
-                    *dst = uchar((val - range(c)[0]) / (range(c)[1] - range(c)[0]) * 255.0f);
-                    break;
-                  case 2:
-                    virvo::serialization::write16(dst, uint16_t((val - range(c)[0]) / (range(c)[1] - range(c)[0]) * 65535.0f));
-                    break;
-                }
-                break;
-            }
-            src += bpc;
-            dst += newBPC;
-          }
-        }
-      }
-      if (verbose) vvToolshed::printProgress(z + vox[2] * f);
+      case 1: convertVoxels<uint8_t>(rd, newRaw, newBPC, voxels, chan, &range_[0]); break;
+      case 2: convertVoxels<uint16_t>(rd, newRaw, newBPC, voxels, chan, &range_[0]); break;
+      case 4: convertVoxels<float>(rd, newRaw, newBPC, voxels, chan, &range_[0]); break;
+      default: assert(0); break;
     }
-    raw.remove();
-    if (f==0) raw.insertBefore(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
-    else raw.insertAfter(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
-    raw.next();
+    if (verbose) vvToolshed::printProgress(f);
+    raw[f] = makeFrame(newRaw, ARRAY_DELETE);
   }
   bpc = newBPC;
 }
@@ -1493,10 +2418,9 @@ void vvVolDesc::convertChannels(int newChan, int frame, bool verbose)
 
   newSliceSize = vox[0] * vox[1] * newChan * bpc;
   if (verbose) vvToolshed::initProgress(vox[2] * (endFrame-startFrame));
-  raw.first();
   for (size_t f=startFrame; f<endFrame; ++f)
   {
-    rd = raw.getData();
+    rd = frameData(f);
     newRaw = new uint8_t[newSliceSize * vox[2]];
     src = rd;
     dst = newRaw;
@@ -1518,10 +2442,7 @@ void vvVolDesc::convertChannels(int newChan, int frame, bool verbose)
       }
       if (verbose) vvToolshed::printProgress(z + vox[2] * (f-startFrame));
     }
-    raw.remove();
-    if (f==0) raw.insertBefore(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
-    else raw.insertAfter(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
-    raw.next();
+    raw[f] = makeFrame(newRaw, ARRAY_DELETE);
   }
   if (newChan != chan)
   {
@@ -1549,10 +2470,9 @@ void vvVolDesc::deleteChannel(int channel, bool verbose)
 
   newSliceSize = vox[0] * vox[1] * (chan-1) * bpc;
   if (verbose) vvToolshed::initProgress(vox[2] * frames);
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = frameData(f);
     newRaw = new uint8_t[newSliceSize * vox[2]];
     src = rd;
     dst = newRaw;
@@ -1577,10 +2497,7 @@ void vvVolDesc::deleteChannel(int channel, bool verbose)
       }
       if (verbose) vvToolshed::printProgress(z + vox[2] * f);
     }
-    raw.remove();
-    if (f==0) raw.insertBefore(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
-    else raw.insertAfter(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
-    raw.next();
+    raw[f] = makeFrame(newRaw, ARRAY_DELETE);
   }
   channelNames.erase(channelNames.begin() + channel);
   mapping_.erase(mapping_.begin() + channel);
@@ -1596,17 +2513,13 @@ void vvVolDesc::deleteChannel(int channel, bool verbose)
 */
 void vvVolDesc::bitShiftData(int bits, int frame, bool verbose)
 {
-  int  shift;
   uint8_t* rd;
-  size_t sliceSize;
-  size_t offset;
 
   vvDebugMsg::msg(2, "vvVolDesc::bitShiftData()");
   assert(bpc<=sizeof(unsigned long));                 // shift only works up to sizeof(long) byte per pixel
   if (bits==0) return;                            // done!
 
-  sliceSize = getSliceBytes();
-  shift = ts_max(bits, -bits);                    // find absolute value
+  size_t n = getFrameVoxels() * chan;
   size_t startFrame=0;
   size_t endFrame=frames;
   if(frame != -1)
@@ -1614,54 +2527,18 @@ void vvVolDesc::bitShiftData(int bits, int frame, bool verbose)
     startFrame = frame;
     endFrame = frame+1;
   }
-  if (verbose) vvToolshed::initProgress(vox[2] * (endFrame-startFrame));
-  raw.first();
-  for (size_t f=0; f<startFrame; ++f) raw.next();
+  if (verbose) vvToolshed::initProgress(endFrame-startFrame);
   for (size_t f=startFrame; f<endFrame; ++f)
   {
-    rd = raw.getData();
-    raw.next();
-    for (ssize_t z=0; z<vox[2]; ++z)
+    rd = frameData(f);
+    switch(bpc)
     {
-      for (ssize_t y=0; y<vox[1]; ++y)
-        for (ssize_t x=0; x<vox[0]; ++x)
-      {
-        offset = x * getBPV() + y * vox[0] * getBPV() + z * sliceSize;
-        unsigned long val = 0;
-        for (size_t b=0; b<bpc*chan; b+=bpc)
-        {
-          switch(bpc) {
-          case 1:
-            val = *(uint8_t *)(rd+offset+b);
-            break;
-          case 2:
-            val = *(uint16_t *)(rd+offset+b);
-            break;
-          case 4:
-            val = *(uint32_t *)(rd+offset+b);
-            break;
-          }
-
-          if (bits>0)
-            val = val >> shift;
-          else
-            val = val << shift;
-
-          switch(bpc) {
-          case 1:
-            *(uint8_t *)(rd+offset+b) = uint8_t(val);
-            break;
-          case 2:
-            *(uint16_t *)(rd+offset+b) = uint16_t(val);
-            break;
-          case 4:
-            *(uint32_t *)(rd+offset+b) = uint32_t(val);
-            break;
-          }
-        }
-      }
-      if (verbose) vvToolshed::printProgress(z + vox[2] * (f-startFrame));
+      case 1: shiftValues<uint8_t>(rd, n, bits); break;
+      case 2: shiftValues<uint16_t>(rd, n, bits); break;
+      case 4: shiftValues<uint32_t>(rd, n, bits); break;
+      default: break;
     }
+    if (verbose) vvToolshed::printProgress(f-startFrame);
   }
 }
 
@@ -1670,25 +2547,17 @@ void vvVolDesc::bitShiftData(int bits, int frame, bool verbose)
  */
 void vvVolDesc::invert()
 {
-  uint8_t* ptr;                                     // pointer to currently worked on byte
   uint8_t* rd;
 
   vvDebugMsg::msg(2, "vvVolDesc::invert()");
 
-  raw.first();
+  ssize_t frameSize = getFrameBytes();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
-    raw.next();
-    ptr = &rd[0];
-    for (ssize_t z=0; z<vox[2]; ++z)
-      for (ssize_t y=0; y<vox[1]; ++y)
-        for (ssize_t x=0; x<vox[0]; ++x)
-          for (size_t b=0; b<bpc*chan; ++b)
-          {
-            *ptr = (uint8_t)(~(*ptr));
-            ++ptr;
-          }
+    rd = frameData(f);
+    #pragma omp parallel for
+    for (ssize_t i=0; i<frameSize; ++i)
+      rd[i] = (uint8_t)(~rd[i]);
   }
 }
 
@@ -1712,10 +2581,9 @@ void vvVolDesc::convertRGB24toRGB8()
 
   oldSliceSize = getSliceBytes();
   newSliceSize = vox[0] * vox[1];
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = frameData(f);
     newRaw = new uint8_t[vox[0] * vox[1] * vox[2]];
     for (ssize_t z=0; z<vox[2]; ++z)
       for (ssize_t y=0; y<vox[1]; ++y)
@@ -1731,10 +2599,7 @@ void vvVolDesc::convertRGB24toRGB8()
           }
           newRaw[x + y * vox[0] + z * newSliceSize] = (uint8_t)(pixel >> 8);
     }
-    raw.remove();
-    if (f==0) raw.insertBefore(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
-    else raw.insertAfter(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
-    raw.next();
+    raw[f] = makeFrame(newRaw, ARRAY_DELETE);
   }
   chan = 1;
 }
@@ -1762,9 +2627,6 @@ void vvVolDesc::flip(virvo::cartesian_axis< 3 > axis)
     typedef virvo::cartesian_axis< 3 > axis_type;
 
   uint8_t* rd;
-  uint8_t* voxelData;                             // temporary buffer for voxel data
-  uint8_t* dst;                                   // destination pointer
-  uint8_t* src;                                   // source pointer
   size_t lineSize;
   size_t sliceSize;
 
@@ -1772,55 +2634,63 @@ void vvVolDesc::flip(virvo::cartesian_axis< 3 > axis)
 
   lineSize = vox[0] * getBPV();
   sliceSize = getSliceBytes();
-  if (axis==axis_type::Z) voxelData = new uchar[sliceSize];
-  else voxelData = new uint8_t[lineSize];
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = frameData(f);
     switch (axis)
     {
       case axis_type::X:
-        dst = rd;
-        for (ssize_t z=0; z<vox[2]; ++z)
-          for (ssize_t y=0; y<vox[1]; ++y)
+        switch (getBPV())
         {
-          memcpy((void*)voxelData, (void*)dst, lineSize);
-          src = voxelData + (vox[0]-1) * getBPV();
-          for (ssize_t x=0; x<vox[0]; ++x)
+          case 1: reverseLines<uint8_t>(rd, vox[1] * vox[2], vox[0]); break;
+          case 2: reverseLines<uint16_t>(rd, vox[1] * vox[2], vox[0]); break;
+          case 4: reverseLines<uint32_t>(rd, vox[1] * vox[2], vox[0]); break;
+          case 8: reverseLines<uint64_t>(rd, vox[1] * vox[2], vox[0]); break;
+          default:
           {
-            memcpy(dst, src, getBPV());
-            dst += getBPV();
-            src -= getBPV();
+            // Mirror each line in place by swapping voxels from both ends
+            const ssize_t bpv = getBPV();
+            const ssize_t numLines = vox[1] * vox[2];
+            #pragma omp parallel for
+            for (ssize_t l=0; l<numLines; ++l)
+            {
+              uint8_t* line = rd + l * lineSize;
+              for (ssize_t x=0; x<vox[0]/2; ++x)
+                std::swap_ranges(line + x * bpv, line + (x + 1) * bpv, line + (vox[0] - x - 1) * bpv);
+            }
+            break;
           }
         }
         break;
       case axis_type::Y:
-        for (ssize_t z=0; z<vox[2]; ++z)
-          for (ssize_t y=0; y<vox[1]/2; ++y)
+      {
+        const ssize_t numLines = vox[2] * (vox[1]/2);
+        #pragma omp parallel for
+        for (ssize_t l=0; l<numLines; ++l)
         {
-          src = rd + y * lineSize + z * sliceSize;
-          dst = rd + (vox[1] - y - 1) * lineSize + z * sliceSize;
-          memcpy((void*)voxelData, (void*)dst, lineSize);
-          memcpy((void*)dst, (void*)src, lineSize);
-          memcpy((void*)src, (void*)voxelData, lineSize);
+          ssize_t z = l / (vox[1]/2);
+          ssize_t y = l % (vox[1]/2);
+          uint8_t* src = rd + y * lineSize + z * sliceSize;
+          uint8_t* dst = rd + (vox[1] - y - 1) * lineSize + z * sliceSize;
+          std::swap_ranges(src, src + lineSize, dst);
         }
         break;
+      }
       case axis_type::Z:
-        for (ssize_t z=0; z<vox[2]/2; ++z)
+      {
+        const ssize_t halfSlices = vox[2]/2;
+        #pragma omp parallel for
+        for (ssize_t z=0; z<halfSlices; ++z)
         {
-          dst = rd + z * sliceSize;
-          src = rd + (vox[2]-z-1) * sliceSize;
-          memcpy((void*)voxelData, (void*)dst, sliceSize);
-          memcpy((void*)dst, (void*)src, sliceSize);
-          memcpy((void*)src, (void*)voxelData, sliceSize);
+          uint8_t* dst = rd + z * sliceSize;
+          uint8_t* src = rd + (vox[2]-z-1) * sliceSize;
+          std::swap_ranges(dst, dst + sliceSize, src);
         }
         break;
+      }
       default: break;
     }
-    raw.next();
   }
-  delete[] voxelData;
 }
 
 //----------------------------------------------------------------------------
@@ -1839,12 +2709,8 @@ void vvVolDesc::rotate(virvo::cartesian_axis< 3 > axis, int dir)
     typedef virvo::cartesian_axis< 3 > axis_type;
 
   uint8_t* rd;
-  uint8_t* dst;                                   // destination pointer
-  uint8_t* src;                                   // source pointer
   uint8_t* newRaw;                                // new volume data
   size_t newWidth, newHeight, newSlices;          // dimensions of rotated volume
-  size_t x, y, z;
-  size_t xpos, ypos, zpos;
 
   vvDebugMsg::msg(2, "vvVolDesc::rotate()");
   if (dir!=-1 && dir!=1) return;                  // validate direction
@@ -1874,71 +2740,45 @@ void vvVolDesc::rotate(virvo::cartesian_axis< 3 > axis, int dir)
       break;
   }
 
+  // Source voxels are visited in memory order (i,j,k); the destination
+  // index of each one is i*di + j*dj + k*dk + d0 (in voxels):
+  ssize_t ni, nj, nk, di, dj, dk, d0;
+  const ssize_t w = newWidth;
+  const ssize_t wh = newWidth * newHeight;
+  switch (axis)
+  {
+    case axis_type::X:                            // i=y, j=z, k=x
+      ni = newHeight; nj = newSlices; nk = newWidth;
+      di = dir>0 ? w : -w;
+      dj = dir>0 ? -wh : wh;
+      dk = 1;
+      d0 = (dir>0 ? 0 : (newHeight-1) * w) + (dir>0 ? (newSlices-1) * wh : 0);
+      break;
+    case axis_type::Y:                            // i=x, j=y, k=z
+      ni = newWidth; nj = newHeight; nk = newSlices;
+      di = dir>0 ? 1 : -1;
+      dj = w;
+      dk = dir>0 ? -wh : wh;
+      d0 = (dir>0 ? 0 : newWidth-1) + (dir>0 ? (newSlices-1) * wh : 0);
+      break;
+    case axis_type::Z:                            // i=z, j=x, k=y
+      ni = newSlices; nj = newWidth; nk = newHeight;
+      di = wh;
+      dj = dir>0 ? -1 : 1;
+      dk = dir>0 ? w : -w;
+      d0 = (dir>0 ? newWidth-1 : 0) + (dir>0 ? 0 : (newHeight-1) * w);
+      break;
+    default:
+      return;
+  }
+
   size_t frameSize = getFrameBytes();
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = frameData(f);
     newRaw = new uint8_t[frameSize];
-    src = rd;
-    switch (axis)
-    {
-      case axis_type::X:
-        for (y=0; y<newHeight; ++y)
-        {
-          if (dir>0) ypos = y;
-          else       ypos = newHeight - 1 - y;
-          for (z=0; z<newSlices; ++z)
-          {
-            if (dir>0) zpos = newSlices - 1 - z;
-            else       zpos = z;
-            for (x=0; x<newWidth; ++x)
-            {
-              dst = newRaw + getBPV() * (x + ypos * newWidth + zpos * newWidth * newHeight);
-              memcpy((void*)dst, (void*)src, getBPV());
-              src += getBPV();
-            }
-          }
-        }
-        break;
-      case axis_type::Y:
-        for (x=0; x<newWidth; ++x)
-        {
-          if (dir>0) xpos = x;
-          else       xpos = newWidth - 1 - x;
-          for (y=0; y<newHeight; ++y)
-            for (z=0; z<newSlices; ++z)
-          {
-            if (dir>0) zpos = newSlices - 1 - z;
-            else       zpos = z;
-            dst = newRaw + getBPV() * (xpos + y * newWidth + zpos * newWidth * newHeight);
-            memcpy((void*)dst, (void*)src, getBPV());
-            src += getBPV();
-          }
-        }
-        break;
-      case axis_type::Z:
-        for (z=0; z<newSlices; ++z)
-          for (x=0; x<newWidth; ++x)
-        {
-          if (dir>0) xpos = newWidth - 1 - x;
-          else       xpos = x;
-          for (y=0; y<newHeight; ++y)
-          {
-            if (dir>0) ypos = y;
-            else       ypos = newHeight - 1 - y;
-            dst = newRaw + getBPV() * (xpos + ypos * newWidth + z * newWidth * newHeight);
-            memcpy((void*)dst, (void*)src, getBPV());
-            src += getBPV();
-          }
-        }
-        break;
-      default: break;
-    }
-    raw.remove();
-    if (f==0) raw.insertBefore(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
-    else raw.insertAfter(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
-    raw.next();
+    permuteVoxels(rd, newRaw, getBPV(), ni, nj, nk, di, dj, dk, d0);
+    raw[f] = makeFrame(newRaw, ARRAY_DELETE);
   }
   vox[0] = newWidth;
   vox[1] = newHeight;
@@ -1970,7 +2810,7 @@ void vvVolDesc::convertRGBPlanarToRGBInterleaved(int frame)
   }
   for (size_t f=startFrame; f<endFrame; ++f)
   {
-    raw = getRaw(f);
+    raw = frameData(f);
     for (size_t i=0; i<voxels; ++i)
       for (size_t c=0; c<3; ++c)
         tmpData[i * 3 + c] = raw[c * voxels + i];
@@ -2004,20 +2844,14 @@ void vvVolDesc::toggleEndianness(int frame)
   const size_t n = vox[0] * vox[1] * vox[2] * bpv / bpc;
   for (size_t f=startFrame; f<endFrame; ++f)
   {
-    uint8_t *rd = getRaw(f);
+    uint8_t *rd = frameData(f);
     if (!rd)
         continue;
 
     if (bpc == 2) {
-      uint16_t *r = reinterpret_cast<uint16_t *>(rd);
-      for (size_t i=0; i<n; ++i) {
-        r[i] = byte_swap<little_endian, big_endian, uint16_t>(r[i]);
-      }
+      swapValues<uint16_t>(rd, n);
     } else if (bpc == 4) {
-      uint32_t *r = reinterpret_cast<uint32_t *>(rd);
-      for (size_t i=0; i<n; ++i) {
-        r[i] = byte_swap<little_endian, big_endian, uint32_t>(r[i]);
-      }
+      swapValues<uint32_t>(rd, n);
     }
 
 #if 0
@@ -2074,10 +2908,9 @@ void vvVolDesc::toggleSign(int /* frame */)
   vvDebugMsg::msg(2, "vvVolDesc::toggleSign()");
 
   size_t frameVoxels = getFrameVoxels();
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = frameData(f);
     for (size_t i=0; i<frameVoxels*chan; ++i)
     {
       switch(bpc)
@@ -2094,7 +2927,6 @@ void vvVolDesc::toggleSign(int /* frame */)
       }
       rd += bpc;
     }
-    raw.next();
   }
 }
 
@@ -2113,10 +2945,9 @@ void vvVolDesc::makeUnsigned(int /* frame */)
   vvDebugMsg::msg(2, "vvVolDesc::makeUnsigned()");
 
   size_t frameVoxels = getFrameVoxels();
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = frameData(f);
     for (size_t i=0; i<frameVoxels*chan; ++i)
     {
       switch(bpc)
@@ -2136,7 +2967,6 @@ void vvVolDesc::makeUnsigned(int /* frame */)
       }
       rd += bpc;
     }
-    raw.next();
   }
 }
 
@@ -2152,10 +2982,9 @@ bool vvVolDesc::isChannelUsed(size_t m)
   assert(m<chan);
 
   size_t frameSize = getFrameVoxels();
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = getRaw(f);
     for (size_t i=0; i<frameSize; ++i)
     {
       switch(bpc)
@@ -2165,7 +2994,6 @@ bool vvVolDesc::isChannelUsed(size_t m)
         case 4: if (*((float*)rd) != 0.0f) return true; break;
       }
     }
-    raw.next();
   }
   return false;
 }
@@ -2183,7 +3011,6 @@ void vvVolDesc::crop(ssize_t x, ssize_t y, ssize_t z, ssize_t w, ssize_t h, ssiz
   ssize_t newWidth, newHeight, newSlices;
   size_t newSliceSize;
   size_t oldSliceSize;
-  uint8_t *src, *dst;
 
   vvDebugMsg::msg(2, "vvVolDesc::crop()");
 
@@ -2203,23 +3030,20 @@ void vvVolDesc::crop(ssize_t x, ssize_t y, ssize_t z, ssize_t w, ssize_t h, ssiz
   // Now cropping can be done:
   oldSliceSize = getSliceBytes();
   newSliceSize = newWidth * newHeight * getBPV();
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = frameData(f);
     newRaw = new uint8_t[newSliceSize * newSlices];
+    #pragma omp parallel for
     for (ssize_t j=0; j<newSlices; ++j)
       for (ssize_t i=0; i<newHeight; ++i)
     {
-      src = rd + (j + zmin) * oldSliceSize +
+      const uint8_t* src = rd + (j + zmin) * oldSliceSize +
         (i + ymin) * vox[0] * getBPV() + xmin * getBPV();
-      dst = newRaw + j * newSliceSize + i * newWidth * getBPV();
+      uint8_t* dst = newRaw + j * newSliceSize + i * newWidth * getBPV();
       memcpy(dst, src, newWidth * getBPV());
     }
-    raw.remove();
-    if (f==0) raw.insertBefore(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
-    else raw.insertAfter(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
-    raw.next();
+    raw[f] = makeFrame(newRaw, ARRAY_DELETE);
   }
 
   // set new center
@@ -2240,18 +3064,15 @@ void vvVolDesc::crop(ssize_t x, ssize_t y, ssize_t z, ssize_t w, ssize_t h, ssiz
 */
 void vvVolDesc::cropTimesteps(size_t start, size_t steps)
 {
-  raw.first();
-
-  // Remove steps before the desired range:
-  for (size_t i=0; i<start; ++i)
-    raw.remove();
+  makeResident();
 
   // Remove steps after the desired range:
-  raw.last();
-  for (size_t i=0; i<frames-start-steps; ++i)
-    raw.remove();
+  raw.erase(raw.begin() + std::min(start + steps, raw.size()), raw.end());
+
+  // Remove steps before the desired range:
+  raw.erase(raw.begin(), raw.begin() + std::min(start, raw.size()));
 
-  frames = raw.count();
+  frames = raw.size();
 }
 
 //----------------------------------------------------------------------------
@@ -2267,10 +3088,6 @@ void vvVolDesc::resize(ssize_t w, ssize_t h, ssize_t s, InterpolationType ipt, b
   uint8_t* rd;
   size_t newSliceSize, newFrameSize;
   size_t oldSliceVoxels;
-  uint8_t *src, *dst;
-  ssize_t ix, iy, iz;                             // integer source voxel coordinates
-  float fx, fy, fz;                               // floating point source voxel coordinates
-  uint8_t interpolated[4];                        // interpolated voxel values
 
   vvDebugMsg::msg(2, "vvVolDesc::resize()");
 
@@ -2282,35 +3099,34 @@ void vvVolDesc::resize(ssize_t w, ssize_t h, ssize_t s, InterpolationType ipt, b
   oldSliceVoxels = getSliceVoxels();
   newSliceSize = w * h * getBPV();
   newFrameSize = newSliceSize * s;
-  if (verbose) vvToolshed::initProgress(s * frames);
-  raw.first();
+  if (verbose) vvToolshed::initProgress(frames);
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = frameData(f);
     newRaw = new uint8_t[newFrameSize];
-    dst = newRaw;
 
-    // Traverse destination data:
-    for (ssize_t z=0; z<s; ++z)
+    if (ipt==TRILINEAR)                           // trilinear interpolation
     {
-      for (ssize_t y=0; y<h; ++y)
-        for (ssize_t x=0; x<w; ++x)
+      switch (bpc)
       {
-        // Compute source coordinates of current destination voxel:
-        if (ipt==TRILINEAR)                       // trilinear interpolation
-        {
-          // Compute source coordinates of current destination voxel:
-          fx = (float)x / (float)(w-1) * (float)(vox[0]-1);
-          fy = (float)y / (float)(h-1) * (float)(vox[1]-1);
-          fz = (float)z / (float)(s-1) * (float)(vox[2]-1);
-          trilinearInterpolation(f, fx, fy, fz, interpolated);
-
-          // Copy interpolated voxel data to destination voxel:
-          memcpy(dst, interpolated, getBPV());
-        }
-        else                                      // nearest neighbor interpolation
+        case 1: resampleTrilinear<uint8_t>(rd, vox, chan, newRaw, w, h, s); break;
+        case 2: resampleTrilinear<uint16_t>(rd, vox, chan, newRaw, w, h, s); break;
+        case 4: resampleTrilinear<float>(rd, vox, chan, newRaw, w, h, s); break;
+        default: assert(0); break;
+      }
+    }
+    else                                          // nearest neighbor interpolation
+    {
+      // Traverse destination data:
+      #pragma omp parallel for
+      for (ssize_t z=0; z<s; ++z)
+      {
+        uint8_t* dst = newRaw + z * newSliceSize;
+        for (ssize_t y=0; y<h; ++y)
+          for (ssize_t x=0; x<w; ++x)
         {
           // Compute source coordinates of current destination voxel:
+          ssize_t ix, iy, iz;                     // integer source voxel coordinates
           if (w>1) ix = x * (vox[0]-1)  / (w-1);
           else     ix = 0;
           if (h>1) iy = y * (vox[1]-1) / (h-1);
@@ -2322,17 +3138,14 @@ void vvVolDesc::resize(ssize_t w, ssize_t h, ssize_t s, InterpolationType ipt, b
           iz = ts_clamp(iz, ssize_t(0), vox[2]-1);
 
           // Copy source voxel data to destination voxel:
-          src = rd + getBPV() * (ix + iy * vox[0] + iz * oldSliceVoxels);
+          const uint8_t* src = rd + getBPV() * (ix + iy * vox[0] + iz * oldSliceVoxels);
           memcpy(dst, src, getBPV());
+          dst += getBPV();
         }
-        dst += getBPV();
       }
-      if (verbose) vvToolshed::printProgress(z + s * f);
     }
-    raw.remove();
-    if (f==0) raw.insertBefore(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
-    else raw.insertAfter(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
-    raw.next();
+    if (verbose) vvToolshed::printProgress(f);
+    raw[f] = makeFrame(newRaw, ARRAY_DELETE);
   }
 
   // Adjust voxel size:
@@ -2357,10 +3170,9 @@ void vvVolDesc::replaceData(int numChan, const int *oldVal, const int *newVal, b
     numChan = chan;
 
   if (verbose) vvToolshed::initProgress(vox[2] * frames);
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    uint8_t *rd = raw.getData();
+    uint8_t *rd = frameData(f);
 
     // Traverse destination data:
     for (ssize_t z=0; z<vox[2]; ++z)
@@ -2389,7 +3201,6 @@ void vvVolDesc::replaceData(int numChan, const int *oldVal, const int *newVal, b
       }
       if (verbose) vvToolshed::printProgress(z + vox[2] * f);
     }
-    raw.next();
   }
 
   if (verbose)
@@ -2431,13 +3242,11 @@ void vvVolDesc::shift(int sx, int sy, int sz)
   lineSize  = vox[0] * getBPV();
   sliceSize = getSliceBytes();
   frameSize = getFrameBytes();
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
     for (size_t i=0; i<3; ++i)
     {
-      raw.makeCurrent(f);
-      rd = raw.getData();
+      rd = frameData(f);
 
       if (sval[i] > 0)
       {
@@ -2476,12 +3285,9 @@ void vvVolDesc::shift(int sx, int sy, int sz)
             }
             break;
         }
-        raw.remove();
-        if (f==0) raw.insertBefore(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
-        else raw.insertAfter(newRaw, vvSLNode<uchar*>::ARRAY_DELETE);
+        raw[f] = makeFrame(newRaw, ARRAY_DELETE);
       }
     }
-    raw.next();
   }
 }
 
@@ -2501,7 +3307,7 @@ void vvVolDesc::convertVoxelOrder()
   tmpData = dst = new uint8_t[frameSize];
   for (size_t f=0; f<frames; ++f)
   {
-    raw = src = getRaw(f);
+    raw = src = frameData(f);
     for (ssize_t x=0; x<vox[0]; ++x)
       for (ssize_t y=0; y<vox[1]; ++y)
         for (ssize_t z=0; z<vox[2]; ++z)
@@ -2533,7 +3339,7 @@ void vvVolDesc::convertCoviseToVirvo()
   tmpData = new uint8_t[frameSize];
   for (size_t f=0; f<frames; ++f)
   {
-    raw = getRaw(f);
+    raw = frameData(f);
     ptr = tmpData;
     for (ssize_t z=0; z<vox[2]; ++z)
       for (ssize_t y=0; y<vox[1]; ++y)
@@ -2570,7 +3376,7 @@ void vvVolDesc::convertVirvoToCovise()
   tmpData = new uint8_t[frameSize];
   for (size_t f=0; f<frames; ++f)
   {
-    raw = getRaw(f);
+    raw = frameData(f);
     ptr = raw;
     for (ssize_t z=0; z<vox[2]; ++z)
       for (ssize_t y=0; y<vox[1]; ++y)
@@ -2603,7 +3409,7 @@ void vvVolDesc::convertVirvoToOpenGL()
   tmpData = new uint8_t[frameSize];
   for (size_t f=0; f<frames; ++f)
   {
-    raw = getRaw(f);
+    raw = frameData(f);
     ptr = raw;
     for (ssize_t z=0; z<vox[2]; ++z)
       for (ssize_t y=0; y<vox[1]; ++y)
@@ -2636,7 +3442,7 @@ void vvVolDesc::convertOpenGLToVirvo()
   tmpData = new uint8_t[frameSize];
   for (size_t f=0; f<frames; ++f)
   {
-    raw = getRaw(f);
+    raw = frameData(f);
     ptr = raw;
     for (ssize_t z=0; z<vox[2]; ++z)
       for (ssize_t y=0; y<vox[1]; ++y)
@@ -2779,10 +3585,9 @@ void vvVolDesc::makeSphere(size_t outer, size_t inner, InterpolationType ipt, bo
   center = vec3f(radius, radius, radius);
   sliceVoxels = vox[0] * vox[1];
   if (verbose) vvToolshed::initProgress(outer * frames);
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = frameData(f);
     newRaw = new uint8_t[newFrameSize];
     dst = newRaw;
 
@@ -2826,10 +3631,7 @@ void vvVolDesc::makeSphere(size_t outer, size_t inner, InterpolationType ipt, bo
       }
       if (verbose) vvToolshed::printProgress(z + outer * f);
     }
-    raw.remove();
-    if (f==0) raw.insertBefore(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
-    else raw.insertAfter(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
-    raw.next();
+    raw[f] = makeFrame(newRaw, ARRAY_DELETE);
   }
   vox[0] = vox[1] = vox[2] = outer;
 }
@@ -3064,103 +3866,24 @@ void vvVolDesc::printVoxelData(int frame, ssize_t slice, ssize_t width, ssize_t
 an _allocated_ memory space of bpc * chan bytes.
 */
 void vvVolDesc::trilinearInterpolation(size_t f, float x, float y, float z, uint8_t* result)
-{
-  uint8_t* rd;
-  uint8_t* neighbor[8];                           // pointers to neighboring voxels
-  float val[8];                                   // neighboring voxel values
-  virvo::vector< 3, ssize_t > tfl;                // coordinates of neighbor 0 (top-front-left)
-  float dist[3];                                  // distance to neighbor 0
-  size_t lineSize, sliceSize;
-  int interpolated;                               // interpolated value
-
-  vvDebugMsg::msg(3, "vvVolDesc::trilinearInterpolation()");
-
-  if (vox[0]<2 || vox[1]<2 || vox[2]<2) return;   // done!
-
-  // Check for valid frame index:
-  if (f>=frames) return;
-
-  // Constrain voxel position to the valid region:
-  x = ts_clamp(x, 0.0f, (float)(vox[0]-1));
-  y = ts_clamp(y, 0.0f, (float)(vox[1]-1));
-  z = ts_clamp(z, 0.0f, (float)(vox[2]-1));
-
-  // Compute coordinates of neighbor 0:
-  tfl[0] = (size_t)x;
-  tfl[1] = (size_t)y;
-  tfl[2] = (size_t)z;
-
-  // Compute distance to neighbor 0:
-  if (tfl[0] < (vox[0]-1))
-    dist[0] = x - (float)tfl[0];
-  else                                            // border values need special treatment
-  {
-    --tfl[0];
-    dist[0] = 1.0f;
-  }
-  if (tfl[1] < (vox[1]-1))
-    dist[1] = y - (float)tfl[1];
-  else                                            // border values need special treatment
-  {
-    --tfl[1];
-    dist[1] = 1.0f;
-  }
-  if (tfl[2] < (vox[2]-1))
-    dist[2] = z - (float)tfl[2];
-  else                                            // border values need special treatment
-  {
-    --tfl[2];
-    dist[2] = 1.0f;
-  }
-
-  raw.makeCurrent(f);
-  rd = raw.getData();                             // get pointer to voxel data
-
-  // Compute pointers to neighboring voxels:
-  sliceSize = vox[0] * vox[1] * getBPV();
-  lineSize  = vox[0] * getBPV();
-  neighbor[0] = rd + getBPV() * tfl[0] + tfl[1] * lineSize + tfl[2] * sliceSize;
-  neighbor[1] = neighbor[0] + lineSize;
-  neighbor[2] = neighbor[1] + getBPV();
-  neighbor[3] = neighbor[0] + getBPV();
-  neighbor[4] = neighbor[0] + sliceSize;
-  neighbor[5] = neighbor[1] + sliceSize;
-  neighbor[6] = neighbor[2] + sliceSize;
-  neighbor[7] = neighbor[3] + sliceSize;
-
-  for (int j=0; j<chan; ++j)
-  {
-    // Get neighboring voxel values:
-    for (size_t i=0; i<8; ++i)
-    {
-      switch (bpc)
-      {
-        default:
-        case 1: val[i] = (float)(*neighbor[i] + j); break;
-        case 2: val[i] = ((float)(*neighbor[i]+j*2)) * 256.0f + (float)(*(neighbor[i]+j*2+1)); break;
-        case 4: val[i] = (float)(*(neighbor[i]+j*4)); break;
-      }
-    }
+{
+  vvDebugMsg::msg(3, "vvVolDesc::trilinearInterpolation()");
 
-    // Trilinearly interpolate values:
-    interpolated = (int)(
-      val[0] * (1.0f - dist[0]) * (1.0f - dist[1]) * (1.0f - dist[2]) +
-      val[1] * (1.0f - dist[0]) * dist[1]          * (1.0f - dist[2]) +
-      val[2] * dist[0]          * dist[1]          * (1.0f - dist[2]) +
-      val[3] * dist[0]          * (1.0f - dist[1]) * (1.0f - dist[2]) +
-      val[4] * (1.0f - dist[0]) * (1.0f - dist[1]) * dist[2] +
-      val[5] * (1.0f - dist[0]) * dist[1]          * dist[2] +
-      val[6] * dist[0]          * dist[1]          * dist[2] +
-      val[7] * dist[0]          * (1.0f - dist[1]) * dist[2] );
+  // Check for valid frame index:
+  if (f>=frames) return;
 
-    switch (bpc)
-    {
-      default:
-      case 1: result[j]     = (uint8_t)interpolated; break;
-      case 2: result[j*2]   = (uint8_t)(interpolated / 256);
-      result[j*2+1] = (uint8_t)(interpolated % 256); break;
-      case 4: *((float*)(result+j*4)) = float(interpolated); break;
-    }
+  // Constrain voxel position to the valid region:
+  x = ts_clamp(x, 0.0f, (float)(vox[0]-1));
+  y = ts_clamp(y, 0.0f, (float)(vox[1]-1));
+  z = ts_clamp(z, 0.0f, (float)(vox[2]-1));
+
+  const uint8_t* rd = getRaw(f);                  // get pointer to voxel data
+  switch (bpc)
+  {
+    case 1: interpolateVoxel(rd, vox, chan, x, y, z, result); break;
+    case 2: interpolateVoxel(reinterpret_cast<const uint16_t*>(rd), vox, chan, x, y, z, reinterpret_cast<uint16_t*>(result)); break;
+    case 4: interpolateVoxel(reinterpret_cast<const float*>(rd), vox, chan, x, y, z, reinterpret_cast<float*>(result)); break;
+    default: assert(0); break;
   }
 }
 
@@ -3187,7 +3910,7 @@ void vvVolDesc::drawBox(ssize_t p1x, ssize_t p1y, ssize_t p1z, ssize_t p2x, ssiz
 
   sliceSize = getSliceBytes();
   lineSize  = vox[0] * getBPV();
-  raw = getRaw(currentFrame);
+  raw = frameData(currentFrame);
   for (ssize_t z=0; z<vox[2]; ++z)
   {
     for (ssize_t y=0; y<vox[1]; ++y)
@@ -3265,7 +3988,7 @@ void vvVolDesc::drawSphere(ssize_t p1x, ssize_t p1y, ssize_t p1z, ssize_t radius
 
   sliceSize = getSliceBytes();
   lineSize  = vox[0] * getBPV();
-  raw = getRaw(currentFrame);
+  raw = frameData(currentFrame);
   for (ssize_t z = zstart; z < zend; ++z)
   {
     for (ssize_t y = ystart; y < yend; ++y)
@@ -3296,7 +4019,7 @@ void vvVolDesc::drawLine(ssize_t p1x, ssize_t p1y, ssize_t p1z, ssize_t p2x, ssi
 
   vvDebugMsg::msg(3, "vvVolDesc::drawLine()");
 
-  raw = getRaw(currentFrame);
+  raw = frameData(currentFrame);
   vvToolshed::draw3DLine(p1x, p1y, p1z, p2x, p2y, p2z, val,
     raw, getBPV(), vox[0], vox[1], vox[2]);
 }
@@ -3438,7 +4161,7 @@ void vvVolDesc::drawBoundaries(uchar* color, int frame)
   }
   for (f=from; f<=to; ++f)
   {
-    raw = getRaw(f);
+    raw = frameData(f);
     for (i=0; i<12; ++i)
     {
       vvToolshed::draw3DLine(lines[i][0][0] * vox[0], lines[i][0][1] * vox[1], lines[i][0][2] * vox[2],
@@ -3765,7 +4488,7 @@ void vvVolDesc::setSliceData(uint8_t* newData, int slice, int frame)
   if (frames>0 && vox[2]>0)                       // make sure at least one slice is stored
   {
     sliceSize = getSliceBytes();
-    dst = getRaw(frame) + slice * sliceSize;
+    dst = frameData(frame < 0 ? currentFrame : size_t(frame)) + slice * sliceSize;
     memcpy(dst, newData, sliceSize);
   }
 }
@@ -3920,10 +4643,9 @@ void vvVolDesc::deinterlace()
   frameSize = getFrameBytes();
   volBuf = new uint8_t[frameSize];
   assert(volBuf);
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = frameData(f);
     memcpy(volBuf, rd, frameSize);                // make backup copy of volume
     for (ssize_t z=0; z<vox[2]; ++z)
     {
@@ -3936,7 +4658,6 @@ void vvVolDesc::deinterlace()
       // Swap source and destination slice:
       memcpy((void*)dst, (void*)src, sliceSize);
     }
-    raw.next();
   }
   delete[] volBuf;
 }
@@ -3948,34 +4669,54 @@ void vvVolDesc::deinterlace()
 */
 void vvVolDesc::findMinMax(int channel, float& scalarMin, float& scalarMax) const
 {
-  (void)channel;
-  int mi, ma;
-  float fMin, fMax;
-
   vvDebugMsg::msg(2, "vvVolDesc::findMinMax()");
 
-  // TODO: make search channel dependent
+  uint8_t mi8 = std::numeric_limits<uint8_t>::max(), ma8 = 0;
+  uint16_t mi16 = std::numeric_limits<uint16_t>::max(), ma16 = 0;
+  float fMin = FLT_MAX, fMax = -FLT_MAX;
+
   for (size_t f=0; f<frames; ++f)
   {
     switch(bpc)
     {
-      case 1: vvToolshed::getMinMax(getRaw(f), getFrameBytes(), &mi, &ma);
-        fMin = lerp(mapping(channel)[0], mapping(channel)[1], static_cast<float>(mi) / 255);
-        fMax = lerp(mapping(channel)[0], mapping(channel)[1], static_cast<float>(ma) / 255);
+      case 1:
+      {
+        VolumeView<uint8_t> view(*this, f);
+        if (view.valid()) findMinMaxValues(view, channel, mi8, ma8);
         break;
-      case 2: vvToolshed::getMinMax16bitHost(getRaw(f), getFrameVoxels(), &mi, &ma);
-        fMin = lerp(mapping(channel)[0], mapping(channel)[1], static_cast<float>(mi) / 65535);
-        fMax = lerp(mapping(channel)[0], mapping(channel)[1], static_cast<float>(ma) / 65535);
+      }
+      case 2:
+      {
+        VolumeView<uint16_t> view(*this, f);
+        if (view.valid()) findMinMaxValues(view, channel, mi16, ma16);
         break;
+      }
       case 4:
-        vvToolshed::getMinMax((float*)getRaw(f), getFrameVoxels(), &fMin, &fMax);
+      {
+        VolumeView<float> view(*this, f);
+        if (view.valid()) findMinMaxValues(view, channel, fMin, fMax);
         break;
+      }
       default: assert(0); break;
     }
+  }
 
-    scalarMin = fMin;
-    scalarMax = fMax;
+  switch(bpc)
+  {
+    case 1:
+      fMin = channelValue(mi8, mapping(channel));
+      fMax = channelValue(ma8, mapping(channel));
+      break;
+    case 2:
+      fMin = channelValue(mi16, mapping(channel));
+      fMax = channelValue(ma16, mapping(channel));
+      break;
+    default: break;
   }
+  if (frames == 0) return;
+
+  scalarMin = fMin;
+  scalarMax = fMax;
 }
 
 //----------------------------------------------------------------------------
@@ -4032,38 +4773,12 @@ float vvVolDesc::findClampValue(int frame, int channel, float threshold) const
 */
 int vvVolDesc::findNumValue(int frame, float val)
 {
-  uint8_t* raw;
   int num = 0;
-  int sval;
-  bool allEqual;
 
   vvDebugMsg::msg(2, "vvVolDesc::findNumValue()");
 
-  size_t frameVoxels = getFrameVoxels();
-
   // Search volume:
-  raw = getRaw(frame);
-  for (size_t i=0; i<frameVoxels; ++i)
-  {
-    allEqual = true;
-    for (int m=0; m<chan; ++m)
-    {
-      switch (bpc)
-      {
-        case 1:
-          if (raw[i] != uint8_t(val)) allEqual = false;
-          break;
-        case 2:
-          sval = int(raw[i]) * 256 + raw[i+1];
-          if (sval != int(val)) allEqual = false;
-          break;
-        case 4:
-          if (*((float*)(raw+i)) != val) allEqual = false;
-          break;
-      }
-    }
-    if (allEqual) ++num;
-  }
+  dispatchVolumeView(*this, frame == -1 ? getCurrentFrame() : size_t(frame), CountValue(val, num));
   return num;
 }
 
@@ -4158,53 +4873,21 @@ void vvVolDesc::findDataBounds(ssize_t &x, ssize_t &y, ssize_t &z, ssize_t &w, s
 */
 int vvVolDesc::findNumUsed(int channel)
 {
-  bool* used;                                     // true = scalar value occurs in array
-  uint8_t* raw;
-  size_t numValues;
-  int numUsed = 0;
-  int value;
-
   vvDebugMsg::msg(2, "vvVolDesc::findNumUsed()");
 
   if (bpc>=3) return -1;     // doesn't work with floats
 
-  size_t frameVoxels = getFrameVoxels();
-  numValues = (bpc==2) ? 65536 : 256;
-  used = new bool[numValues];
-
-  // Initialize occurrence array:
-  for (size_t i=0; i<numValues; ++i)
-  {
-    used[i] = false;
-  }
+  // Occurrence array, true = scalar value occurs in array:
+  std::vector<uint8_t> used((bpc==2) ? 65536 : 256, 0);
 
   // Fill occurrence array:
   for (size_t f=0; f<frames; ++f)
   {
-    raw = getRaw(f);
-    for (size_t i=0; i<frameVoxels; ++i)
-    {
-      switch (bpc)
-      {
-        case 1:
-          used[raw[i*chan+channel]] = true;
-          break;
-        case 2:
-          value = (int(raw[i*2*chan+channel]) << 8) | int(raw[i*2*chan+channel+1]);
-          used[value] = true;
-          break;
-      }
-    }
+    dispatchVolumeView(*this, f, MarkUsedValues(channel, used));
   }
 
   // Count number of 'true' entries in occurrence array:
-  for (size_t i=0; i<numValues; ++i)
-  {
-    if (used[i]==true) ++numUsed;
-  }
-
-  delete[] used;
-  return numUsed;
+  return int(std::count(used.begin(), used.end(), 1));
 }
 
 //----------------------------------------------------------------------------
@@ -4216,18 +4899,14 @@ int vvVolDesc::findNumUsed(int channel)
 int vvVolDesc::findNumTransparent(int frame)
 {
   float* rgba = NULL;
-  uint8_t* raw;
   int numTransparent = 0;
   int lutEntries = 0;
-  int scalar;
   bool noTF;                                      // true = no TF present in file
 
   vvDebugMsg::msg(2, "vvVolDesc::findNumTransparent()");
 
   if (bpc==4) return 0;                           // TODO: implement for floats
 
-  size_t frameSize = getFrameBytes();
-
   noTF = tf[0]._widgets.empty();
 
   if (!noTF)
@@ -4245,27 +4924,7 @@ int vvVolDesc::findNumTransparent(int frame)
   }
 
   // Search volume:
-  raw = getRaw(frame);
-  switch (bpc)
-  {
-    case 1:
-    case 2:
-    case 4:
-      for (size_t i=bpc-1; i<frameSize; i += getBPV())
-      {
-        if (bpc==2) scalar = (int(raw[i-1]) << 8) | int(raw[i]);
-        else scalar = raw[i];
-        if (noTF)
-        {
-          if (scalar==0) ++numTransparent;
-        }
-        else
-        {
-          if (rgba[scalar * 4 + 3]==0.0f) ++numTransparent;
-        }
-      }
-      break;
-  }
+  dispatchVolumeView(*this, frame == -1 ? getCurrentFrame() : size_t(frame), CountTransparent(rgba, numTransparent));
 
   if (!noTF) delete[] rgba;
 
@@ -4278,36 +4937,11 @@ int vvVolDesc::findNumTransparent(int frame)
 */
 float vvVolDesc::calculateMean(int frame)
 {
-  uint8_t* raw;
-  float scalar = 0.f;
-  float mean;
-  double sum = 0.0;
+  float mean = 0.0f;
 
   vvDebugMsg::msg(2, "vvVolDesc::calculateMean()");
 
-  size_t frameSize = getFrameBytes();
-  size_t bpv = getBPV();
-
-  // Search volume:
-  raw = getRaw(frame);
-  for (size_t i=0; i<frameSize; i += bpv)
-  {
-    switch (bpc)
-    {
-      case 1:
-        scalar = float(raw[i]);
-        break;
-      case 2:
-        scalar = float((int(raw[i]) << 8) | int(raw[i+1]));
-        break;
-      case 4:
-        scalar = *((float*)(raw+i));
-        break;
-      default: assert(0); break;
-    }
-    sum += scalar;
-  }
-  mean = float(sum / double(getFrameVoxels()));
+  dispatchVolumeView(*this, frame == -1 ? getCurrentFrame() : size_t(frame), CalculateDistribution(0, mean, NULL));
   return mean;
 }
 
@@ -4319,38 +4953,12 @@ float vvVolDesc::calculateMean(int frame)
 */
 void vvVolDesc::calculateDistribution(int frame, int chan, float& mean, float& variance, float& stdev)
 {
-  uint8_t* raw;
-  double sumSquares = 0.0;
-  float scalar = 0.f;
-  float diff;
-
   vvDebugMsg::msg(2, "vvVolDesc::calculateDistribution()");
 
-  size_t frameSize = getFrameBytes();
-  size_t bpv = getBPV();
-  mean = calculateMean(frame);
-
-  // Search volume:
-  raw = getRaw(frame);
-  for (size_t i=chan*bpc; i<frameSize; i += bpv)
+  if (!dispatchVolumeView(*this, frame == -1 ? getCurrentFrame() : size_t(frame), CalculateDistribution(chan, mean, &variance)))
   {
-    switch (bpc)
-    {
-      case 1:
-        scalar = float(raw[i]);
-        break;
-      case 2:
-        scalar = float((int(raw[i]) << 8) | int(raw[i+1]));
-        break;
-      case 4:
-        scalar = *((float*)(raw+i));
-        break;
-      default: assert(0); break;
-    }
-    diff = scalar - mean;
-    sumSquares += diff * diff;
+    mean = variance = 0.0f;
   }
-  variance = float(sumSquares / double(getFrameVoxels()));
   stdev = sqrtf(variance);
 }
 
@@ -4409,7 +5017,7 @@ void vvVolDesc::zoomDataRange(int channel, int low, int high, bool verbose)
   if (verbose) vvToolshed::initProgress(frames);
   for (size_t f=0; f<frames; ++f)
   {
-    raw = getRaw(f);
+    raw = frameData(f);
     for (size_t i=0; i<frameSize; ++i)
     {
       for (int c=0; c<chan; ++c)
@@ -4461,17 +5069,9 @@ void vvVolDesc::applyMask(vvVolDesc* maskVD)
 
   for (size_t f=0; f<frames; ++f)
   {
-    uint8_t* data = getRaw(f);
-    for (size_t i=0; i<getFrameVoxels(); ++i)
-    {
-      bool m = static_cast<bool>(maskVD->getChannelValue(f, i, 0));
-
-      if (!m)
-      {
-        size_t index = getBPV() * i + chan * bpc;
-        memset(data + index, 0, bpc);
-      }
-    }
+    uint8_t* data = frameData(f);
+    if (data)
+      dispatchVolumeView(*maskVD, f, ApplyMask(data, getBPV(), chan * bpc, bpc));
   }
 }
 
@@ -4513,7 +5113,7 @@ void vvVolDesc::blend(vvVolDesc* blendVD, int method, bool verbose)
   if (verbose) vvToolshed::initProgress(frames);
   for (size_t f=0; f<frames; ++f)
   {
-    raw = getRaw(f);
+    raw = frameData(f);
     rawBlend = blendVD->getRaw(fBlend);
     for (size_t i=0; i<frameSize; ++i)                   // step through all voxel bytes
     {
@@ -4583,12 +5183,10 @@ void vvVolDesc::swapChannels(size_t ch0, size_t ch1, bool verbose)
   assert(bpc<=4);                                 // determines buffer size
 
   sliceSize = getSliceBytes();
-  raw.first();
   if (verbose) vvToolshed::initProgress(frames * vox[2]);
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
-    raw.next();
+    rd = frameData(f);
     for (ssize_t z=0; z<vox[2]; ++z)
     {
       sliceOffset = z * sliceSize;
@@ -4640,10 +5238,9 @@ void vvVolDesc::extractChannel(float weights[3], bool verbose)
   newSliceSize = vox[0] * vox[1] * 4;
   if (verbose) vvToolshed::initProgress(vox[2] * frames);
 
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = frameData(f);
     newRaw = new uint8_t[newSliceSize * vox[2]];
     src = rd;
     dst = newRaw;
@@ -4684,10 +5281,7 @@ void vvVolDesc::extractChannel(float weights[3], bool verbose)
       }
       if (verbose) vvToolshed::printProgress(z + vox[2] * f);
     }
-    raw.remove();
-    if (f==0) raw.insertBefore(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
-    else raw.insertAfter(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
-    raw.next();
+    raw[f] = makeFrame(newRaw, ARRAY_DELETE);
   }
   chan = 4;
 
@@ -4894,37 +5488,22 @@ void vvVolDesc::resizeEdgeMax(float len)
 }
 
 //----------------------------------------------------------------------------
+/** Returns the data value of one channel of a voxel, see virvo::channelValue().
+  This switches on the data type for every call, use virvo::VolumeView to
+  process many voxels.
+*/
 float vvVolDesc::getChannelValue(int frame, size_t indexXYZ, int channel) const
 {
   uint8_t* data = getRaw(frame);
-  float fval;
-  size_t index;
-  size_t bpv = getBPV();
+  size_t index = indexXYZ * chan + channel;
 
-  index = bpv * indexXYZ + channel * bpc;
   switch(bpc)
   {
-    case 1:
-    {
-      fval = float(data[index]);
-      fval = lerp(mapping(channel)[0], mapping(channel)[1], fval / 255);
-      break;
-    }
-    case 2:
-    {
-#ifdef BOOST_LITTLE_ENDIAN
-      unsigned short ival = ((unsigned short)data[index+1] << 8) | data[index]; fval = float(ival);
-#else
-      unsigned short ival = ((unsigned short)data[index] << 8) | data[index+1]; fval = float(ival);
-#endif
-      fval = (float)ival;
-      fval = lerp(mapping(channel)[0], mapping(channel)[1], fval / 65535);
-      break;
-    }
-    case 4: fval = *((float*)(data + index)); break;
-    default: assert(0); fval = 0.0f; break;
+    case 1: return channelValue(data[index], mapping(channel));
+    case 2: return channelValue(reinterpret_cast<uint16_t*>(data)[index], mapping(channel));
+    case 4: return channelValue(reinterpret_cast<float*>(data)[index], mapping(channel));
+    default: assert(0); return 0.0f;
   }
-  return fval;
 }
 
 //----------------------------------------------------------------------------
@@ -4961,10 +5540,7 @@ std::vector< std::vector< float > >& resArray)
   int ax, ay, az;
   int sx, sy, sz;
   int dx, dy, dz;
-  int index;
-
-  uint8_t* data = getRaw();                         //raw.getData();
-  size_t bpv = getBPV();
+  std::vector<size_t> indices;                    // voxels along the line
 
   x0 = ts_clamp(x0, 0, (int)vox[0]-1);
   x1 = ts_clamp(x1, 0, (int)vox[0]-1);
@@ -4989,41 +5565,16 @@ std::vector< std::vector< float > >& resArray)
   y = y0;
   z = z0;
 
-  resArray.clear();
-
   if (ax >= ts_max(ay, az))                       // x is dominant
   {
     yd = ay - (ax >> 1);
     zd = az - (ax >> 1);
     for (;;)
     {
-      index = (z * vox[0] * vox[1] + y * vox[0] + x) * bpv;
-
-      std::vector< float > tmp(chan);
-
-      for (int i = 0; i < chan; i++)
-      {
-        switch (bpc)
-        {
-          case 1:
-            tmp[i] = float(data[index + i]);
-            break;
-          case 2:
-            tmp[i] = float(int(data[index + 2 * i] << 8) | int(data[index + 2 * i + 1]));
-            break;
-          case 4:
-            tmp[i] = *((float*)(data + index + 4 * i));
-            break;
-          default:
-            assert(0);
-            break;
-        }
-      }
-
-      resArray.push_back(tmp);
+      indices.push_back(z * vox[0] * vox[1] + y * vox[0] + x);
 
       // compute next voxel
-      if (x == x1) return;
+      if (x == x1) break;
       if (yd >= 0)
       {
         y += sy;
@@ -5045,33 +5596,10 @@ std::vector< std::vector< float > >& resArray)
     zd = az - (ay >> 1);
     for (;;)
     {
-      index = (z * vox[0] * vox[1] + y * vox[0] + x) * bpv;
-
-      std::vector< float > tmp(chan);
-
-      for (int i = 0; i < chan; i++)
-      {
-        switch (bpc)
-        {
-          case 1:
-            tmp[i] = float(data[index + i]);
-            break;
-          case 2:
-            tmp[i] = float(int(data[index + 2 * i] << 8) | int(data[index + 2 * i + 1]));
-            break;
-          case 4:
-            tmp[i] = *((float*)(data + index + 4 * i));
-            break;
-          default:
-            assert(0);
-            break;
-        }
-      }
-
-      resArray.push_back(tmp);
+      indices.push_back(z * vox[0] * vox[1] + y * vox[0] + x);
 
       // compute next voxel;
-      if (y == y1) return;
+      if (y == y1) break;
       if (xd >= 0)
       {
         x += sx;
@@ -5094,33 +5622,10 @@ std::vector< std::vector< float > >& resArray)
     yd = ay - (az >> 1);
     for (;;)
     {
-      index = (z * vox[0] * vox[1] + y * vox[0] + x) * bpv;
-
-      std::vector< float > tmp(chan);
-
-      for (int i = 0; i < chan; i++)
-      {
-        switch (bpc)
-        {
-          case 1:
-            tmp[i] = float(data[index + i]);
-            break;
-          case 2:
-            tmp[i] = float(int(data[index + 2 * i] << 8) | int(data[index + 2 * i + 1]));
-            break;
-          case 4:
-            tmp[i] = *((float*)(data + index + 4 * i));
-            break;
-          default:
-            assert(0);
-            break;
-        }
-      }
-
-      resArray.push_back(tmp);
+      indices.push_back(z * vox[0] * vox[1] + y * vox[0] + x);
 
       // compute next voxel
-      if (z == z1) return;
+      if (z == z1) break;
       if (xd >= 0)
       {
         x += sx;
@@ -5136,6 +5641,9 @@ std::vector< std::vector< float > >& resArray)
       yd += ay;
     }
   }
+
+  resArray.clear();
+  dispatchVolumeView(*this, getCurrentFrame(), GatherVoxels(indices, resArray));
 }
 
 //----------------------------------------------------------------------------
@@ -5184,10 +5692,9 @@ bool vvVolDesc::makeHeightField(size_t slices, int mode, bool verbose)
 
   newFrameSize = vox[0] * vox[1] * slices * bpc;
   if (verbose) vvToolshed::initProgress(slices * frames);
-  raw.first();
   for (size_t f=0; f<frames; ++f)
   {
-    rd = raw.getData();
+    rd = frameData(f);
     newRaw = new uint8_t[newFrameSize];
     dst = newRaw;
 
@@ -5224,10 +5731,7 @@ bool vvVolDesc::makeHeightField(size_t slices, int mode, bool verbose)
       }
       if (verbose) vvToolshed::printProgress(z + slices * f);
     }
-    raw.remove();
-    if (f==0) raw.insertBefore(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
-    else raw.insertAfter(newRaw, vvSLNode<uint8_t*>::ARRAY_DELETE);
-    raw.next();
+    raw[f] = makeFrame(newRaw, ARRAY_DELETE);
   }
   vox[2] = slices;
   return true;
@@ -5244,24 +5748,10 @@ bool vvVolDesc::makeHeightField(size_t slices, int mode, bool verbose)
 */
 void vvVolDesc::addGradient(size_t srcChan, GradientType gradType)
 {
-  const float SQRT3 = float(sqrt(3.0));
   const char* GRADIENT_MAGNITUDE_CHANNEL_NAME = "GRADMAG";
   const char* GRADIENT_X_CHANNEL_NAME = "GRADIENT_X";
   const char* GRADIENT_Y_CHANNEL_NAME = "GRADIENT_Y";
   const char* GRADIENT_Z_CHANNEL_NAME = "GRADIENT_Z";
-  uint8_t* src;                                   // pointer to current source channel
-  uint8_t* dst;                                   // pointer to current destination channel (first of three if gradient vectors)
-  uint8_t* surrPtr[6];                            // pointers to surrounding voxels: next and previous values along coordinate axes
-  float surr[6];                                  // values of surrounding voxels
-  float diff[3];                                  // differences along coordinate axes
-  float grad;                                     // gradient value as floating point
-  int iGrad;                                      // gradient value as integer
-  size_t sliceVoxels;                             // number of voxels per slice
-  size_t sliceBytes;                              // number of bytes per slice
-  size_t lineBytes;                               // number of bytes per volume line
-  size_t bpv;                                     // bytes per voxel
-  size_t offset;                                  // offset from source channel to destination channel
-
   size_t numNewChannels;
 
   // Add new channels and name them:
@@ -5278,168 +5768,35 @@ void vvVolDesc::addGradient(size_t srcChan, GradientType gradType)
     setChannelName(chan-1, GRADIENT_Z_CHANNEL_NAME);
   }
 
-  sliceVoxels = getSliceVoxels();
-  sliceBytes = getSliceBytes();
-  bpv = bpc * chan;
-  lineBytes = bpv * vox[0];
-  offset = bpc * (chan - srcChan - numNewChannels);
+  int dstChan = chan - int(numNewChannels);
 
   float minGradientMagnitude = 1.0f;
   float maxGradientMagnitude = 0.0f;
 
-  // Add gradient magnitudes to every frame:
+  // Add gradients to every frame, edge voxels are skipped:
   for (size_t f=0; f<frames; ++f)
   {
-    // Calculate gradient magnitudes for non-edge voxels:
-    src = getRaw(f) + bpv * (1 + vox[0] + sliceVoxels) + bpc * srcChan;
-    for(ssize_t z=1; z<vox[2]-1; ++z)
-    {
-      for(ssize_t y=1; y<vox[1]-1; ++y)
-      {
-        for(ssize_t x=1; x<vox[0]-1; ++x)
-        {
-          // Calculate gradient from surrounding voxels:
-          surrPtr[0] = src - bpv;
-          surrPtr[1] = src + bpv;
-          surrPtr[2] = src - lineBytes;
-          surrPtr[3] = src + lineBytes;
-          surrPtr[4] = src - sliceBytes;
-          surrPtr[5] = src + sliceBytes;
-          for (int i=0; i<6; ++i)
-          {
-            switch(bpc)
-            {
-              case 1: surr[i] = float(*surrPtr[i]) / 255.0f; break;
-              case 2: surr[i] = float((int(*surrPtr[i]) << 8) | int(*(surrPtr[i]+1))) / 65535.0f; break;
-              case 4: surr[i] = *((float*)surrPtr[i]); break;
-              default: surr[i] = 0.0f; assert(0); break;
-            }
-          }
-
-          diff[0] = surr[1] - surr[0];
-          diff[1] = surr[3] - surr[2];
-          diff[2] = surr[5] - surr[4];
-
-          // Store gradient in new channels:
-          dst = src + offset;
-          if (gradType==GRADIENT_MAGNITUDE)
-          {
-                                                  // reduce value to range 0..1
-            grad = float(sqrt(diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2])) / SQRT3;
-            grad = ts_clamp(grad, 0.0f, 1.0f);
-            switch(bpc)
-            {
-              case 1: *dst = int(grad * 255.0f); break;
-              case 2: iGrad = int(grad * 65535.0f);
-              *dst = iGrad >> 8; *(dst+1) = iGrad & 0xff; break;
-              case 4: *((float*)dst) = grad; break;
-              default: assert(0); break;
-            }
-
-            minGradientMagnitude = ts_min(grad, minGradientMagnitude);
-            maxGradientMagnitude = ts_max(grad, maxGradientMagnitude);
-          }
-          else
-          {
-            for (int i=0; i<3; ++i)
-            {
-              switch(bpc)
-              {
-                case 1:
-                  iGrad = int((diff[i] + 1.0f) * 127.5f);
-                  *(dst+i) = ts_clamp(iGrad, 0, 255);
-                  break;
-                case 2:
-                  iGrad = int((diff[i] + 1.0f) * 32767.5f);
-                  *(dst+2*i) = iGrad >> 8;
-                  *(dst+2*i+1) = iGrad & 0xff;
-                  break;
-                case 4:
-                  *((float*)(dst+i*4)) = diff[i];
-                  break;
-                default: assert(0); break;
-              }
-            }
-          }
-          src += bpv;
-        }
-        src += 2 * bpv;
-      }
-      src += 2 * lineBytes;
-    }
+    dispatchVolumeData(*this, frameData(f), AddGradient(int(srcChan), dstChan, gradType==GRADIENT_MAGNITUDE,
+        minGradientMagnitude, maxGradientMagnitude));
   }
 
   if (gradType==GRADIENT_MAGNITUDE)
   {
-    int c = chan - srcChan - numNewChannels;
-    mapping(c) = vec2(0.0f, 1.0f);
-    range(c) = vec2(minGradientMagnitude, maxGradientMagnitude);
+    mapping(dstChan) = vec2(0.0f, 1.0f);
+    range(dstChan) = vec2(minGradientMagnitude, maxGradientMagnitude);
   }
   // TODO: set mapping/range when calculating gradient vectors
 }
 
 //----------------------------------------------------------------------------
 /** Calculate mean and variance for the 3x3x3 neighborhood of a voxel.
+  Neighbors outside of the volume are ignored.
 */
 void vvVolDesc::voxelStatistics(size_t frame, size_t c, ssize_t x, ssize_t y, ssize_t z, float& mean, float& variance)
 {
-  uint8_t* raw;
-  double sumSquares = 0.0;
-  double sum = 0.0;
-  float diff;
-  float scalar = 0.f;
-  size_t offset;
-  ptrdiff_t dx,dy,dz;     // offsets to neighboring voxels
-  size_t bpv;
-  int mode;   // 0=mean, 1=variance
-  size_t i;
-  size_t numSummed;
-
-  raw = getRaw(frame);
-  bpv = bpc * chan;
-  offset = bpv * (x + y * vox[0] + z * vox[0] * vox[1]) + bpc * c;
-  for (mode=0; mode<2; ++mode)
+  if (!dispatchVolumeView(*this, frame, VoxelStatistics(int(c), x, y, z, mean, variance)))
   {
-    numSummed = 0;
-    for (dx=-1; dx<=1; ++dx)
-    {
-      if (x+dx > vox[0]-1) continue;
-      for (dy=-1; dy<=1; ++dy)
-      {
-        if (y+dy > vox[1]-1) continue;
-        for (dz=-1; dz<=1; ++dz)
-        {
-          if (z+dz > vox[2]-1) continue;
-          i = offset + bpv * (dx + dy * vox[0] + dz * vox[0] * vox[1]);
-          switch (bpc)
-          {
-            case 1:
-              scalar = float(raw[i]);
-              break;
-            case 2:
-              scalar = float((int(raw[i]) << 8) | int(raw[i+1]));
-              break;
-            case 4:
-              scalar = *((float*)(raw+i));
-              break;
-            default: assert(0); break;
-          }
-          if (mode==0)
-          {
-            sum += scalar;
-            ++numSummed;
-          }
-          else
-          {
-            diff = scalar - mean;
-            sumSquares += diff * diff;
-            ++numSummed;
-          }
-        }
-      }
-    }
-    if (mode==0) mean = float(sum / double(numSummed));
-    else variance = float(sumSquares / double(numSummed));
+    mean = variance = 0.0f;
   }
 }
 
@@ -5451,49 +5808,15 @@ void vvVolDesc::voxelStatistics(size_t frame, size_t c, ssize_t x, ssize_t y, ss
 void vvVolDesc::addVariance(size_t srcChan)
 {
   const char* VARIANCE_CHANNEL_NAME = "VARIANCE";
-  uint8_t* src;                                   // pointer to current source channel
-  uint8_t* dst;                                   // pointer to current destination channel (first of three if gradient vectors)
-  float mean;                                     // mean data value in a frame
-  float variance;
-  int iVar;                                       // variance as integer
-  size_t bpv;                                     // bytes per voxel
-  size_t voxelOffset;                             // offset from source channel to destination channel [bytes]
 
   // Add new channel and name it:
   convertChannels(chan + 1);
   setChannelName(chan-1, VARIANCE_CHANNEL_NAME);
 
-  bpv = bpc * chan;
-  voxelOffset = bpc * (chan - srcChan - 1);
-
-  // Add variance to every frame:
+  // Add variance to every frame, including edge voxels:
   for (size_t f=0; f<frames; ++f)
   {
-    // Calculate variance for all voxels, including edge voxels:
-    src = getRaw(f) + bpc * srcChan;
-    for(ssize_t z=0; z<vox[2]; ++z)
-    {
-      for(ssize_t y=0; y<vox[1]; ++y)
-      {
-        for(ssize_t x=0; x<vox[0]; ++x)
-        {
-          voxelStatistics(f, srcChan, x, y, z, mean, variance);
-          dst = src + voxelOffset;
-          switch(bpc)
-          {
-            case 1: *dst = int(variance * 255.0f);
-                    break;
-            case 2: iVar = int(variance * 65535.0f);
-                    *dst = iVar >> 8; *(dst+1) = iVar & 0xff;
-                    break;
-            case 4: *((float*)dst) = variance;
-                    break;
-            default: assert(0); break;
-          }
-          src += bpv;
-        }
-      }
-    }
+    dispatchVolumeData(*this, frameData(f), AddVariance(int(srcChan), chan-1));
   }
 }
 
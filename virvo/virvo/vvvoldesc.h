@@ -23,6 +23,7 @@
 
 #include <boost/serialization/binary_object.hpp>
 #include <boost/serialization/split_member.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <stdlib.h>
 #include <string>
@@ -33,7 +34,8 @@
 #include "vvexport.h"
 #include "vvinttypes.h"
 #include "vvtransfunc.h"
-#include "vvsllist.h"
+
+class vvFrameProvider;
 
 //============================================================================
 // Class Definition
@@ -79,6 +81,7 @@ class VIRVO_FILEIOEXPORT vvVolDesc
       NORMAL_DELETE,                              ///< delete data when not used anymore, use normal delete (delete)
       ARRAY_DELETE                                ///< delete data when not used anymore, use array delete (delete[])
     };
+    typedef boost::shared_ptr<uint8_t> FramePointer; ///< reference counted frame buffer
     enum NormalizationType                        /// type of normalization
     {
       VV_LINEAR,                                  ///< linear
@@ -248,6 +251,7 @@ public:
      @param  default to -1 in the past meant current frame */
     uint8_t* getRaw(int frame = -1) const;
     uint8_t* getRaw(size_t) const;
+    FramePointer getFrame(size_t) const;
     const char* getFilename() const;
     void   setFilename(const char*);
     void   setEntry(int entry); //< entry to read from DICOMDIR (<0: entry with largest number of slices)
@@ -304,6 +308,10 @@ public:
     ErrorType merge(vvVolDesc*, vvVolDesc::MergeType);
     ErrorType mergeFrames(ssize_t slicesPerFrame=-1);
     void   addFrame(uint8_t*, DeleteType, int fd=-1);
+    bool   addMappedFrame(const char*, size_t, int fd=-1);
+    void   setFrameProvider(boost::shared_ptr<vvFrameProvider>, size_t cacheFrames, size_t prefetchFrames = 2);
+    boost::shared_ptr<vvFrameProvider> getFrameProvider() const;
+    bool   isFrameResident(size_t) const;
     void   copyFrame(uint8_t*);
     void   removeSequence();
     void   makeHistogram(int frame, int chan1, int numChan, int*, int*, float, float) const;
@@ -371,10 +379,18 @@ public:
     int entry;                                    ///< number of entry to read from a DICOMDIR file (<0: entry with largest number of slices)
     size_t currentFrame;                          ///< current animation frame
     int indexChannel;                             ///< assign one designated channel to contain an index volume (default: none, indexChannel == -1)
-    mutable vvSLList<uint8_t*> raw;               ///< pointer list to raw volume data - mutable because of Java style iterators
+    std::vector<FramePointer> raw;                ///< frame table with reference counted raw volume data, indexed by frame
+    class FrameCache;
+    boost::shared_ptr<FrameCache> frameCache;     ///< working set of frames not in raw if a frame provider is set, otherwise NULL
     std::vector<int> rawFrameNumber;           ///< frame numbers (if frames do not come in sequence)
     std::vector< std::string > channelNames;      ///< names of data channels
 
+    struct NoDeleter    { void operator()(uint8_t*) const {} };
+    struct ArrayDeleter { void operator()(uint8_t* ptr) const { delete[] ptr; } };
+
+    static FramePointer makeFrame(uint8_t*, DeleteType);
+    uint8_t* frameData(size_t);
+    void makeResident();
     void initialize();
     void setDefaults();
     void makeLineIntensDiag(int channel, std::vector< std::vector< float > > const& data, size_t numValues, int*);
@@ -0,0 +1,254 @@
+// Virvo - Virtual Reality Volume Rendering
+// Copyright (C) 1999-2003 University of Stuttgart, 2004-2005 Brown University
+// Contact: Jurgen P. Schulze, jschulze@ucsd.edu
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef VV_VOLUMEVIEW_H
+#define VV_VOLUMEVIEW_H
+
+#include <assert.h>
+#include <stddef.h>
+
+#include <iterator>
+
+#include "vvdebugmsg.h"
+#include "vvinttypes.h"
+#include "vvvoldesc.h"
+
+namespace virvo
+{
+
+//============================================================================
+// Data values
+//============================================================================
+
+/** Data value of a stored voxel value, as returned by
+  vvVolDesc::getChannelValue(): integer values are mapped to the mapping
+  range of their channel, floating point values are returned unchanged.
+*/
+inline float channelValue(uint8_t v, vec2 const& mapping)
+{
+  return lerp(mapping[0], mapping[1], float(v) / 255);
+}
+
+inline float channelValue(uint16_t v, vec2 const& mapping)
+{
+  return lerp(mapping[0], mapping[1], float(v) / 65535);
+}
+
+inline float channelValue(float v, vec2 const&)
+{
+  return v;
+}
+
+//============================================================================
+// Class Definition
+//============================================================================
+
+/** Typed view of the voxels of one animation frame.
+  Voxels are stored channel interleaved in host byte order, the value of
+  channel c of voxel i is data()[i * channels() + c]. Code written against a
+  VolumeView<T> reads the stored values directly instead of switching on
+  vvVolDesc::bpc for every voxel like vvVolDesc::getChannelValue() does, so
+  its loops are plain typed loops the compiler can vectorize. Use
+  dispatchVolumeView() or dispatchVolumeData() to select T once per frame.
+
+  A view created from a frame index shares ownership of the frame buffer, so
+  it stays valid if the frame cache evicts the frame in the meantime. Such a
+  buffer may be a cached copy of the frame; to modify voxels, create the view
+  with fromData() from the data pointer of a resident frame.
+*/
+template <typename T>
+class VolumeView
+{
+  public:
+    typedef T value_type;
+
+    /// Iterator over the values of one channel
+    class ChannelIterator
+    {
+      public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef ptrdiff_t difference_type;
+        typedef T* pointer;
+        typedef T& reference;
+
+        ChannelIterator() : ptr(NULL), stride(1) {}
+        ChannelIterator(T* ptr, ptrdiff_t stride) : ptr(ptr), stride(stride) {}
+
+        reference operator*() const { return *ptr; }
+        pointer operator->() const { return ptr; }
+        reference operator[](difference_type n) const { return ptr[n * stride]; }
+
+        ChannelIterator& operator++() { ptr += stride; return *this; }
+        ChannelIterator& operator--() { ptr -= stride; return *this; }
+        ChannelIterator operator++(int) { ChannelIterator it(*this); ptr += stride; return it; }
+        ChannelIterator operator--(int) { ChannelIterator it(*this); ptr -= stride; return it; }
+        ChannelIterator& operator+=(difference_type n) { ptr += n * stride; return *this; }
+        ChannelIterator& operator-=(difference_type n) { ptr -= n * stride; return *this; }
+        ChannelIterator operator+(difference_type n) const { return ChannelIterator(ptr + n * stride, stride); }
+        ChannelIterator operator-(difference_type n) const { return ChannelIterator(ptr - n * stride, stride); }
+        difference_type operator-(ChannelIterator const& rhs) const { return (ptr - rhs.ptr) / stride; }
+
+        bool operator==(ChannelIterator const& rhs) const { return ptr == rhs.ptr; }
+        bool operator!=(ChannelIterator const& rhs) const { return ptr != rhs.ptr; }
+        bool operator<(ChannelIterator const& rhs) const { return ptr < rhs.ptr; }
+        bool operator>(ChannelIterator const& rhs) const { return ptr > rhs.ptr; }
+        bool operator<=(ChannelIterator const& rhs) const { return ptr <= rhs.ptr; }
+        bool operator>=(ChannelIterator const& rhs) const { return ptr >= rhs.ptr; }
+
+      private:
+        T* ptr;
+        ptrdiff_t stride;
+    };
+
+    /// View of animation frame 'frame' of 'vd'
+    VolumeView(vvVolDesc const& vd, size_t frame)
+      : vd_(&vd)
+      , frame_(vd.getFrame(frame))
+      , data_(reinterpret_cast<T*>(frame_.get()))
+    {
+      assert(vd.bpc == sizeof(T));
+    }
+
+    /// View of frame data laid out like the frames of 'vd'
+    static VolumeView fromData(vvVolDesc const& vd, uint8_t* data)
+    {
+      return VolumeView(vd, reinterpret_cast<T*>(data), DataTag());
+    }
+
+    /// false if the frame could not be loaded
+    bool valid() const { return data_ != NULL; }
+
+    T* data() const { return data_; }
+    virvo::vector< 3, ssize_t > const& vox() const { return vd_->vox; }
+    int channels() const { return vd_->getChan(); }
+    size_t voxels() const { return vd_->getFrameVoxels(); }
+    vec2 const& mapping(int c) const { return vd_->mapping(c); }
+
+    /// Voxel index of voxel (x,y,z)
+    size_t index(ssize_t x, ssize_t y, ssize_t z) const
+    {
+      return x + vd_->vox[0] * (y + z * vd_->vox[1]);
+    }
+
+    /// Stored value of channel c of voxel i
+    T& operator()(size_t i, int c = 0) const
+    {
+      return data_[i * channels() + c];
+    }
+
+    /// Stored value of channel c of voxel (x,y,z)
+    T& operator()(ssize_t x, ssize_t y, ssize_t z, int c) const
+    {
+      return data_[index(x, y, z) * channels() + c];
+    }
+
+    /// Data value of channel c of voxel i, see channelValue()
+    float value(size_t i, int c = 0) const
+    {
+      return channelValue((*this)(i, c), mapping(c));
+    }
+
+    ChannelIterator begin(int c) const
+    {
+      return ChannelIterator(data_ + c, channels());
+    }
+
+    ChannelIterator end(int c) const
+    {
+      return ChannelIterator(data_ + voxels() * channels() + c, channels());
+    }
+
+  private:
+    struct DataTag {};
+
+    vvVolDesc const* vd_;
+    vvVolDesc::FramePointer frame_;
+    T* data_;
+
+    VolumeView(vvVolDesc const& vd, T* data, DataTag)
+      : vd_(&vd)
+      , data_(data)
+    {
+      assert(vd.bpc == sizeof(T));
+    }
+};
+
+namespace detail
+{
+
+template <typename T, typename Func>
+bool applyVolumeView(VolumeView<T> const& view, Func& func)
+{
+  if (!view.valid())
+  {
+    vvDebugMsg::msg(1, "Error: volume frame data not available");
+    return false;
+  }
+
+  func(view);
+  return true;
+}
+
+} // detail
+
+//----------------------------------------------------------------------------
+/** Calls func(view) with a VolumeView<T> of animation frame 'frame' whose
+  voxel type T matches vd.bpc. Func must accept VolumeView<uint8_t>,
+  VolumeView<uint16_t> and VolumeView<float>, e.g. through a templated
+  operator().
+  @return false if the frame could not be loaded, func is not called then
+*/
+template <typename Func>
+bool dispatchVolumeView(vvVolDesc const& vd, size_t frame, Func&& func)
+{
+  switch (vd.bpc)
+  {
+    case 1: return detail::applyVolumeView(VolumeView<uint8_t>(vd, frame), func);
+    case 2: return detail::applyVolumeView(VolumeView<uint16_t>(vd, frame), func);
+    case 4: return detail::applyVolumeView(VolumeView<float>(vd, frame), func);
+    default: assert(0); return false;
+  }
+}
+
+/** Same as dispatchVolumeView() for frame data laid out like the frames of
+  'vd', see VolumeView::fromData().
+  @return false if data is NULL, func is not called then
+*/
+template <typename Func>
+bool dispatchVolumeData(vvVolDesc const& vd, uint8_t* data, Func&& func)
+{
+  switch (vd.bpc)
+  {
+    case 1: return detail::applyVolumeView(VolumeView<uint8_t>::fromData(vd, data), func);
+    case 2: return detail::applyVolumeView(VolumeView<uint16_t>::fromData(vd, data), func);
+    case 4: return detail::applyVolumeView(VolumeView<float>::fromData(vd, data), func);
+    default: assert(0); return false;
+  }
+}
+
+} // virvo
+
+#endif
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0